@@ -0,0 +1,74 @@
+// Times the tray pixmap conversion (src/Pixmap.h) and checks, that all variants produce the same output.
+// Built with -DBuildBench=true, run as ./argb-to-rgba-bench [size] [iterations]
+#include "Pixmap.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using ConvertFn = void (*)(const uint8_t*, uint8_t*, size_t);
+
+static double Time(ConvertFn fn, const std::vector<uint8_t>& src, std::vector<uint8_t>& dst, size_t numPixels, int iterations)
+{
+    auto start = std::chrono::steady_clock::now();
+    for (int i = 0; i < iterations; i++)
+    {
+        fn(src.data(), dst.data(), numPixels);
+        // Keep the compiler from dropping the loop
+        asm volatile("" : : "r"(dst.data()) : "memory");
+    }
+    auto end = std::chrono::steady_clock::now();
+    return std::chrono::duration<double, std::micro>(end - start).count() / iterations;
+}
+
+int main(int argc, char** argv)
+{
+    size_t size = argc > 1 ? strtoul(argv[1], nullptr, 10) : 64;
+    int iterations = argc > 2 ? atoi(argv[2]) : 100000;
+    // Odd pixel counts exercise the scalar tail of the SIMD variant as well
+    bool ok = true;
+    for (size_t numPixels : {size * size, size * size + 3})
+    {
+        std::vector<uint8_t> src(numPixels * 4);
+        srand(1);
+        for (uint8_t& byte : src)
+        {
+            byte = (uint8_t)rand();
+        }
+        std::vector<uint8_t> scalar(src.size());
+        double scalarTime = Time(Pixmap::ArgbToRgbaScalar, src, scalar, numPixels, iterations);
+        printf("%zu pixels: scalar %.3fus", numPixels, scalarTime);
+
+#ifdef PIXMAP_SIMD_X86
+        if (Pixmap::HasSSSE3())
+        {
+            std::vector<uint8_t> simd(src.size());
+            double simdTime = Time(Pixmap::ArgbToRgbaSSSE3, src, simd, numPixels, iterations);
+            bool same = memcmp(scalar.data(), simd.data(), scalar.size()) == 0;
+            ok &= same;
+            printf(", ssse3 %.3fus (%.1fx), output %s", simdTime, scalarTime / simdTime, same ? "identical" : "DIFFERENT");
+        }
+        else
+        {
+            printf(", no ssse3");
+        }
+#endif
+        printf("\n");
+
+        // The scalar variant itself against the byte order of the spec
+        for (size_t i = 0; i < numPixels && ok; i++)
+        {
+            const uint8_t* argb = &src[i * 4];
+            const uint8_t* rgba = &scalar[i * 4];
+            ok = rgba[0] == argb[1] && rgba[1] == argb[2] && rgba[2] == argb[3] && rgba[3] == argb[0];
+        }
+    }
+    if (!ok)
+    {
+        printf("Mismatch!\n");
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,101 @@
+#include "AppIcons.h"
+#include "Common.h"
+
+#include <unordered_map>
+#include <memory>
+#include <cctype>
+#include <cstring>
+
+#include <gtk/gtk.h>
+#include <gio/gdesktopappinfo.h>
+
+namespace AppIcons
+{
+    // nullptr for apps without an icon
+    static std::unordered_map<std::string, std::unique_ptr<Icon>> cache;
+
+    static GtkIconInfo* LookupIcon(const std::string& name, uint32_t size)
+    {
+        GtkIconTheme* theme = gtk_icon_theme_get_default();
+        // The desktop file knows the real icon name (e.g. org.gnome.Nautilus -> org.gnome.Nautilus or system-file-manager)
+        GDesktopAppInfo* appInfo = g_desktop_app_info_new((name + ".desktop").c_str());
+        if (appInfo)
+        {
+            GtkIconInfo* info = nullptr;
+            GIcon* icon = g_app_info_get_icon((GAppInfo*)appInfo);
+            if (icon)
+            {
+                info = gtk_icon_theme_lookup_by_gicon(theme, icon, size, GTK_ICON_LOOKUP_FORCE_SIZE);
+            }
+            g_object_unref(appInfo);
+            if (info)
+            {
+                return info;
+            }
+        }
+        return gtk_icon_theme_lookup_icon(theme, name.c_str(), size, GTK_ICON_LOOKUP_FORCE_SIZE);
+    }
+
+    static std::unique_ptr<Icon> Load(const std::string& appId, uint32_t size)
+    {
+        std::string lowerAppId = appId;
+        for (char& c : lowerAppId)
+        {
+            c = tolower((unsigned char)c);
+        }
+
+        GtkIconInfo* info = LookupIcon(appId, size);
+        if (!info && lowerAppId != appId)
+        {
+            // X11 classes are often capitalized (e.g. Firefox), desktop files and icons aren't
+            info = LookupIcon(lowerAppId, size);
+        }
+        if (!info)
+        {
+            LOG("AppIcons: No icon for " << appId);
+            return nullptr;
+        }
+
+        GError* err = nullptr;
+        GdkPixbuf* pixbuf = gtk_icon_info_load_icon(info, &err);
+        g_object_unref(info);
+        if (!pixbuf)
+        {
+            LOG("AppIcons: Cannot load icon for " << appId << ": " << (err ? err->message : "unknown error"));
+            if (err)
+                g_error_free(err);
+            return nullptr;
+        }
+        if (!gdk_pixbuf_get_has_alpha(pixbuf))
+        {
+            GdkPixbuf* withAlpha = gdk_pixbuf_add_alpha(pixbuf, false, 0, 0, 0);
+            g_object_unref(pixbuf);
+            pixbuf = withAlpha;
+        }
+
+        auto icon = std::make_unique<Icon>();
+        icon->width = gdk_pixbuf_get_width(pixbuf);
+        icon->height = gdk_pixbuf_get_height(pixbuf);
+        icon->data.resize(icon->width * icon->height * 4);
+        // Rows can be padded
+        const uint8_t* pixels = gdk_pixbuf_read_pixels(pixbuf);
+        int rowstride = gdk_pixbuf_get_rowstride(pixbuf);
+        for (uint32_t y = 0; y < icon->height; y++)
+        {
+            memcpy(icon->data.data() + y * icon->width * 4, pixels + y * rowstride, icon->width * 4);
+        }
+        g_object_unref(pixbuf);
+        return icon;
+    }
+
+    const Icon* Get(const std::string& appId, uint32_t size)
+    {
+        std::string key = appId + "@" + std::to_string(size);
+        auto it = cache.find(key);
+        if (it == cache.end())
+        {
+            it = cache.emplace(key, Load(appId, size)).first;
+        }
+        return it->second.get();
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <string>
+#include <vector>
+#include <cstdint>
+
+// Icons of applications by their app-id (Wayland app-id/X11 WM class), resolved through the desktop file or the icon theme.
+namespace AppIcons
+{
+    struct Icon
+    {
+        uint32_t width = 0;
+        uint32_t height = 0;
+        // RGBA, tightly packed. Can be passed to Texture::SetBuf.
+        std::vector<uint8_t> data;
+    };
+
+    // Resolved and decoded only once per app-id and size, misses are cached as well.
+    // nullptr, if there is no icon for the app.
+    const Icon* Get(const std::string& appId, uint32_t size);
+}
@@ -1,6 +1,9 @@
 #include "AudioFlyin.h"
 #include "System.h"
 
+#include <cmath>
+#include <algorithm>
+
 namespace AudioFlyin
 {
     namespace DynCtx
@@ -8,16 +11,32 @@ namespace AudioFlyin
         Type type;
 
         Window* win;
+        Box* mainWidget;
         Slider* slider;
         Text* icon;
         double sliderVal;
         bool muted = false;
 
-        int32_t msOpen = 0;
+        enum class Phase
+        {
+            FlyIn,
+            Shown,
+            FlyOut
+        };
+        Phase phase = Phase::FlyIn;
+
         constexpr int32_t closeTime = 2000;
         constexpr int32_t height = 50;
-        int32_t curCloseTime = closeTime;
-        int32_t transitionTime = 50;
+        constexpr int32_t transitionTime = 150;
+
+        // 0 = hidden, 1 = fully flown in
+        double progress = 0;
+        // Progress at the start of the current animation
+        double animFrom = 0;
+        // Frame time (us) of the first frame of the current animation. -1 = not yet known
+        int64_t animStart = -1;
+        bool animating = false;
+        guint closeTimer = 0;
 
         void OnChangeVolume(Slider&, double value)
         {
@@ -31,66 +50,117 @@ namespace AudioFlyin
             }
         }
 
-        TimerResult Main(Box&)
+        double EaseOutCubic(double t)
         {
-            System::AudioInfo info = System::GetAudioInfo();
-            if (type == Type::Speaker)
+            return 1 - std::pow(1 - t, 3);
+        }
+
+        TimerResult Animate(Box&, int64_t frameTime)
+        {
+            if (animStart < 0)
+            {
+                animStart = frameTime;
+            }
+            // Time based, so the speed doesn't depend on how often we get called
+            double t = std::clamp((double)(frameTime - animStart) / (transitionTime * 1000.), 0., 1.);
+            double eased = EaseOutCubic(t);
+            if (phase == Phase::FlyOut)
+            {
+                progress = animFrom * (1 - eased);
+            }
+            else
             {
-                if (sliderVal != info.sinkVolume || muted != info.sinkMuted)
-                {
-                    // Extend timer
-                    curCloseTime = msOpen + closeTime;
+                progress = animFrom + (1 - animFrom) * eased;
+            }
+            win->SetMargin(Anchor::Bottom, (int32_t)std::round(progress * height));
 
-                    sliderVal = info.sinkVolume;
-                    slider->SetValue(info.sinkVolume);
+            if (t < 1)
+            {
+                return TimerResult::Ok;
+            }
 
-                    muted = info.sinkMuted;
-                    if (info.sinkMuted)
-                    {
-                        icon->SetText("󰝟");
-                    }
-                    else
-                    {
-                        icon->SetText("󰕾");
-                    }
-                }
+            animating = false;
+            if (phase == Phase::FlyOut)
+            {
+                win->Close();
             }
-            else if (type == Type::Microphone)
+            else
             {
-                if (sliderVal != info.sourceVolume || muted != info.sourceMuted)
-                {
-                    // Extend timer
-                    curCloseTime = msOpen + closeTime;
+                phase = Phase::Shown;
+                // Nothing moves until the close timer fires, so don't request any more frames.
+                closeTimer = g_timeout_add(
+                    closeTime,
+                    +[](void*) -> int
+                    {
+                        closeTimer = 0;
+                        phase = Phase::FlyOut;
+                        animFrom = progress;
+                        animStart = -1;
+                        animating = true;
+                        mainWidget->AddTickCallback<Box>(Animate);
+                        return false;
+                    },
+                    nullptr);
+            }
+            return TimerResult::Delete;
+        }
 
-                    sliderVal = info.sourceVolume;
-                    slider->SetValue(info.sourceVolume);
+        void FlyIn()
+        {
+            if (closeTimer)
+            {
+                g_source_remove(closeTimer);
+                closeTimer = 0;
+            }
+            if (phase == Phase::FlyIn && animating)
+            {
+                // Already on its way in, restarting would jump back to animFrom. The close timer starts, once it arrived.
+                return;
+            }
+            if (phase == Phase::Shown)
+            {
+                // Restart the close timer
+                phase = Phase::FlyIn;
+                animFrom = 1;
+            }
+            else if (phase == Phase::FlyOut)
+            {
+                // Reverse from where we are
+                phase = Phase::FlyIn;
+                animFrom = progress;
+            }
+            animStart = -1;
+            if (!animating)
+            {
+                animating = true;
+                mainWidget->AddTickCallback<Box>(Animate);
+            }
+        }
 
-                    muted = info.sourceMuted;
-                    if (info.sourceMuted)
-                    {
-                        icon->SetText("󰍭");
-                    }
-                    else
-                    {
-                        icon->SetText("󰍬");
-                    }
-                }
+        void OnAudioChanged(const System::AudioInfo& info)
+        {
+            double volume = type == Type::Speaker ? info.sinkVolume : info.sourceVolume;
+            bool isMuted = type == Type::Speaker ? info.sinkMuted : info.sourceMuted;
+            if (sliderVal == volume && muted == isMuted)
+            {
+                return;
             }
 
-            msOpen++;
-            auto marginFunction = [](int32_t x) -> int32_t
+            sliderVal = volume;
+            slider->SetValue(volume);
+
+            muted = isMuted;
+            if (type == Type::Speaker)
             {
-                // A inverted, cutoff 'V' shape
-                // Fly in -> hover -> fly out
-                double steepness = (double)height / (double)transitionTime;
-                return (int32_t)std::min(-std::abs((double)x - (double)curCloseTime / 2) * steepness + (double)curCloseTime / 2, (double)height);
-            };
-            win->SetMargin(Anchor::Bottom, marginFunction(msOpen));
-            if (msOpen >= curCloseTime)
+                icon->SetText(muted ? "󰝟" : "󰕾");
+            }
+            else if (type == Type::Microphone)
             {
-                win->Close();
+                icon->SetText(muted ? "󰍭" : "󰍬");
             }
-            return TimerResult::Ok;
+
+            // Extend timer
+            FlyIn();
         }
     }
     void WidgetAudio(Widget& parent)
@@ -138,8 +208,13 @@ namespace AudioFlyin
         mainWidget->SetSpacing({8, false});
         mainWidget->SetVerticalTransform({16, true, Alignment::Fill});
         mainWidget->SetClass("bar");
-        // We update the margin in the timer, so we need late dispatch.
-        mainWidget->AddTimer<Box>(DynCtx::Main, 1, TimerDispatchBehaviour::LateDispatch);
+        DynCtx::mainWidget = mainWidget.get();
+        // Animation is driven by the frame clock, so it can only start once the widget exists.
+        mainWidget->SetOnCreate(
+            [](Widget&)
+            {
+                DynCtx::FlyIn();
+            });
 
         auto padding = Widget::Create<Box>();
         padding->SetHorizontalTransform({8, true, Alignment::Fill});
@@ -147,6 +222,13 @@ namespace AudioFlyin
 
         WidgetAudio(*mainWidget);
 
+        // Audio state is pushed to us, instead of polled every frame.
+        System::AudioInfo info = System::GetAudioInfo();
+        DynCtx::sliderVal = type == Type::Speaker ? info.sinkVolume : info.sourceVolume;
+        DynCtx::muted = type == Type::Speaker ? info.sinkMuted : info.sourceMuted;
+        DynCtx::slider->SetValue(DynCtx::sliderVal);
+        System::AddAudioCallback(DynCtx::OnAudioChanged);
+
         padding = Widget::Create<Box>();
         mainWidget->AddChild(std::move(padding));
 
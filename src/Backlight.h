@@ -0,0 +1,125 @@
+#pragma once
+#include "Common.h"
+#include "Config.h"
+
+#include <string>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <glib-unix.h>
+
+namespace Backlight
+{
+    static std::string folder;
+    static int actualBrightnessFd = -1;
+    static guint watchSource = 0;
+    static uint32_t maxBrightness = 0;
+    static double brightness = -1;
+    static Utils::CallbackList<double> callbacks;
+
+    inline uint32_t ReadValue(int fd)
+    {
+        char buf[32];
+        ssize_t len = pread(fd, buf, sizeof(buf) - 1, 0);
+        if (len <= 0)
+        {
+            return 0;
+        }
+        buf[len] = '\0';
+        return strtoul(buf, nullptr, 10);
+    }
+
+    inline void Update()
+    {
+        double newBrightness = (double)ReadValue(actualBrightnessFd) / (double)maxBrightness;
+        if (newBrightness != brightness)
+        {
+            brightness = newBrightness;
+            callbacks.Invoke(brightness);
+        }
+    }
+
+    inline void Init()
+    {
+        folder = Config::Get().backlightFolder;
+        if (folder.empty())
+        {
+            // Take the first one available
+            DIR* dir = opendir("/sys/class/backlight");
+            if (!dir)
+            {
+                LOG("Backlight: /sys/class/backlight not available");
+                return;
+            }
+            while (dirent* entry = readdir(dir))
+            {
+                if (entry->d_name[0] != '.')
+                {
+                    folder = std::string("/sys/class/backlight/") + entry->d_name;
+                    break;
+                }
+            }
+            closedir(dir);
+        }
+        if (folder.empty())
+        {
+            LOG("Backlight: No backlight found");
+            return;
+        }
+
+        int maxFd = open((folder + "/max_brightness").c_str(), O_RDONLY | O_CLOEXEC);
+        if (maxFd < 0)
+        {
+            LOG("Backlight: Cannot open " << folder << "/max_brightness");
+            return;
+        }
+        maxBrightness = ReadValue(maxFd);
+        close(maxFd);
+
+        actualBrightnessFd = open((folder + "/actual_brightness").c_str(), O_RDONLY | O_CLOEXEC);
+        if (actualBrightnessFd < 0 || maxBrightness == 0)
+        {
+            LOG("Backlight: Cannot read " << folder << "/actual_brightness");
+            return;
+        }
+        brightness = (double)ReadValue(actualBrightnessFd) / (double)maxBrightness;
+
+        // The kernel notifies changes of actual_brightness via sysfs_notify, which wakes up poll() with POLLPRI.
+        auto onChange = +[](int, GIOCondition, void*) -> int
+        {
+            Update();
+            return G_SOURCE_CONTINUE;
+        };
+        watchSource = g_unix_fd_add(actualBrightnessFd, (GIOCondition)(G_IO_PRI | G_IO_ERR), onChange, nullptr);
+        LOG("Backlight: Using " << folder);
+    }
+
+    inline double GetBrightness()
+    {
+        return brightness;
+    }
+
+    inline uint32_t AddCallback(std::function<void(double)>&& callback)
+    {
+        return callbacks.Add(std::move(callback));
+    }
+
+    inline void RemoveCallback(uint32_t handle)
+    {
+        callbacks.Remove(handle);
+    }
+
+    inline void Shutdown()
+    {
+        if (watchSource)
+        {
+            g_source_remove(watchSource);
+            watchSource = 0;
+        }
+        if (actualBrightnessFd >= 0)
+        {
+            close(actualBrightnessFd);
+            actualBrightnessFd = -1;
+        }
+    }
+}
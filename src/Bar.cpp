@@ -4,116 +4,262 @@
 #include "Common.h"
 #include "Config.h"
 #include "SNI.h"
+#include "OSD.h"
+#include "Control.h"
+#include "AppIcons.h"
 #include <cmath>
-#include <mutex>
+#include <memory>
+#include <algorithm>
 
 namespace Bar
 {
-    static int32_t monitorID;
-
     namespace DynCtx
     {
         constexpr uint32_t updateTime = 1000;
         constexpr uint32_t updateTimeFast = 100;
 
-        static Revealer* powerBoxRevealer;
-        static void PowerBoxEvent(EventBox&, bool hovered)
+        struct SensorWidgets
+        {
+            Sensor* sensor = nullptr;
+            Text* text = nullptr;
+        };
+
+#ifdef WITH_WORKSPACES
+        struct WorkspaceButton
+        {
+            // Child of workspaceBox. The button itself, or a box of the button and the icons with WorkspaceIcons
+            Widget* root;
+            Button* button;
+            Box* icons = nullptr;
+            System::WorkspaceStatus status;
+            std::string text;
+            std::vector<std::string> apps;
+            uint32_t generation;
+        };
+#endif
+
+        // The widgets of one bar. Samplers and callbacks exist only once and fan their values out to every bar.
+        // Has to be clicked twice within 2s
+        struct PowerButton
+        {
+            Button* button = nullptr;
+            // Disarms the button again, 0 if it isn't armed
+            guint disarmTimer = 0;
+        };
+
+        struct BarCtx
+        {
+            ~BarCtx()
+            {
+                // The bar goes away with its monitor, don't let the timers touch the destroyed buttons
+                for (PowerButton* power : {&exitButton, &lockButton, &suspendButton, &rebootButton, &shutdownButton})
+                {
+                    if (power->disarmTimer)
+                    {
+                        g_source_remove(power->disarmTimer);
+                    }
+                }
+            }
+
+            // Only for the bars of CreateAll
+            std::unique_ptr<Window> ownedWindow;
+            Window* window;
+            // Index of the GdkMonitor. Changes, when a monitor before it is removed.
+            int32_t monitor;
+
+            Box* rightBox = nullptr;
+
+            Revealer* powerBoxRevealer = nullptr;
+            bool powerBoxRevealed = false;
+            PowerButton exitButton;
+            PowerButton lockButton;
+            PowerButton suspendButton;
+            PowerButton rebootButton;
+            PowerButton shutdownButton;
+
+            SensorWidgets cpu;
+            SensorWidgets battery;
+            SensorWidgets ram;
+            SensorWidgets gpu;
+            SensorWidgets vram;
+            SensorWidgets disk;
+
+            NetworkSensor* networkSensor = nullptr;
+            Text* networkText = nullptr;
+
+#ifdef WITH_BLUEZ
+            Button* btIconText = nullptr;
+            Text* btDevText = nullptr;
+#endif
+
+            Text* timeText = nullptr;
+            Text* packageText = nullptr;
+
+            Box* privacyBox = nullptr;
+            Text* privacyIcon = nullptr;
+
+            Widget* audioSlider = nullptr;
+            Widget* micSlider = nullptr;
+            Text* audioIcon = nullptr;
+            Text* micIcon = nullptr;
+
+            ElidedText* windowTitle = nullptr;
+            Text* windowAppId = nullptr;
+
+#ifdef WITH_WORKSPACES
+            Box* workspaceBox = nullptr;
+            std::unordered_map<std::string, WorkspaceButton> workspaceButtons;
+            std::vector<std::string> workspaceOrder;
+            uint32_t workspaceGeneration = 0;
+#endif
+        };
+        static std::vector<std::unique_ptr<BarCtx>> bars;
+        // Only one process can own the tray, so it is shown on one bar only
+        static BarCtx* trayBar = nullptr;
+        static bool sharedCreated = false;
+
+        static void PowerBoxEvent(BarCtx& bar, bool hovered)
+        {
+            bar.powerBoxRevealed = hovered;
+            bar.powerBoxRevealer->SetRevealed(hovered);
+        }
+
+        static void SetArmed(PowerButton& power, bool armed)
+        {
+            if (power.disarmTimer)
+            {
+                g_source_remove(power.disarmTimer);
+                power.disarmTimer = 0;
+            }
+            if (!armed)
+            {
+                power.button->RemoveClass("system-confirm");
+                return;
+            }
+            power.button->AddClass("system-confirm");
+            power.disarmTimer = g_timeout_add(
+                2000,
+                +[](void* data) -> int
+                {
+                    PowerButton& power = *(PowerButton*)data;
+                    power.disarmTimer = 0;
+                    power.button->RemoveClass("system-confirm");
+                    return G_SOURCE_REMOVE;
+                },
+                &power);
+        }
+
+        // The first click arms the button, a second one while it is armed runs the action
+        static void OnPowerClick(PowerButton& power, void (*action)())
+        {
+            if (power.disarmTimer)
+            {
+                SetArmed(power, false);
+                action();
+            }
+            else
+            {
+                SetArmed(power, true);
+            }
+        }
+
+        static void SetSensor(SensorWidgets BarCtx::*widgets, const std::string& text, double value)
         {
-            powerBoxRevealer->SetRevealed(hovered);
+            for (auto& bar : bars)
+            {
+                SensorWidgets& sensor = (*bar).*widgets;
+                sensor.text->SetText(text);
+                sensor.sensor->SetValue(value);
+            }
         }
 
-        static Text* cpuText;
-        static TimerResult UpdateCPU(Sensor& sensor)
+        static void UpdateCPU()
         {
             double usage = System::GetCPUUsage();
             double temp = System::GetCPUTemp();
 
-            cpuText->SetText("CPU: " + Utils::ToStringPrecision(usage * 100, "%0.1f") + "% " + Utils::ToStringPrecision(temp, "%0.1f") + "°C");
-            sensor.SetValue(usage);
-            return TimerResult::Ok;
+            SetSensor(&BarCtx::cpu, "CPU: " + Utils::ToStringPrecision(usage * 100, "%0.1f") + "% " + Utils::ToStringPrecision(temp, "%0.1f") + "°C",
+                      usage);
+            Control::SetMetric("cpu-usage", Utils::ToStringPrecision(usage * 100, "%0.1f"));
+            Control::SetMetric("cpu-temp", Utils::ToStringPrecision(temp, "%0.1f"));
         }
 
-        static Text* batteryText;
-        static TimerResult UpdateBattery(Sensor& sensor)
+        static void UpdateBattery()
         {
             double percentage = System::GetBatteryPercentage();
 
-            batteryText->SetText("Battery: " + Utils::ToStringPrecision(percentage * 100, "%0.1f") + "%");
-            sensor.SetValue(percentage);
-            return TimerResult::Ok;
+            SetSensor(&BarCtx::battery, "Battery: " + Utils::ToStringPrecision(percentage * 100, "%0.1f") + "%", percentage);
+            Control::SetMetric("battery", Utils::ToStringPrecision(percentage * 100, "%0.1f"));
         }
 
-        static Text* ramText;
-        static TimerResult UpdateRAM(Sensor& sensor)
+        static void UpdateRAM()
         {
             System::RAMInfo info = System::GetRAMInfo();
             double used = info.totalGiB - info.freeGiB;
             double usedPercent = used / info.totalGiB;
 
-            ramText->SetText("RAM: " + Utils::ToStringPrecision(used, "%0.2f") + "GiB/" + Utils::ToStringPrecision(info.totalGiB, "%0.2f") + "GiB");
-            sensor.SetValue(usedPercent);
-            return TimerResult::Ok;
+            SetSensor(&BarCtx::ram, "RAM: " + Utils::ToStringPrecision(used, "%0.2f") + "GiB/" + Utils::ToStringPrecision(info.totalGiB, "%0.2f") + "GiB",
+                      usedPercent);
+            Control::SetMetric("ram-used", Utils::ToStringPrecision(used, "%0.2f"));
+            Control::SetMetric("ram-total", Utils::ToStringPrecision(info.totalGiB, "%0.2f"));
         }
 
 #if defined WITH_NVIDIA || defined WITH_AMD
-        static Text* gpuText;
-        static TimerResult UpdateGPU(Sensor& sensor)
+        static void UpdateGPU()
         {
             System::GPUInfo info = System::GetGPUInfo();
 
-            gpuText->SetText("GPU: " + Utils::ToStringPrecision(info.utilisation, "%0.1f") + "% " + Utils::ToStringPrecision(info.coreTemp, "%0.1f") +
-                             "°C");
-            sensor.SetValue(info.utilisation / 100);
-            return TimerResult::Ok;
+            SetSensor(&BarCtx::gpu,
+                      "GPU: " + Utils::ToStringPrecision(info.utilisation, "%0.1f") + "% " + Utils::ToStringPrecision(info.coreTemp, "%0.1f") + "°C",
+                      info.utilisation / 100);
+            Control::SetMetric("gpu-usage", Utils::ToStringPrecision(info.utilisation, "%0.1f"));
+            Control::SetMetric("gpu-temp", Utils::ToStringPrecision(info.coreTemp, "%0.1f"));
         }
 
-        static Text* vramText;
-        static TimerResult UpdateVRAM(Sensor& sensor)
+        static void UpdateVRAM()
         {
             System::VRAMInfo info = System::GetVRAMInfo();
 
-            vramText->SetText("VRAM: " + Utils::ToStringPrecision(info.usedGiB, "%0.2f") + "GiB/" + Utils::ToStringPrecision(info.totalGiB, "%0.2f") +
-                              "GiB");
-            sensor.SetValue(info.usedGiB / info.totalGiB);
-            return TimerResult::Ok;
+            SetSensor(&BarCtx::vram,
+                      "VRAM: " + Utils::ToStringPrecision(info.usedGiB, "%0.2f") + "GiB/" + Utils::ToStringPrecision(info.totalGiB, "%0.2f") + "GiB",
+                      info.usedGiB / info.totalGiB);
+            Control::SetMetric("vram-used", Utils::ToStringPrecision(info.usedGiB, "%0.2f"));
+            Control::SetMetric("vram-total", Utils::ToStringPrecision(info.totalGiB, "%0.2f"));
         }
 #endif
 
-        static Text* diskText;
-        static TimerResult UpdateDisk(Sensor& sensor)
+        static void UpdateDisk()
         {
             System::DiskInfo info = System::GetDiskInfo();
 
-            diskText->SetText("Disk: " + Utils::ToStringPrecision(info.usedGiB, "%0.2f") + "GiB/" + Utils::ToStringPrecision(info.totalGiB, "%0.2f") +
-                              "GiB");
-            sensor.SetValue(info.usedGiB / info.totalGiB);
-            return TimerResult::Ok;
+            SetSensor(&BarCtx::disk,
+                      "Disk: " + Utils::ToStringPrecision(info.usedGiB, "%0.2f") + "GiB/" + Utils::ToStringPrecision(info.totalGiB, "%0.2f") + "GiB",
+                      info.usedGiB / info.totalGiB);
+            Control::SetMetric("disk-used", Utils::ToStringPrecision(info.usedGiB, "%0.2f"));
+            Control::SetMetric("disk-total", Utils::ToStringPrecision(info.totalGiB, "%0.2f"));
         }
 
 #ifdef WITH_BLUEZ
-        static Button* btIconText;
-        static Text* btDevText;
-        static TimerResult UpdateBluetooth(Box&)
+        static void UpdateBluetooth(const System::BluetoothInfo& info)
         {
-            System::BluetoothInfo info = System::GetBluetoothInfo();
+            const char* iconClass;
+            const char* icon;
+            std::string btDev;
+            std::string tooltip;
             if (info.defaultController.empty())
             {
-                btIconText->SetClass("bt-label-off");
-                btIconText->SetText("󰂲");
-                btDevText->SetText("");
+                iconClass = "bt-label-off";
+                icon = "󰂲";
             }
             else if (info.devices.empty())
             {
-                btIconText->SetClass("bt-label-on");
-                btIconText->SetText("󰂯");
-                btDevText->SetText("");
+                iconClass = "bt-label-on";
+                icon = "󰂯";
             }
             else
             {
-                btIconText->SetClass("bt-label-connected");
-                btIconText->SetText("󰂱");
-                std::string btDev;
-                std::string tooltip;
+                iconClass = "bt-label-connected";
+                icon = "󰂱";
                 for (auto& dev : info.devices)
                 {
                     if (!dev.connected)
@@ -125,10 +271,14 @@ namespace Bar
                 // Delete last delim
                 if (tooltip.size())
                     tooltip.erase(tooltip.end() - 3, tooltip.end());
-                btDevText->SetTooltip(tooltip);
-                btDevText->SetText(std::move(btDev));
             }
-            return TimerResult::Ok;
+            for (auto& bar : bars)
+            {
+                bar->btIconText->SetClass(iconClass);
+                bar->btIconText->SetText(icon);
+                bar->btDevText->SetTooltip(tooltip);
+                bar->btDevText->SetText(btDev);
+            }
         }
 
         void OnBTClick(Button&)
@@ -137,43 +287,118 @@ namespace Bar
         }
 #endif
 
-        static std::mutex packageTextLock;
-        static TimerResult UpdatePackages(Text& text)
+        static void UpdatePackages()
         {
             System::GetOutdatedPackagesAsync(
-                [&](uint32_t numOutdatedPackages)
+                [](uint32_t numOutdatedPackages)
                 {
-                    packageTextLock.lock();
-                    if (numOutdatedPackages)
+                    for (auto& bar : bars)
                     {
-                        text.SetText("󰏔 ");
-                        text.SetVisible(true);
-                        text.SetClass("package-outofdate");
-                        text.SetTooltip("Updates available! (" + std::to_string(numOutdatedPackages) + " packages)");
-                    }
-                    else
-                    {
-                        text.SetText("");
-                        text.SetVisible(false);
-                        text.SetClass("package-empty");
-                        text.SetTooltip("");
+                        Text& text = *bar->packageText;
+                        if (numOutdatedPackages)
+                        {
+                            text.SetText("󰏔 ");
+                            text.SetVisible(true);
+                            text.SetClass("package-outofdate");
+                            text.SetTooltip("Updates available! (" + std::to_string(numOutdatedPackages) + " packages)");
+                        }
+                        else
+                        {
+                            text.SetText("");
+                            text.SetVisible(false);
+                            text.SetClass("package-empty");
+                            text.SetTooltip("");
+                        }
                     }
-                    packageTextLock.unlock();
                 });
-            return TimerResult::Ok;
         }
 
-        Widget* audioSlider;
-        Widget* micSlider;
-        Text* audioIcon;
-        Text* micIcon;
+        static std::vector<std::string> cameraUsers;
+        static void UpdatePrivacy()
+        {
+            std::vector<std::string> micUsers;
+            for (auto& [index, output] : System::GetSourceOutputs())
+            {
+                if (output.recording && std::find(micUsers.begin(), micUsers.end(), output.name) == micUsers.end())
+                {
+                    micUsers.push_back(output.name);
+                }
+            }
+
+            if (micUsers.empty() && cameraUsers.empty())
+            {
+                for (auto& bar : bars)
+                {
+                    bar->privacyIcon->SetText("");
+                    bar->privacyIcon->SetTooltip("");
+                    bar->privacyIcon->SetClass("privacy-inactive");
+                    bar->privacyIcon->SetVisible(false);
+                }
+                return;
+            }
+
+            std::string icon;
+            std::string tooltip;
+            if (!cameraUsers.empty())
+            {
+                icon += "󰄀";
+                tooltip += "Camera: ";
+                for (auto& user : cameraUsers)
+                {
+                    tooltip += user + " & ";
+                }
+                tooltip.erase(tooltip.end() - 3, tooltip.end());
+            }
+            if (!micUsers.empty())
+            {
+                icon += "󰍬";
+                if (tooltip.size())
+                    tooltip += "\n";
+                tooltip += "Microphone: ";
+                for (auto& user : micUsers)
+                {
+                    tooltip += user + " & ";
+                }
+                tooltip.erase(tooltip.end() - 3, tooltip.end());
+            }
+            for (auto& bar : bars)
+            {
+                bar->privacyIcon->SetText(icon);
+                bar->privacyIcon->SetTooltip(tooltip);
+                bar->privacyIcon->SetClass("privacy-active");
+                bar->privacyIcon->SetVisible(true);
+            }
+        }
+
+        static void UpdateCameraUsers()
+        {
+            // Only scan, while someone can actually see the indicator.
+            bool mapped = std::any_of(bars.begin(), bars.end(),
+                                      [](const std::unique_ptr<BarCtx>& bar)
+                                      {
+                                          return bar->privacyBox->IsMapped();
+                                      });
+            if (!mapped)
+            {
+                return;
+            }
+            std::vector<std::string> users = System::GetCameraUsers();
+            if (users != cameraUsers)
+            {
+                cameraUsers = std::move(users);
+                UpdatePrivacy();
+            }
+        }
+
         void OnChangeVolumeSink(Slider&, double value)
         {
+            OSD::Inhibit(OSD::Type::Volume);
             System::SetVolumeSink(value);
         }
 
         void OnChangeVolumeSource(Slider&, double value)
         {
+            OSD::Inhibit(OSD::Type::Mic);
             System::SetVolumeSource(value);
         }
 
@@ -183,6 +408,7 @@ namespace Bar
         {
             audioVolume += delta;
             audioVolume = std::clamp(audioVolume, 0.0, 1.0);
+            OSD::Inhibit(OSD::Type::Volume);
             System::SetVolumeSink(audioVolume);
         }
 
@@ -191,93 +417,323 @@ namespace Bar
         {
             micVolume += delta;
             micVolume = std::clamp(micVolume, 0.0, 1.0);
+            OSD::Inhibit(OSD::Type::Mic);
             System::SetVolumeSource(micVolume);
         }
 
-        TimerResult UpdateAudio(Widget&)
+        void UpdateAudio(const System::AudioInfo& info)
         {
-            System::AudioInfo info = System::GetAudioInfo();
-            if (Config::Get().audioNumbers)
-            {
-                audioVolume = info.sinkVolume;
-                ((Text*)audioSlider)->SetText(Utils::ToStringPrecision(info.sinkVolume * 100, "%0.0f") + "%");
-            }
-            else
-            {
-                ((Slider*)audioSlider)->SetValue(info.sinkVolume);
-            }
-            if (info.sinkMuted)
-            {
-                audioIcon->SetText("󰝟");
-            }
-            else
-            {
-                audioIcon->SetText("󰕾");
-            }
-            if (Config::Get().audioInput)
+            Control::SetMetric("volume", Utils::ToStringPrecision(info.sinkVolume * 100, "%0.0f"));
+            Control::SetMetric("volume-muted", info.sinkMuted ? "1" : "0");
+            Control::SetMetric("mic-volume", Utils::ToStringPrecision(info.sourceVolume * 100, "%0.0f"));
+            Control::SetMetric("mic-muted", info.sourceMuted ? "1" : "0");
+            audioVolume = info.sinkVolume;
+            micVolume = info.sourceVolume;
+            for (auto& bar : bars)
             {
                 if (Config::Get().audioNumbers)
                 {
-                    micVolume = info.sourceVolume;
-                    ((Text*)micSlider)->SetText(Utils::ToStringPrecision(info.sourceVolume * 100, "%0.0f") + "%");
+                    ((Text*)bar->audioSlider)->SetText(Utils::ToStringPrecision(info.sinkVolume * 100, "%0.0f") + "%");
                 }
                 else
                 {
-                    ((Slider*)micSlider)->SetValue(info.sinkVolume);
+                    ((Slider*)bar->audioSlider)->SetValue(info.sinkVolume);
                 }
-                if (info.sourceMuted)
+                if (info.sinkMuted)
                 {
-                    micIcon->SetText("󰍭");
+                    bar->audioIcon->SetText("󰝟");
                 }
                 else
                 {
-                    micIcon->SetText("󰍬");
+                    bar->audioIcon->SetText("󰕾");
+                }
+                if (Config::Get().audioInput)
+                {
+                    if (Config::Get().audioNumbers)
+                    {
+                        ((Text*)bar->micSlider)->SetText(Utils::ToStringPrecision(info.sourceVolume * 100, "%0.0f") + "%");
+                    }
+                    else
+                    {
+                        ((Slider*)bar->micSlider)->SetValue(info.sourceVolume);
+                    }
+                    if (info.sourceMuted)
+                    {
+                        bar->micIcon->SetText("󰍭");
+                    }
+                    else
+                    {
+                        bar->micIcon->SetText("󰍬");
+                    }
                 }
             }
-            return TimerResult::Ok;
         }
 
-        Text* networkText;
-        TimerResult UpdateNetwork(NetworkSensor& sensor)
+        void UpdateNetwork()
         {
             double bpsUp = System::GetNetworkBpsUpload(updateTime / 1000.0);
             double bpsDown = System::GetNetworkBpsDownload(updateTime / 1000.0);
 
             std::string upload = Utils::StorageUnitDynamic(bpsUp, "%0.1f%s");
             std::string download = Utils::StorageUnitDynamic(bpsDown, "%0.1f%s");
+            std::string text = Config::Get().networkAdapter + ": " + upload + " Up/" + download + " Down";
 
-            networkText->SetText(Config::Get().networkAdapter + ": " + upload + " Up/" + download + " Down");
+            for (auto& bar : bars)
+            {
+                bar->networkText->SetText(text);
+                bar->networkSensor->SetUp(bpsUp);
+                bar->networkSensor->SetDown(bpsDown);
+            }
+            Control::SetMetric("net-up", Utils::ToStringPrecision(bpsUp, "%0.0f"));
+            Control::SetMetric("net-down", Utils::ToStringPrecision(bpsDown, "%0.0f"));
+        }
 
-            sensor.SetUp(bpsUp);
-            sensor.SetDown(bpsDown);
+        void UpdateTime()
+        {
+            std::string time = System::GetTime();
+            for (auto& bar : bars)
+            {
+                bar->timeText->SetText(time);
+            }
+        }
 
-            return TimerResult::Ok;
+        // Every value is read once per tick, no matter how many bars show it. All bars have the same widgets.
+        static void SampleAll()
+        {
+            if (bars.empty())
+            {
+                // All monitors are gone
+                return;
+            }
+            const BarCtx& first = *bars.front();
+            UpdateTime();
+            if (first.disk.sensor)
+                UpdateDisk();
+#if defined WITH_NVIDIA || defined WITH_AMD
+            if (first.gpu.sensor)
+            {
+                UpdateVRAM();
+                UpdateGPU();
+            }
+#endif
+            if (first.ram.sensor)
+                UpdateRAM();
+            if (first.cpu.sensor)
+                UpdateCPU();
+            if (first.battery.sensor)
+                UpdateBattery();
+            if (first.networkSensor)
+                UpdateNetwork();
         }
 
-        TimerResult UpdateTime(Text& text)
+        // Deferred to the main loop, so every bar of this process exists before the first sample.
+        static void StartSamplers()
         {
-            text.SetText(System::GetTime());
-            return TimerResult::Ok;
+            g_idle_add(
+                +[](void*) -> int
+                {
+                    SampleAll();
+                    g_timeout_add(
+                        updateTime,
+                        +[](void*) -> int
+                        {
+                            SampleAll();
+                            return G_SOURCE_CONTINUE;
+                        },
+                        nullptr);
+
+                    UpdatePackages();
+                    g_timeout_add(
+                        1000 * Config::Get().checkUpdateInterval,
+                        +[](void*) -> int
+                        {
+                            UpdatePackages();
+                            return G_SOURCE_CONTINUE;
+                        },
+                        nullptr);
+
+                    if (!bars.empty() && bars.front()->privacyBox && Config::Get().privacyCamera)
+                    {
+                        g_timeout_add(
+                            1000 * Config::Get().privacyCameraInterval,
+                            +[](void*) -> int
+                            {
+                                UpdateCameraUsers();
+                                return G_SOURCE_CONTINUE;
+                            },
+                            nullptr);
+                    }
+                    return G_SOURCE_REMOVE;
+                },
+                nullptr);
+        }
+
+        void UpdateWindowTitle()
+        {
+            System::WindowInfo info = System::GetActiveWindow();
+            for (auto& bar : bars)
+            {
+                // Both only do something, if the text has actually changed. The title never changes the size of the bar.
+                bar->windowAppId->SetText(info.appId);
+                bar->windowTitle->SetText(info.title);
+            }
         }
 
 #ifdef WITH_WORKSPACES
-        static std::array<Button*, 9> workspaces;
-        TimerResult UpdateWorkspaces(Box&)
+        // Reused between updates
+        static std::vector<System::WorkspaceInfo> workspaceInfos;
+
+        const char* GetWorkspaceClass(System::WorkspaceStatus status)
+        {
+            switch (status)
+            {
+            case System::WorkspaceStatus::Dead: return "ws-dead";
+            case System::WorkspaceStatus::Inactive: return "ws-inactive";
+            case System::WorkspaceStatus::Visible: return "ws-visible";
+            case System::WorkspaceStatus::Current: return "ws-current";
+            case System::WorkspaceStatus::Active: return "ws-active";
+            }
+            return "ws-dead";
+        }
+
+        void UpdateWorkspaceIcons(WorkspaceButton& workspace)
+        {
+            while (!workspace.icons->GetWidgets().empty())
+            {
+                workspace.icons->RemoveChild((size_t)0);
+            }
+            uint32_t size = Config::Get().workspaceIconSize;
+            for (const std::string& appId : workspace.apps)
+            {
+                const AppIcons::Icon* icon = AppIcons::Get(appId, size);
+                if (!icon)
+                {
+                    continue;
+                }
+                auto texture = Widget::Create<Texture>();
+                Utils::SetTransform(*texture, {(int)size, false, Alignment::Fill}, {(int)size, false, Alignment::Center});
+                texture->SetBuf(icon->width, icon->height, icon->data.data());
+                texture->SetTooltip(appId);
+                texture->SetAngle(Utils::GetAngle() == 270 ? 90 : 0);
+                workspace.icons->AddChild(std::move(texture));
+            }
+        }
+
+        WorkspaceButton& CreateWorkspaceButton(BarCtx& bar, const System::WorkspaceInfo& info)
+        {
+            auto button = Widget::Create<Button>();
+            Utils::SetTransform(*button, {8, false, Alignment::Fill});
+            button->OnClick(
+                [info](Button&)
+                {
+                    System::GotoWorkspace(info);
+                });
+            WorkspaceButton& workspace = bar.workspaceButtons[info.key];
+            workspace.root = button.get();
+            workspace.button = button.get();
+            workspace.status = info.status;
+            workspace.text = System::GetWorkspaceSymbol(info) + " ";
+            workspace.button->SetClass(GetWorkspaceClass(info.status));
+            workspace.button->SetText(workspace.text);
+            if (!Config::Get().workspaceIcons)
+            {
+                bar.workspaceBox->AddChild(std::move(button));
+                return workspace;
+            }
+
+            auto container = Widget::Create<Box>();
+            container->SetOrientation(Utils::GetOrientation());
+            container->SetSpacing({0, false});
+            auto icons = Widget::Create<Box>();
+            icons->SetOrientation(Utils::GetOrientation());
+            icons->SetSpacing({2, false});
+            icons->SetClass("ws-icons");
+            workspace.root = container.get();
+            workspace.icons = icons.get();
+            workspace.apps = info.apps;
+            UpdateWorkspaceIcons(workspace);
+            container->AddChild(std::move(button));
+            container->AddChild(std::move(icons));
+            bar.workspaceBox->AddChild(std::move(container));
+            return workspace;
+        }
+
+        // Only touches the buttons, that have actually changed. Restyling is what's expensive, not this loop.
+        void UpdateWorkspaces(BarCtx& bar)
         {
-            System::PollWorkspaces((uint32_t)monitorID, workspaces.size());
-            for (size_t i = 0; i < workspaces.size(); i++)
+            System::GetWorkspaces((uint32_t)bar.monitor, workspaceInfos);
+            uint32_t generation = ++bar.workspaceGeneration;
+            auto& workspaceButtons = bar.workspaceButtons;
+            auto& workspaceOrder = bar.workspaceOrder;
+
+            bool orderChanged = workspaceOrder.size() != workspaceInfos.size();
+            for (size_t i = 0; i < workspaceInfos.size(); i++)
+            {
+                const System::WorkspaceInfo& info = workspaceInfos[i];
+                auto it = workspaceButtons.find(info.key);
+                if (it == workspaceButtons.end())
+                {
+                    CreateWorkspaceButton(bar, info).generation = generation;
+                    orderChanged = true;
+                    continue;
+                }
+                WorkspaceButton& workspace = it->second;
+                workspace.generation = generation;
+                if (workspace.status != info.status)
+                {
+                    workspace.status = info.status;
+                    workspace.button->SetClass(GetWorkspaceClass(info.status));
+                }
+                const std::string& symbol = System::GetWorkspaceSymbol(info);
+                // text is symbol + " "
+                if (workspace.text.compare(0, workspace.text.size() - 1, symbol) != 0)
+                {
+                    workspace.text = symbol + " ";
+                    workspace.button->SetText(workspace.text);
+                }
+                if (workspace.icons && workspace.apps != info.apps)
+                {
+                    workspace.apps = info.apps;
+                    UpdateWorkspaceIcons(workspace);
+                }
+                if (!orderChanged && workspaceOrder[i] != info.key)
+                {
+                    orderChanged = true;
+                }
+            }
+
+            // Gone workspaces
+            for (auto it = workspaceButtons.begin(); it != workspaceButtons.end();)
+            {
+                if (it->second.generation != generation)
+                {
+                    bar.workspaceBox->RemoveChild(it->second.root);
+                    it = workspaceButtons.erase(it);
+                    orderChanged = true;
+                }
+                else
+                {
+                    it++;
+                }
+            }
+
+            if (orderChanged)
             {
-                switch (System::GetWorkspaceStatus(i + 1))
+                workspaceOrder.clear();
+                for (size_t i = 0; i < workspaceInfos.size(); i++)
                 {
-                case System::WorkspaceStatus::Dead: workspaces[i]->SetClass("ws-dead"); break;
-                case System::WorkspaceStatus::Inactive: workspaces[i]->SetClass("ws-inactive"); break;
-                case System::WorkspaceStatus::Visible: workspaces[i]->SetClass("ws-visible"); break;
-                case System::WorkspaceStatus::Current: workspaces[i]->SetClass("ws-current"); break;
-                case System::WorkspaceStatus::Active: workspaces[i]->SetClass("ws-active"); break;
+                    workspaceOrder.push_back(workspaceInfos[i].key);
+                    bar.workspaceBox->ReorderChild(workspaceButtons.at(workspaceInfos[i].key).root, i);
                 }
-                workspaces[i]->SetText(System::GetWorkspaceSymbol(i));
             }
-            return TimerResult::Ok;
+        }
+
+        void UpdateAllWorkspaces()
+        {
+            for (auto& bar : bars)
+            {
+                UpdateWorkspaces(*bar);
+            }
         }
 
         void ScrollWorkspaces(EventBox&, ScrollDirection direction)
@@ -302,7 +758,7 @@ namespace Bar
 #endif
     }
 
-    void WidgetSensor(Widget& parent, TimerCallback<Sensor>&& callback, const std::string& sensorClass, const std::string& textClass, Text*& textPtr)
+    void WidgetSensor(Widget& parent, const std::string& sensorClass, const std::string& textClass, DynCtx::SensorWidgets& widgets)
     {
         auto eventBox = Widget::Create<EventBox>();
         {
@@ -324,7 +780,7 @@ namespace Bar
                     text->SetClass(textClass);
                     text->SetAngle(Utils::GetAngle());
                     Utils::SetTransform(*text, {-1, true, Alignment::Fill, 0, 6});
-                    textPtr = text.get();
+                    widgets.text = text.get();
                     revealer->AddChild(std::move(text));
                 }
 
@@ -339,7 +795,7 @@ namespace Bar
                 case 'R': angle = 0; break;
                 }
                 sensor->SetStyle({angle});
-                sensor->AddTimer<Sensor>(std::move(callback), DynCtx::updateTime);
+                widgets.sensor = sensor.get();
                 Utils::SetTransform(*sensor, {24, true, Alignment::Fill});
 
                 box->AddChild(std::move(revealer));
@@ -352,14 +808,14 @@ namespace Bar
     }
 
     // Handles in and out
-    void WidgetAudio(Widget& parent)
+    void WidgetAudio(Widget& parent, DynCtx::BarCtx& bar)
     {
         enum class AudioType
         {
             Input,
             Output
         };
-        auto widgetAudioVolume = [](Widget& parent, AudioType type)
+        auto widgetAudioVolume = [&bar](Widget& parent, AudioType type)
         {
             if (Config::Get().audioNumbers)
             {
@@ -371,11 +827,11 @@ namespace Bar
                 {
                 case AudioType::Input:
                     text->SetClass("mic-volume");
-                    DynCtx::micSlider = text.get();
+                    bar.micSlider = text.get();
                     break;
                 case AudioType::Output:
                     text->SetClass("audio-volume");
-                    DynCtx::audioSlider = text.get();
+                    bar.audioSlider = text.get();
                     break;
                 }
                 eventBox->SetScrollFn(
@@ -403,12 +859,12 @@ namespace Bar
                 case AudioType::Input:
                     slider->SetClass("mic-volume");
                     slider->OnValueChange(DynCtx::OnChangeVolumeSource);
-                    DynCtx::micSlider = slider.get();
+                    bar.micSlider = slider.get();
                     break;
                 case AudioType::Output:
                     slider->SetClass("audio-volume");
                     slider->OnValueChange(DynCtx::OnChangeVolumeSink);
-                    DynCtx::audioSlider = slider.get();
+                    bar.audioSlider = slider.get();
                     break;
                 }
                 slider->SetRange({0, 1, 0.01});
@@ -418,7 +874,7 @@ namespace Bar
             }
         };
 
-        auto widgetAudioBody = [&widgetAudioVolume](Widget& parent, AudioType type)
+        auto widgetAudioBody = [&bar, &widgetAudioVolume](Widget& parent, AudioType type)
         {
             auto box = Widget::Create<Box>();
             box->SetSpacing({8, false});
@@ -432,13 +888,13 @@ namespace Bar
                 case AudioType::Input:
                     icon->SetClass("mic-icon");
                     icon->SetText("󰍬");
-                    DynCtx::micIcon = icon.get();
+                    bar.micIcon = icon.get();
                     break;
                 case AudioType::Output:
                     icon->SetClass("audio-icon");
                     icon->SetText("󰕾 ");
                     Utils::SetTransform(*icon, {-1, true, Alignment::Fill, 0, 6});
-                    DynCtx::audioIcon = icon.get();
+                    bar.audioIcon = icon.get();
                     break;
                 }
 
@@ -493,22 +949,38 @@ namespace Bar
             }
             widgetAudioBody(parent, AudioType::Output);
         }
-        parent.AddTimer<Widget>(DynCtx::UpdateAudio, DynCtx::updateTimeFast);
     }
 
-    void WidgetPackages(Widget& parent)
+    void WidgetPackages(Widget& parent, DynCtx::BarCtx& bar)
     {
         auto text = Widget::Create<Text>();
         text->SetText("");
         text->SetVisible(false);
         text->SetClass("package-empty");
         text->SetAngle(Utils::GetAngle());
-        text->AddTimer<Text>(DynCtx::UpdatePackages, 1000 * Config::Get().checkUpdateInterval, TimerDispatchBehaviour::ImmediateDispatch);
+        bar.packageText = text.get();
         parent.AddChild(std::move(text));
     }
 
+    void WidgetPrivacy(Widget& parent, DynCtx::BarCtx& bar)
+    {
+        auto box = Widget::Create<Box>();
+        box->SetSpacing({0, false});
+        box->SetOrientation(Utils::GetOrientation());
+        {
+            auto icon = Widget::Create<Text>();
+            icon->SetText("");
+            icon->SetClass("privacy-inactive");
+            icon->SetAngle(Utils::GetAngle());
+            bar.privacyIcon = icon.get();
+            box->AddChild(std::move(icon));
+        }
+        bar.privacyBox = box.get();
+        parent.AddChild(std::move(box));
+    }
+
 #ifdef WITH_BLUEZ
-    void WidgetBluetooth(Widget& parent)
+    void WidgetBluetooth(Widget& parent, DynCtx::BarCtx& bar)
     {
         auto box = Widget::Create<Box>();
         box->SetSpacing({0, false});
@@ -516,25 +988,23 @@ namespace Bar
         {
             auto devText = Widget::Create<Text>();
             devText->SetAngle(Utils::GetAngle());
-            DynCtx::btDevText = devText.get();
+            bar.btDevText = devText.get();
             devText->SetClass("bt-num");
 
             auto iconText = Widget::Create<Button>();
             iconText->OnClick(DynCtx::OnBTClick);
             iconText->SetAngle(Utils::GetAngle());
             Utils::SetTransform(*iconText, {-1, true, Alignment::Fill, 0, 6});
-            DynCtx::btIconText = iconText.get();
+            bar.btIconText = iconText.get();
 
             box->AddChild(std::move(devText));
             box->AddChild(std::move(iconText));
         }
-        box->AddTimer<Box>(DynCtx::UpdateBluetooth, DynCtx::updateTime);
-
         parent.AddChild(std::move(box));
     }
 #endif
 
-    void WidgetNetwork(Widget& parent)
+    void WidgetNetwork(Widget& parent, DynCtx::BarCtx& bar)
     {
         auto eventBox = Widget::Create<EventBox>();
         {
@@ -556,7 +1026,7 @@ namespace Bar
                     text->SetClass("network-data-text");
                     text->SetAngle(Utils::GetAngle());
                     Utils::SetTransform(*text, {-1, true, Alignment::Fill, 0, 6});
-                    DynCtx::networkText = text.get();
+                    bar.networkText = text.get();
                     revealer->AddChild(std::move(text));
                 }
 
@@ -564,7 +1034,7 @@ namespace Bar
                 sensor->SetLimitUp({(double)Config::Get().minUploadBytes, (double)Config::Get().maxUploadBytes});
                 sensor->SetLimitDown({(double)Config::Get().minDownloadBytes, (double)Config::Get().maxDownloadBytes});
                 sensor->SetAngle(Utils::GetAngle());
-                sensor->AddTimer<NetworkSensor>(DynCtx::UpdateNetwork, DynCtx::updateTime);
+                bar.networkSensor = sensor.get();
                 Utils::SetTransform(*sensor, {24, true, Alignment::Fill});
 
                 box->AddChild(std::move(revealer));
@@ -576,57 +1046,43 @@ namespace Bar
         parent.AddChild(std::move(eventBox));
     }
 
-    void WidgetSensors(Widget& parent)
+    void WidgetSensors(Widget& parent, DynCtx::BarCtx& bar)
     {
-        WidgetSensor(parent, DynCtx::UpdateDisk, "disk-util-progress", "disk-data-text", DynCtx::diskText);
+        WidgetSensor(parent, "disk-util-progress", "disk-data-text", bar.disk);
 #if defined WITH_NVIDIA || defined WITH_AMD
         if (RuntimeConfig::Get().hasNvidia || RuntimeConfig::Get().hasAMD)
         {
-            WidgetSensor(parent, DynCtx::UpdateVRAM, "vram-util-progress", "vram-data-text", DynCtx::vramText);
-            WidgetSensor(parent, DynCtx::UpdateGPU, "gpu-util-progress", "gpu-data-text", DynCtx::gpuText);
+            WidgetSensor(parent, "vram-util-progress", "vram-data-text", bar.vram);
+            WidgetSensor(parent, "gpu-util-progress", "gpu-data-text", bar.gpu);
         }
 #endif
-        WidgetSensor(parent, DynCtx::UpdateRAM, "ram-util-progress", "ram-data-text", DynCtx::ramText);
-        WidgetSensor(parent, DynCtx::UpdateCPU, "cpu-util-progress", "cpu-data-text", DynCtx::cpuText);
+        WidgetSensor(parent, "ram-util-progress", "ram-data-text", bar.ram);
+        WidgetSensor(parent, "cpu-util-progress", "cpu-data-text", bar.cpu);
         // Only show battery percentage if battery folder is set and exists
         if (System::GetBatteryPercentage() >= 0)
         {
-            WidgetSensor(parent, DynCtx::UpdateBattery, "battery-util-progress", "battery-data-text", DynCtx::batteryText);
+            WidgetSensor(parent, "battery-util-progress", "battery-data-text", bar.battery);
         }
     }
 
-    void WidgetPower(Widget& parent)
+    void WidgetPower(Widget& parent, DynCtx::BarCtx& bar)
     {
-        // TODO: Abstract this (Currently not DRY)
-        static bool activatedExit = false;
-        static bool activatedLock = false;
-        static bool activatedSuspend = false;
-        static bool activatedReboot = false;
-        static bool activatedShutdown = false;
-
-        auto setActivate = [](Button& button, bool& activeBool, bool activate)
+        auto setupButton = [](Button& button, DynCtx::PowerButton& power, void (*action)())
         {
-            if (activate)
-            {
-                button.AddClass("system-confirm");
-                button.AddTimer<Button>(
-                    [&](Button& button)
-                    {
-                        button.RemoveClass("system-confirm");
-                        activeBool = false;
-                        return TimerResult::Delete;
-                    },
-                    2000, TimerDispatchBehaviour::LateDispatch);
-            }
-            else
-            {
-                button.RemoveClass("system-confirm");
-            }
-            activeBool = activate;
+            power.button = &button;
+            button.OnClick(
+                [&power, action](Button&)
+                {
+                    DynCtx::OnPowerClick(power, action);
+                });
         };
 
         auto eventBox = Widget::Create<EventBox>();
-        eventBox->SetHoverFn(DynCtx::PowerBoxEvent);
+        eventBox->SetHoverFn(
+            [&bar](EventBox&, bool hovered)
+            {
+                DynCtx::PowerBoxEvent(bar, hovered);
+            });
         {
             auto powerBox = Widget::Create<Box>();
             powerBox->SetClass("power-box");
@@ -635,7 +1091,7 @@ namespace Bar
             powerBox->SetOrientation(Utils::GetOrientation());
             {
                 auto revealer = Widget::Create<Revealer>();
-                DynCtx::powerBoxRevealer = revealer.get();
+                bar.powerBoxRevealer = revealer.get();
                 revealer->SetTransition({Utils::GetTransitionType(), 500});
                 {
                     auto powerBoxExpand = Widget::Create<Box>();
@@ -648,74 +1104,26 @@ namespace Bar
                         exitButton->SetClass("exit-button");
                         exitButton->SetText("󰗼");
                         exitButton->SetAngle(Utils::GetAngle());
-                        exitButton->OnClick(
-                            [setActivate](Button& but)
-                            {
-                                if (activatedExit)
-                                {
-                                    System::ExitWM();
-                                    setActivate(but, activatedExit, false);
-                                }
-                                else
-                                {
-                                    setActivate(but, activatedExit, true);
-                                }
-                            });
+                        setupButton(*exitButton, bar.exitButton, System::ExitWM);
 
                         auto lockButton = Widget::Create<Button>();
                         lockButton->SetClass("sleep-button");
                         lockButton->SetText("");
                         lockButton->SetAngle(Utils::GetAngle());
-                        lockButton->OnClick(
-                            [setActivate](Button& but)
-                            {
-                                if (activatedLock)
-                                {
-                                    System::Lock();
-                                    setActivate(but, activatedLock, false);
-                                }
-                                else
-                                {
-                                    setActivate(but, activatedLock, true);
-                                }
-                            });
+                        setupButton(*lockButton, bar.lockButton, System::Lock);
 
                         auto sleepButton = Widget::Create<Button>();
                         sleepButton->SetClass("sleep-button");
                         sleepButton->SetText("󰏤");
                         sleepButton->SetAngle(Utils::GetAngle());
-                        sleepButton->OnClick(
-                            [setActivate](Button& but)
-                            {
-                                if (activatedSuspend)
-                                {
-                                    System::Suspend();
-                                    setActivate(but, activatedSuspend, false);
-                                }
-                                else
-                                {
-                                    setActivate(but, activatedSuspend, true);
-                                }
-                            });
+                        setupButton(*sleepButton, bar.suspendButton, System::Suspend);
 
                         auto rebootButton = Widget::Create<Button>();
                         rebootButton->SetClass("reboot-button");
                         rebootButton->SetText("󰑐");
                         rebootButton->SetAngle(Utils::GetAngle());
                         Utils::SetTransform(*rebootButton, {-1, true, Alignment::Fill, 0, 6});
-                        rebootButton->OnClick(
-                            [setActivate](Button& but)
-                            {
-                                if (activatedReboot)
-                                {
-                                    System::Reboot();
-                                    setActivate(but, activatedReboot, false);
-                                }
-                                else
-                                {
-                                    setActivate(but, activatedReboot, true);
-                                }
-                            });
+                        setupButton(*rebootButton, bar.rebootButton, System::Reboot);
 
                         powerBoxExpand->AddChild(std::move(exitButton));
                         powerBoxExpand->AddChild(std::move(lockButton));
@@ -731,19 +1139,7 @@ namespace Bar
                 powerButton->SetText(" ");
                 powerButton->SetAngle(Utils::GetAngle());
                 Utils::SetTransform(*powerButton, {24, true, Alignment::Fill});
-                powerButton->OnClick(
-                    [setActivate](Button& but)
-                    {
-                        if (activatedShutdown)
-                        {
-                            System::Shutdown();
-                            setActivate(but, activatedShutdown, false);
-                        }
-                        else
-                        {
-                            setActivate(but, activatedShutdown, true);
-                        }
-                    });
+                setupButton(*powerButton, bar.shutdownButton, System::Shutdown);
 
                 powerBox->AddChild(std::move(revealer));
                 powerBox->AddChild(std::move(powerButton));
@@ -754,8 +1150,28 @@ namespace Bar
         parent.AddChild(std::move(eventBox));
     }
 
+    void WidgetWindowTitle(Widget& parent, DynCtx::BarCtx& bar)
+    {
+        auto box = Widget::Create<Box>();
+        box->SetSpacing({8, false});
+        box->SetHorizontalTransform({-1, false, Alignment::Left, 12, 0});
+        {
+            auto appId = Widget::Create<Text>();
+            appId->SetClass("window-app-id");
+            bar.windowAppId = appId.get();
+            box->AddChild(std::move(appId));
+
+            auto title = Widget::Create<ElidedText>();
+            title->SetClass("window-title");
+            title->SetHorizontalTransform({(int)Config::Get().windowTitleWidth, false, Alignment::Left});
+            bar.windowTitle = title.get();
+            box->AddChild(std::move(title));
+        }
+        parent.AddChild(std::move(box));
+    }
+
 #ifdef WITH_WORKSPACES
-    void WidgetWorkspaces(Widget& parent)
+    void WidgetWorkspaces(Widget& parent, DynCtx::BarCtx& bar)
     {
         auto eventBox = Widget::Create<EventBox>();
         eventBox->SetScrollFn(DynCtx::ScrollWorkspaces);
@@ -764,30 +1180,89 @@ namespace Bar
             box->SetSpacing({8, true});
             box->SetOrientation(Utils::GetOrientation());
             Utils::SetTransform(*box, {-1, true, Alignment::Left, 12, 0});
-            {
-                for (size_t i = 0; i < DynCtx::workspaces.size(); i++)
-                {
-                    auto workspace = Widget::Create<Button>();
-                    Utils::SetTransform(*workspace, {8, false, Alignment::Fill});
-                    workspace->OnClick(
-                        [i](Button&)
-                        {
-                            System::GotoWorkspace((uint32_t)i + 1);
-                        });
-                    DynCtx::workspaces[i] = workspace.get();
-                    box->AddChild(std::move(workspace));
-                }
-            }
-            box->AddTimer<Box>(DynCtx::UpdateWorkspaces, DynCtx::updateTimeFast);
+            // Buttons are created by DynCtx::UpdateWorkspaces
+            bar.workspaceBox = box.get();
             eventBox->AddChild(std::move(box));
         }
         parent.AddChild(std::move(eventBox));
     }
 #endif
 
+    // Callbacks, samplers and commands shared by all bars. Created with the first bar.
+    static void CreateShared()
+    {
+        const DynCtx::BarCtx& first = *DynCtx::bars.front();
+
+        // PulseAudio tells us when something changed, so no need to poll.
+        System::AddAudioCallback(DynCtx::UpdateAudio);
+        if (first.privacyIcon)
+        {
+            // Recording streams are tracked by PulseAudio events, no need to poll
+            System::AddSourceOutputCallback(
+                [](System::ChangeType, const System::SourceOutput&)
+                {
+                    DynCtx::UpdatePrivacy();
+                });
+        }
+        if (first.windowTitle)
+        {
+            System::AddActiveWindowCallback(DynCtx::UpdateWindowTitle);
+        }
+#ifdef WITH_WORKSPACES
+        if (first.workspaceBox)
+        {
+            System::AddWorkspaceCallback(DynCtx::UpdateAllWorkspaces);
+        }
+#endif
+#ifdef WITH_BLUEZ
+        if (first.btIconText)
+        {
+            // Driven by BlueZ signals, no need to poll
+            System::AddBluetoothCallback(DynCtx::UpdateBluetooth);
+        }
+#endif
+        DynCtx::StartSamplers();
+
+        Control::AddCommand("toggle",
+                            [](const std::vector<std::string_view>& args, std::string& response)
+                            {
+                                // Optionally only the bar on one monitor
+                                int32_t monitor = args.size() == 3 ? atoi(std::string(args[2]).c_str()) : -1;
+                                bool handled = false;
+                                for (auto& bar : DynCtx::bars)
+                                {
+                                    if (args.size() == 3 && bar->monitor != monitor)
+                                    {
+                                        continue;
+                                    }
+                                    if ((args.size() == 2 || args.size() == 3) && args[1] == "bar")
+                                    {
+                                        if (bar->window->IsVisible())
+                                            bar->window->Hide();
+                                        else
+                                            bar->window->Show();
+                                        handled = true;
+                                    }
+                                    else if ((args.size() == 2 || args.size() == 3) && args[1] == "power" && bar->powerBoxRevealer)
+                                    {
+                                        bar->powerBoxRevealed = !bar->powerBoxRevealed;
+                                        bar->powerBoxRevealer->SetRevealed(bar->powerBoxRevealed);
+                                        handled = true;
+                                    }
+                                }
+                                if (!handled)
+                                {
+                                    response = "usage: toggle bar|power [monitor]";
+                                }
+                                return handled;
+                            });
+    }
+
     void Create(Window& window, int32_t monitor)
     {
-        monitorID = monitor;
+        DynCtx::BarCtx& bar = *DynCtx::bars.emplace_back(std::make_unique<DynCtx::BarCtx>());
+        bar.window = &window;
+        bar.monitor = monitor;
 
         auto mainWidget = Widget::Create<Box>();
         mainWidget->SetOrientation(Utils::GetOrientation());
@@ -816,9 +1291,13 @@ namespace Bar
 #ifdef WITH_WORKSPACES
             if (RuntimeConfig::Get().hasWorkspaces)
             {
-                WidgetWorkspaces(*left);
+                WidgetWorkspaces(*left, bar);
             }
 #endif
+            if (Config::Get().windowTitle && !topToBottom)
+            {
+                WidgetWindowTitle(*left, bar);
+            }
 
             auto center = Widget::Create<Box>();
             center->SetOrientation(Utils::GetOrientation());
@@ -829,7 +1308,7 @@ namespace Bar
                 time->SetAngle(Utils::GetAngle());
                 time->SetClass("time-text");
                 time->SetText("Uninitialized");
-                time->AddTimer<Text>(DynCtx::UpdateTime, 1000);
+                bar.timeText = time.get();
                 center->AddChild(std::move(time));
             }
 
@@ -838,25 +1317,33 @@ namespace Bar
             right->SetSpacing({8, false});
             right->SetOrientation(Utils::GetOrientation());
             Utils::SetTransform(*right, {-1, true, Alignment::Right, 0, 10});
+            bar.rightBox = right.get();
             {
 #ifdef WITH_SNI
-                SNI::WidgetSNI(*right);
+                if (!DynCtx::trayBar)
+                {
+                    SNI::WidgetSNI(*right);
+                    DynCtx::trayBar = &bar;
+                }
 #endif
 
-                WidgetPackages(*right);
+                if (Config::Get().privacyIndicator)
+                    WidgetPrivacy(*right, bar);
+
+                WidgetPackages(*right, bar);
 
-                WidgetAudio(*right);
+                WidgetAudio(*right, bar);
 
 #ifdef WITH_BLUEZ
                 if (RuntimeConfig::Get().hasBlueZ)
-                    WidgetBluetooth(*right);
+                    WidgetBluetooth(*right, bar);
 #endif
                 if (Config::Get().networkWidget && RuntimeConfig::Get().hasNet)
-                    WidgetNetwork(*right);
+                    WidgetNetwork(*right, bar);
 
-                WidgetSensors(*right);
+                WidgetSensors(*right, bar);
 
-                WidgetPower(*right);
+                WidgetPower(*right, bar);
             }
 
             mainWidget->AddChild(std::move(left));
@@ -875,5 +1362,121 @@ namespace Bar
         }
         window.SetAnchor(anchor);
         window.SetMainWidget(std::move(mainWidget));
+
+        if (!DynCtx::sharedCreated)
+        {
+            DynCtx::sharedCreated = true;
+            CreateShared();
+        }
+        // Event driven widgets start with the current state. Polled ones get it with the next sample.
+        DynCtx::UpdateAudio(System::GetAudioInfo());
+        if (bar.privacyIcon)
+            DynCtx::UpdatePrivacy();
+        if (bar.windowTitle)
+            DynCtx::UpdateWindowTitle();
+#ifdef WITH_WORKSPACES
+        if (bar.workspaceBox)
+            DynCtx::UpdateWorkspaces(bar);
+#endif
+#ifdef WITH_BLUEZ
+        if (bar.btIconText)
+            DynCtx::UpdateBluetooth(System::GetBluetoothInfo());
+#endif
+    }
+
+    // The indices of the monitors after a removed one shift
+    static void UpdateMonitorIndices()
+    {
+        GdkDisplay* display = gdk_display_get_default();
+        for (auto& bar : DynCtx::bars)
+        {
+            for (int32_t i = 0; i < gdk_display_get_n_monitors(display); i++)
+            {
+                if (gdk_display_get_monitor(display, i) == bar->window->GetMonitor())
+                {
+                    bar->monitor = i;
+                    break;
+                }
+            }
+        }
+#ifdef WITH_WORKSPACES
+        if (RuntimeConfig::Get().hasWorkspaces)
+            DynCtx::UpdateAllWorkspaces();
+#endif
+    }
+
+    static void AddMonitor(GdkMonitor* monitor, int32_t index)
+    {
+        LOG("Bar: Adding bar for monitor " << index);
+        auto window = std::make_unique<Window>(monitor);
+        Create(*window, index);
+        DynCtx::bars.back()->ownedWindow = std::move(window);
+        DynCtx::bars.back()->window->Create();
+        DynCtx::bars.back()->window->Show();
+    }
+
+    static void RemoveMonitor(GdkMonitor* monitor)
+    {
+        auto it = std::find_if(DynCtx::bars.begin(), DynCtx::bars.end(),
+                               [&](const std::unique_ptr<DynCtx::BarCtx>& bar)
+                               {
+                                   return bar->window->GetMonitor() == monitor;
+                               });
+        if (it == DynCtx::bars.end())
+        {
+            return;
+        }
+        LOG("Bar: Removing bar of monitor " << (*it)->monitor);
+        bool hadTray = DynCtx::trayBar == it->get();
+#ifdef WITH_SNI
+        if (hadTray)
+        {
+            SNI::RemoveWidget();
+            DynCtx::trayBar = nullptr;
+        }
+#endif
+        DynCtx::bars.erase(it);
+
+#ifdef WITH_SNI
+        if (hadTray && !DynCtx::bars.empty())
+        {
+            // Move the tray to the front of another bar
+            DynCtx::BarCtx& bar = *DynCtx::bars.front();
+            size_t numChilds = bar.rightBox->GetWidgets().size();
+            SNI::WidgetSNI(*bar.rightBox);
+            if (bar.rightBox->GetWidgets().size() != numChilds)
+            {
+                bar.rightBox->ReorderChild(bar.rightBox->GetWidgets().back().get(), 0);
+            }
+            DynCtx::trayBar = &bar;
+        }
+#endif
+    }
+
+    void CreateAll()
+    {
+        GdkDisplay* display = gdk_display_get_default();
+        for (int32_t i = 0; i < gdk_display_get_n_monitors(display); i++)
+        {
+            AddMonitor(gdk_display_get_monitor(display, i), i);
+        }
+
+        auto monitorAdded = [](GdkDisplay* display, GdkMonitor* monitor, void*)
+        {
+            int32_t index = 0;
+            while (index < gdk_display_get_n_monitors(display) && gdk_display_get_monitor(display, index) != monitor)
+            {
+                index++;
+            }
+            AddMonitor(monitor, index);
+            UpdateMonitorIndices();
+        };
+        auto monitorRemoved = [](GdkDisplay*, GdkMonitor* monitor, void*)
+        {
+            RemoveMonitor(monitor);
+            UpdateMonitorIndices();
+        };
+        g_signal_connect(display, "monitor-added", G_CALLBACK(+monitorAdded), nullptr);
+        g_signal_connect(display, "monitor-removed", G_CALLBACK(+monitorRemoved), nullptr);
     }
 }
@@ -5,4 +5,6 @@
 namespace Bar
 {
     void Create(Window& window, int32_t monitor);
+    // One bar per monitor, owned by Bar. Bars are created and destroyed, when monitors are added or removed.
+    void CreateAll();
 }
@@ -0,0 +1,509 @@
+#pragma once
+#include "System.h"
+#include "Common.h"
+#include "Config.h"
+
+#include <gio/gio.h>
+#include <map>
+#include <set>
+#include <string>
+
+#ifdef WITH_BLUEZ
+// In-process model of the BlueZ objects. Filled once with GetManagedObjects and afterwards kept current
+// by the InterfacesAdded, InterfacesRemoved and PropertiesChanged signals, so nothing has to poll org.bluez.
+namespace BlueZ
+{
+    struct Adapter
+    {
+        std::string name;
+        bool powered = false;
+    };
+
+    static GDBusConnection* connection = nullptr;
+    static guint nameWatch = 0;
+    static guint interfacesAddedSignal = 0;
+    static guint interfacesRemovedSignal = 0;
+    static guint propertiesChangedSignal = 0;
+    static GCancellable* loadCancellable = nullptr;
+    static guint agentRegistration = 0;
+    // Devices, that we called Pair on. Only these are confirmed by the agent.
+    static std::set<std::string> pairing;
+    static bool loaded = false;
+    // Adapter we started a discovery on, "" if none
+    static std::string discoveryAdapter;
+
+    // Keyed by object path
+    static std::map<std::string, Adapter> adapters;
+    static std::map<std::string, System::BluetoothDevice> devices;
+
+    static System::BluetoothInfo info;
+    // Object path of the adapter in info.defaultController
+    static std::string defaultAdapter;
+    static Utils::CallbackList<const System::BluetoothInfo&> callbacks;
+
+    inline void Notify()
+    {
+        info.defaultController.clear();
+        defaultAdapter.clear();
+        for (auto& [path, adapter] : adapters)
+        {
+            if (adapter.powered)
+            {
+                info.defaultController = adapter.name;
+                defaultAdapter = path;
+                break;
+            }
+        }
+        info.devices.clear();
+        info.devices.reserve(devices.size());
+        for (auto& [path, device] : devices)
+        {
+            info.devices.push_back(device);
+        }
+        callbacks.Invoke(info);
+    }
+
+    // Returns true, if value differs from the old one
+    inline bool ReadString(GVariant* props, const char* key, std::string& value)
+    {
+        GVariant* var = g_variant_lookup_value(props, key, G_VARIANT_TYPE_STRING);
+        if (!var)
+        {
+            return false;
+        }
+        const char* str = g_variant_get_string(var, nullptr);
+        bool changed = value != str;
+        if (changed)
+        {
+            value = str;
+        }
+        g_variant_unref(var);
+        return changed;
+    }
+
+    inline bool ReadBool(GVariant* props, const char* key, bool& value)
+    {
+        GVariant* var = g_variant_lookup_value(props, key, G_VARIANT_TYPE_BOOLEAN);
+        if (!var)
+        {
+            return false;
+        }
+        bool newValue = g_variant_get_boolean(var);
+        bool changed = value != newValue;
+        value = newValue;
+        g_variant_unref(var);
+        return changed;
+    }
+
+    // props is a a{sv}. Only reports changes of properties we show, so e.g. RSSI updates during a scan are ignored.
+    inline bool ReadAdapter(Adapter& adapter, GVariant* props)
+    {
+        bool changed = ReadString(props, "Name", adapter.name);
+        changed |= ReadBool(props, "Powered", adapter.powered);
+        return changed;
+    }
+
+    inline bool ReadDevice(System::BluetoothDevice& device, GVariant* props)
+    {
+        bool changed = ReadString(props, "Address", device.mac);
+        changed |= ReadString(props, "Name", device.name);
+        changed |= ReadString(props, "Icon", device.type);
+        changed |= ReadBool(props, "Connected", device.connected);
+        changed |= ReadBool(props, "Paired", device.paired);
+        return changed;
+    }
+
+    // interfaces is a a{sa{sv}}
+    inline bool AddInterfaces(const char* path, GVariant* interfaces)
+    {
+        bool changed = false;
+        GVariant* props = g_variant_lookup_value(interfaces, "org.bluez.Adapter1", G_VARIANT_TYPE_VARDICT);
+        if (props)
+        {
+            ReadAdapter(adapters[path], props);
+            g_variant_unref(props);
+            changed = true;
+        }
+        props = g_variant_lookup_value(interfaces, "org.bluez.Device1", G_VARIANT_TYPE_VARDICT);
+        if (props)
+        {
+            System::BluetoothDevice& device = devices[path];
+            device.path = path;
+            ReadDevice(device, props);
+            g_variant_unref(props);
+            changed = true;
+        }
+        return changed;
+    }
+
+    // objects is a a{oa{sa{sv}}}
+    inline void AddObjects(GVariant* objects)
+    {
+        GVariantIter iter;
+        g_variant_iter_init(&iter, objects);
+        const char* path = nullptr;
+        GVariant* interfaces = nullptr;
+        while (g_variant_iter_loop(&iter, "{&o@a{sa{sv}}}", &path, &interfaces))
+        {
+            AddInterfaces(path, interfaces);
+        }
+    }
+
+    inline void OnInterfacesAdded(GDBusConnection*, const char*, const char*, const char*, const char*, GVariant* params, void*)
+    {
+        const char* path = nullptr;
+        GVariant* interfaces = nullptr;
+        g_variant_get(params, "(&o@a{sa{sv}})", &path, &interfaces);
+        if (AddInterfaces(path, interfaces))
+        {
+            Notify();
+        }
+        g_variant_unref(interfaces);
+    }
+
+    inline void OnInterfacesRemoved(GDBusConnection*, const char*, const char*, const char*, const char*, GVariant* params, void*)
+    {
+        const char* path = nullptr;
+        GVariantIter* interfaces = nullptr;
+        g_variant_get(params, "(&oas)", &path, &interfaces);
+        bool changed = false;
+        const char* interface = nullptr;
+        while (g_variant_iter_next(interfaces, "&s", &interface))
+        {
+            if (strcmp(interface, "org.bluez.Adapter1") == 0)
+            {
+                changed |= adapters.erase(path) != 0;
+            }
+            else if (strcmp(interface, "org.bluez.Device1") == 0)
+            {
+                changed |= devices.erase(path) != 0;
+            }
+        }
+        g_variant_iter_free(interfaces);
+        if (changed)
+        {
+            Notify();
+        }
+    }
+
+    inline void OnPropertiesChanged(GDBusConnection*, const char*, const char* path, const char*, const char*, GVariant* params, void*)
+    {
+        const char* interface = nullptr;
+        GVariant* changedProps = nullptr;
+        g_variant_get(params, "(&s@a{sv}as)", &interface, &changedProps, nullptr);
+        bool changed = false;
+        if (strcmp(interface, "org.bluez.Adapter1") == 0)
+        {
+            auto it = adapters.find(path);
+            if (it != adapters.end())
+            {
+                changed = ReadAdapter(it->second, changedProps);
+            }
+        }
+        else if (strcmp(interface, "org.bluez.Device1") == 0)
+        {
+            auto it = devices.find(path);
+            if (it != devices.end())
+            {
+                changed = ReadDevice(it->second, changedProps);
+            }
+        }
+        g_variant_unref(changedProps);
+        if (changed)
+        {
+            Notify();
+        }
+    }
+
+    inline void OnObjectsLoaded(GObject* source, GAsyncResult* result, void*)
+    {
+        GError* err = nullptr;
+        GVariant* objects = g_dbus_connection_call_finish((GDBusConnection*)source, result, &err);
+        if (!objects && g_error_matches(err, G_IO_ERROR, G_IO_ERROR_CANCELLED))
+        {
+            // loadCancellable already belongs to a newer call
+            g_error_free(err);
+            return;
+        }
+        g_object_unref(loadCancellable);
+        loadCancellable = nullptr;
+        if (!objects)
+        {
+            LOG("BlueZ: GetManagedObjects failed: " << err->message);
+            g_error_free(err);
+            return;
+        }
+
+        GVariant* array = g_variant_get_child_value(objects, 0);
+        AddObjects(array);
+        g_variant_unref(array);
+        g_variant_unref(objects);
+        loaded = true;
+        Notify();
+    }
+
+    // Reloads everything, e.g. after bluetoothd restarted. The signals are already subscribed, so nothing gets lost in between.
+    inline void Reload()
+    {
+        if (loadCancellable)
+        {
+            g_cancellable_cancel(loadCancellable);
+            g_object_unref(loadCancellable);
+        }
+        loadCancellable = g_cancellable_new();
+        g_dbus_connection_call(connection, "org.bluez", "/", "org.freedesktop.DBus.ObjectManager", "GetManagedObjects", nullptr,
+                               G_VARIANT_TYPE("(a{oa{sa{sv}}})"), G_DBUS_CALL_FLAGS_NONE, -1, loadCancellable, OnObjectsLoaded, nullptr);
+    }
+
+    // Pairing agent for the devices, that we pair with. BlueZ asks the agent of the process, that called Pair.
+    // There is no UI to show or enter a PIN or passkey, so only confirmations (numeric comparison, just works) are answered.
+    constexpr const char* agentPath = "/org/gBar/BlueZAgent";
+    constexpr const char* agentXml = R"(<node>
+  <interface name="org.bluez.Agent1">
+    <method name="Release"/>
+    <method name="RequestPinCode"><arg type="o" direction="in"/><arg type="s" direction="out"/></method>
+    <method name="DisplayPinCode"><arg type="o" direction="in"/><arg type="s" direction="in"/></method>
+    <method name="RequestPasskey"><arg type="o" direction="in"/><arg type="u" direction="out"/></method>
+    <method name="DisplayPasskey"><arg type="o" direction="in"/><arg type="u" direction="in"/><arg type="q" direction="in"/></method>
+    <method name="RequestConfirmation"><arg type="o" direction="in"/><arg type="u" direction="in"/></method>
+    <method name="RequestAuthorization"><arg type="o" direction="in"/></method>
+    <method name="AuthorizeService"><arg type="o" direction="in"/><arg type="s" direction="in"/></method>
+    <method name="Cancel"/>
+  </interface>
+</node>)";
+
+    inline void OnAgentCall(GDBusConnection*, const char*, const char*, const char*, const char* method, GVariant* params,
+                            GDBusMethodInvocation* invocation, void*)
+    {
+        if (strcmp(method, "Release") == 0 || strcmp(method, "Cancel") == 0)
+        {
+            g_dbus_method_invocation_return_value(invocation, nullptr);
+            return;
+        }
+        if (strcmp(method, "RequestConfirmation") == 0 || strcmp(method, "RequestAuthorization") == 0)
+        {
+            const char* device = nullptr;
+            g_variant_get_child(params, 0, "&o", &device);
+            // Never for pairings, that someone else started
+            if (pairing.count(device))
+            {
+                LOG("BlueZ: Confirming pairing with " << device);
+                g_dbus_method_invocation_return_value(invocation, nullptr);
+                return;
+            }
+        }
+        LOG("BlueZ: Rejecting agent request " << method);
+        g_dbus_method_invocation_return_dbus_error(invocation, "org.bluez.Error.Rejected", "Not supported by gBar");
+    }
+
+    inline void RegisterAgent()
+    {
+        if (!agentRegistration)
+        {
+            GDBusNodeInfo* node = g_dbus_node_info_new_for_xml(agentXml, nullptr);
+            static const GDBusInterfaceVTable vtable = {OnAgentCall, nullptr, nullptr, {}};
+            agentRegistration = g_dbus_connection_register_object(connection, agentPath, node->interfaces[0], &vtable, nullptr, nullptr, nullptr);
+            g_dbus_node_info_unref(node);
+        }
+        // Not as the default agent, that belongs to the desktop (if it has one)
+        g_dbus_connection_call(connection, "org.bluez", "/org/bluez", "org.bluez.AgentManager1", "RegisterAgent",
+                               g_variant_new("(os)", agentPath, "DisplayYesNo"), nullptr, G_DBUS_CALL_FLAGS_NONE, -1, nullptr, nullptr, nullptr);
+    }
+
+    inline void OnNameAppeared(GDBusConnection*, const char*, const char*, void*)
+    {
+        // Already filled by Init
+        if (!loaded)
+        {
+            Reload();
+            // Agents don't survive a restart of bluetoothd
+            RegisterAgent();
+        }
+    }
+
+    inline void OnNameVanished(GDBusConnection*, const char*, void*)
+    {
+        if (!loaded)
+        {
+            return;
+        }
+        LOG("BlueZ: org.bluez vanished");
+        loaded = false;
+        discoveryAdapter.clear();
+        adapters.clear();
+        devices.clear();
+        Notify();
+    }
+
+    inline void Shutdown();
+
+    // Returns false, if BlueZ isn't reachable
+    inline bool Init()
+    {
+        // Uses $DBUS_SYSTEM_BUS_ADDRESS, if set. This allows running against a stand-in service on a private bus.
+        GError* err = nullptr;
+        connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, &err);
+        if (!connection)
+        {
+            LOG("BlueZ: Can't connect to the system bus: " << err->message);
+            g_error_free(err);
+            return false;
+        }
+
+        // Subscribe first, so no change between the snapshot and the subscription is missed
+        interfacesAddedSignal = g_dbus_connection_signal_subscribe(connection, "org.bluez", "org.freedesktop.DBus.ObjectManager", "InterfacesAdded",
+                                                                   "/", nullptr, G_DBUS_SIGNAL_FLAGS_NONE, OnInterfacesAdded, nullptr, nullptr);
+        interfacesRemovedSignal = g_dbus_connection_signal_subscribe(connection, "org.bluez", "org.freedesktop.DBus.ObjectManager",
+                                                                     "InterfacesRemoved", "/", nullptr, G_DBUS_SIGNAL_FLAGS_NONE, OnInterfacesRemoved,
+                                                                     nullptr, nullptr);
+        propertiesChangedSignal = g_dbus_connection_signal_subscribe(connection, "org.bluez", "org.freedesktop.DBus.Properties", "PropertiesChanged",
+                                                                     nullptr, nullptr, G_DBUS_SIGNAL_FLAGS_NONE, OnPropertiesChanged, nullptr, nullptr);
+
+        // Synchronous once, since the bar needs to know whether to show the bluetooth widget at all
+        GVariant* objects = g_dbus_connection_call_sync(connection, "org.bluez", "/", "org.freedesktop.DBus.ObjectManager", "GetManagedObjects",
+                                                        nullptr, G_VARIANT_TYPE("(a{oa{sa{sv}}})"), G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &err);
+        if (!objects)
+        {
+            LOG("BlueZ: Can't reach org.bluez: " << err->message);
+            g_error_free(err);
+            // Drop the subscriptions and the connection again
+            Shutdown();
+            return false;
+        }
+        GVariant* array = g_variant_get_child_value(objects, 0);
+        AddObjects(array);
+        g_variant_unref(array);
+        g_variant_unref(objects);
+        loaded = true;
+        Notify();
+        RegisterAgent();
+
+        nameWatch = g_bus_watch_name_on_connection(connection, "org.bluez", G_BUS_NAME_WATCHER_FLAGS_NONE, OnNameAppeared, OnNameVanished, nullptr,
+                                                   nullptr);
+        return true;
+    }
+
+    using CallCallback = std::function<void(bool, const std::string&)>;
+    struct PendingCall
+    {
+        std::string path;
+        std::string method;
+        CallCallback onFinish;
+    };
+
+    inline void OnCallFinished(GObject* source, GAsyncResult* result, void* data)
+    {
+        PendingCall* call = (PendingCall*)data;
+        GError* err = nullptr;
+        GVariant* ret = g_dbus_connection_call_finish((GDBusConnection*)source, result, &err);
+        if (ret)
+        {
+            g_variant_unref(ret);
+        }
+        else
+        {
+            LOG("BlueZ: " << call->method << " on " << call->path << " failed: " << err->message);
+            g_error_free(err);
+        }
+        if (call->onFinish)
+        {
+            call->onFinish(ret != nullptr, call->path);
+        }
+        delete call;
+    }
+
+    // Calls a method without arguments on a BlueZ object. onFinish is called from the main loop with the object path.
+    inline void Call(const std::string& path, const char* interface, const char* method, int timeoutMs, CallCallback&& onFinish)
+    {
+        PendingCall* call = new PendingCall{path, method, std::move(onFinish)};
+        g_dbus_connection_call(connection, "org.bluez", path.c_str(), interface, method, nullptr, nullptr, G_DBUS_CALL_FLAGS_NONE, timeoutMs,
+                               nullptr, OnCallFinished, call);
+    }
+
+    // Pair can wait for a confirmation on the device
+    inline void Pair(const std::string& path, CallCallback&& onFinish)
+    {
+        pairing.insert(path);
+        Call(path, "org.bluez.Device1", "Pair", 60000,
+             [onFinish = std::move(onFinish)](bool success, const std::string& path)
+             {
+                 pairing.erase(path);
+                 onFinish(success, path);
+             });
+    }
+
+    // Current state of the device, nullptr if it is gone
+    inline const System::BluetoothDevice* FindDevice(const std::string& path)
+    {
+        auto it = devices.find(path);
+        return it != devices.end() ? &it->second : nullptr;
+    }
+
+    inline void StartDiscovery()
+    {
+        if (!discoveryAdapter.empty() || defaultAdapter.empty())
+        {
+            return;
+        }
+        discoveryAdapter = defaultAdapter;
+        Call(discoveryAdapter, "org.bluez.Adapter1", "StartDiscovery", -1, nullptr);
+    }
+
+    inline void StopDiscovery()
+    {
+        if (discoveryAdapter.empty())
+        {
+            return;
+        }
+        // BlueZ also stops it, once our connection is closed
+        Call(discoveryAdapter, "org.bluez.Adapter1", "StopDiscovery", -1, nullptr);
+        discoveryAdapter.clear();
+    }
+
+    inline const System::BluetoothInfo& GetInfo()
+    {
+        return info;
+    }
+
+    inline uint32_t AddCallback(std::function<void(const System::BluetoothInfo&)>&& callback)
+    {
+        return callbacks.Add(std::move(callback));
+    }
+
+    inline void RemoveCallback(uint32_t handle)
+    {
+        callbacks.Remove(handle);
+    }
+
+    inline void Shutdown()
+    {
+        if (!connection)
+        {
+            return;
+        }
+        if (loadCancellable)
+        {
+            g_cancellable_cancel(loadCancellable);
+            g_object_unref(loadCancellable);
+            loadCancellable = nullptr;
+        }
+        if (nameWatch)
+        {
+            g_bus_unwatch_name(nameWatch);
+            nameWatch = 0;
+        }
+        if (agentRegistration)
+        {
+            g_dbus_connection_call(connection, "org.bluez", "/org/bluez", "org.bluez.AgentManager1", "UnregisterAgent", g_variant_new("(o)", agentPath),
+                                   nullptr, G_DBUS_CALL_FLAGS_NONE, -1, nullptr, nullptr, nullptr);
+            g_dbus_connection_unregister_object(connection, agentRegistration);
+            agentRegistration = 0;
+        }
+        g_dbus_connection_signal_unsubscribe(connection, interfacesAddedSignal);
+        g_dbus_connection_signal_unsubscribe(connection, interfacesRemovedSignal);
+        g_dbus_connection_signal_unsubscribe(connection, propertiesChangedSignal);
+        g_object_unref(connection);
+        connection = nullptr;
+    }
+}
+#endif
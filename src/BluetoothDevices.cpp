@@ -1,6 +1,5 @@
 #include "BluetoothDevices.h"
 #include "System.h"
-#include <mutex>
 #include <unordered_map>
 #include <string>
 #include <algorithm>
@@ -27,12 +26,30 @@ namespace BluetoothDevices
             DeviceState state{};
         };
 
-        std::mutex deviceMutex;
         std::vector<BTDeviceWithState> devices;
         Box* deviceListBox;
         Window* win;
         bool scanning = false;
 
+        void InvalidateDeviceUI();
+
+        // The list may have changed since the request, so look the device up again
+        void OnRequestFailed(const std::string& path, DeviceState request)
+        {
+            auto it = std::find_if(devices.begin(), devices.end(),
+                                   [&](auto& x)
+                                   {
+                                       return x.device.path == path;
+                                   });
+            if (it == devices.end())
+            {
+                return;
+            }
+            it->state &= ~request;
+            it->state |= DeviceState::Failed;
+            InvalidateDeviceUI();
+        }
+
         void OnClick(Button& button, BTDeviceWithState& device)
         {
             DeviceState& state = device.state;
@@ -49,16 +66,12 @@ namespace BluetoothDevices
                 state |= DeviceState::RequestConnect;
 
                 System::ConnectBTDevice(device.device,
-                                        [&dev = device, &but = button](bool success, System::BluetoothDevice&)
+                                        [](bool success, const std::string& path)
                                         {
-                                            deviceMutex.lock();
                                             if (!success)
                                             {
-                                                dev.state &= ~DeviceState::RequestConnect;
-                                                dev.state |= DeviceState::Failed;
-                                                but.AddClass("failed");
+                                                OnRequestFailed(path, DeviceState::RequestConnect);
                                             }
-                                            deviceMutex.unlock();
                                         });
             }
             else if (FLAG_CHECK(state, DeviceState::Connected) && !FLAG_CHECK(state, DeviceState::RequestDisconnect))
@@ -68,16 +81,12 @@ namespace BluetoothDevices
                 state |= DeviceState::RequestDisconnect;
 
                 System::DisconnectBTDevice(device.device,
-                                           [&dev = device, &but = button](bool success, System::BluetoothDevice&)
+                                           [](bool success, const std::string& path)
                                            {
-                                               deviceMutex.lock();
                                                if (!success)
                                                {
-                                                   dev.state &= ~DeviceState::RequestDisconnect;
-                                                   dev.state |= DeviceState::Failed;
-                                                   but.AddClass("failed");
+                                                   OnRequestFailed(path, DeviceState::RequestDisconnect);
                                                }
-                                               deviceMutex.unlock();
                                            });
             }
         }
@@ -149,7 +158,7 @@ namespace BluetoothDevices
             }
         }
 
-        TimerResult OnUpdate(Widget&)
+        void OnUpdate(const System::BluetoothInfo& info)
         {
             // Invalidate each current device
             for (auto& device : devices)
@@ -157,12 +166,12 @@ namespace BluetoothDevices
                 device.state |= DeviceState::Invalid;
             }
 
-            for (auto& device : System::GetBluetoothInfo().devices)
+            for (auto& device : info.devices)
             {
                 auto stateDevIt = std::find_if(devices.begin(), devices.end(),
                                                [&](auto& x)
                                                {
-                                                   return device.mac == x.device.mac;
+                                                   return device.path == x.device.path;
                                                });
                 BTDeviceWithState* stateDev = nullptr;
                 if (stateDevIt != devices.end())
@@ -225,8 +234,6 @@ namespace BluetoothDevices
                       });
 
             InvalidateDeviceUI();
-
-            return TimerResult::Ok;
         }
 
         void Close(Button&)
@@ -282,7 +289,9 @@ namespace BluetoothDevices
         DynCtx::deviceListBox = bodyBox.get();
         bodyBox->SetOrientation(Orientation::Vertical);
         bodyBox->SetClass("bt-body-box");
-        bodyBox->AddTimer<Widget>(DynCtx::OnUpdate, 100);
+        DynCtx::OnUpdate(System::GetBluetoothInfo());
+        // BlueZ tells us about new devices and connection changes, so no need to poll
+        System::AddBluetoothCallback(DynCtx::OnUpdate);
         parentWidget.AddChild(std::move(bodyBox));
     }
 
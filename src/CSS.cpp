@@ -9,9 +9,10 @@ namespace CSS
 {
     static GtkCssProvider* sProvider;
 
-    void Load()
+    // Returns nullptr, if no CSS could be loaded
+    static GtkCssProvider* LoadProvider()
     {
-        sProvider = gtk_css_provider_new();
+        GtkCssProvider* provider = gtk_css_provider_new();
 
         struct CSSDir
         {
@@ -46,19 +47,44 @@ namespace CSS
                 continue;
             }
 
-            gtk_css_provider_load_from_path(sProvider, file.c_str(), &err);
+            gtk_css_provider_load_from_path(provider, file.c_str(), &err);
 
             if (!err)
             {
                 LOG("CSS found and loaded successfully!");
-                return;
+                return provider;
             }
             LOG("Warning: Failed loading config for " << dir.fallbackPath << ", trying next one!");
             // Log any errors
             LOG(err->message);
             g_error_free(err);
+            err = nullptr;
+        }
+        g_object_unref(provider);
+        return nullptr;
+    }
+
+    void Load()
+    {
+        sProvider = LoadProvider();
+        ASSERT(sProvider, "No CSS file found!");
+    }
+
+    bool Reload()
+    {
+        GtkCssProvider* provider = LoadProvider();
+        if (!provider)
+        {
+            // Keep the old style, instead of ending up unstyled
+            LOG("Warning: Reloading CSS failed, keeping the current one!");
+            return false;
         }
-        ASSERT(false, "No CSS file found!");
+        GdkScreen* screen = gdk_screen_get_default();
+        gtk_style_context_remove_provider_for_screen(screen, (GtkStyleProvider*)sProvider);
+        gtk_style_context_add_provider_for_screen(screen, (GtkStyleProvider*)provider, GTK_STYLE_PROVIDER_PRIORITY_USER);
+        g_object_unref(sProvider);
+        sProvider = provider;
+        return true;
     }
 
     GtkCssProvider* GetProvider()
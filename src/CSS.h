@@ -4,5 +4,7 @@
 namespace CSS
 {
     void Load();
+    // Loads the CSS again and swaps it in for all windows. Returns false (and keeps the current one), if loading failed.
+    bool Reload();
     GtkCssProvider* GetProvider();
 }
@@ -4,6 +4,8 @@
 #include <string>
 #include <vector>
 #include <filesystem>
+#include <functional>
+#include <map>
 
 #include "Log.h"
 
@@ -140,28 +142,43 @@ namespace Utils
         }
         return "";
     }
-}
 
-struct Process
-{
-    pid_t pid;
-};
+    // List of callbacks, that are invoked on an event. Callbacks may add or remove callbacks while being invoked.
+    template<typename... Args>
+    class CallbackList
+    {
+    public:
+        using Callback = std::function<void(Args...)>;
 
-inline Process OpenProcess(const std::string& command)
-{
-    pid_t child = fork();
-    ASSERT(child != -1, "fork error");
+        uint32_t Add(Callback&& callback)
+        {
+            uint32_t handle = m_NextHandle++;
+            m_Callbacks.emplace(handle, std::move(callback));
+            return handle;
+        }
 
-    if (child == 0)
-    {
-        // Child
-        system(command.c_str());
-        exit(0);
-    }
-    else
-    {
-        return {child};
-    }
+        void Remove(uint32_t handle) { m_Callbacks.erase(handle); }
+
+        void Invoke(Args... args)
+        {
+            // Only invoke callbacks, that were registered before this call.
+            uint32_t lastHandle = m_NextHandle;
+            for (auto it = m_Callbacks.begin(); it != m_Callbacks.end() && it->first < lastHandle;)
+            {
+                uint32_t handle = it->first;
+                // Copy, since the callback may remove itself
+                Callback callback = it->second;
+                callback(args...);
+                it = m_Callbacks.upper_bound(handle);
+            }
+        }
+
+        bool Empty() const { return m_Callbacks.empty(); }
+
+    private:
+        std::map<uint32_t, Callback> m_Callbacks;
+        uint32_t m_NextHandle = 1;
+    };
 }
 
 // Plugins
@@ -137,6 +137,9 @@ void AddConfigVar(const std::string& propertyName, T& propertyToSet, std::string
 
 void Config::Load()
 {
+    // Start from the defaults, so removed lines are reset on a reload.
+    config = Config{};
+
     const char* xdgConfigHome = getenv("XDG_CONFIG_HOME");
     std::ifstream file;
     if (xdgConfigHome)
@@ -175,13 +178,22 @@ void Config::Load()
         AddConfigVar("LockCommand", config.lockCommand, lineView, foundProperty);
         AddConfigVar("ExitCommand", config.exitCommand, lineView, foundProperty);
         AddConfigVar("BatteryFolder", config.batteryFolder, lineView, foundProperty);
+        AddConfigVar("BacklightFolder", config.backlightFolder, lineView, foundProperty);
         AddConfigVar("DefaultWorkspaceSymbol", config.defaultWorkspaceSymbol, lineView, foundProperty);
         AddConfigVar("DateTimeStyle", config.dateTimeStyle, lineView, foundProperty);
         AddConfigVar("CheckPackagesCommand", config.checkPackagesCommand, lineView, foundProperty);
-        for (int i = 1; i < 10; i++)
+        AddConfigVar("NumWorkspaces", config.numWorkspaces, lineView, foundProperty);
         {
-            // Subtract 1 to index from 1 to 9 rather than 0 to 8
-            AddConfigVar("WorkspaceSymbol-" + std::to_string(i), config.workspaceSymbols[i - 1], lineView, foundProperty);
+            // WorkspaceSymbol-[Number or name]: [Symbol]
+            const std::string_view prefix = "WorkspaceSymbol-";
+            size_t begin = lineView.find_first_not_of(" \t");
+            size_t colon = lineView.find(':');
+            if (begin != std::string_view::npos && colon != std::string_view::npos && lineView.substr(begin, prefix.size()) == prefix &&
+                colon > begin + prefix.size())
+            {
+                std::string key(lineView.substr(begin + prefix.size(), colon - begin - prefix.size()));
+                AddConfigVar("WorkspaceSymbol-" + key, config.workspaceSymbols[key], lineView, foundProperty);
+            }
         }
 
         AddConfigVar("CenterTime", config.centerTime, lineView, foundProperty);
@@ -192,7 +204,13 @@ void Config::Load()
         AddConfigVar("WorkspaceScrollOnMonitor", config.workspaceScrollOnMonitor, lineView, foundProperty);
         AddConfigVar("WorkspaceScrollInvert", config.workspaceScrollInvert, lineView, foundProperty);
         AddConfigVar("UseHyprlandIPC", config.useHyprlandIPC, lineView, foundProperty);
+        AddConfigVar("UseSwayIPC", config.useSwayIPC, lineView, foundProperty);
         AddConfigVar("EnableSNI", config.enableSNI, lineView, foundProperty);
+        AddConfigVar("PrivacyIndicator", config.privacyIndicator, lineView, foundProperty);
+        AddConfigVar("PrivacyCamera", config.privacyCamera, lineView, foundProperty);
+        AddConfigVar("EnableOSD", config.enableOSD, lineView, foundProperty);
+        AddConfigVar("WindowTitle", config.windowTitle, lineView, foundProperty);
+        AddConfigVar("WorkspaceIcons", config.workspaceIcons, lineView, foundProperty);
 
         AddConfigVar("MinUploadBytes", config.minUploadBytes, lineView, foundProperty);
         AddConfigVar("MaxUploadBytes", config.maxUploadBytes, lineView, foundProperty);
@@ -200,6 +218,10 @@ void Config::Load()
         AddConfigVar("MaxDownloadBytes", config.maxDownloadBytes, lineView, foundProperty);
 
         AddConfigVar("CheckUpdateInterval", config.checkUpdateInterval, lineView, foundProperty);
+        AddConfigVar("PrivacyCameraInterval", config.privacyCameraInterval, lineView, foundProperty);
+        AddConfigVar("OSDCloseTime", config.osdCloseTime, lineView, foundProperty);
+        AddConfigVar("WindowTitleWidth", config.windowTitleWidth, lineView, foundProperty);
+        AddConfigVar("WorkspaceIconSize", config.workspaceIconSize, lineView, foundProperty);
 
         AddConfigVar("TimeSpace", config.timeSpace, lineView, foundProperty);
 
@@ -233,6 +255,37 @@ void Config::Load()
     }
 }
 
+template<typename T>
+static void KeepStartupValue(T& value, const T& startupValue, const char* name)
+{
+    if (value != startupValue)
+    {
+        LOG("Config: " << name << " only changes after a restart");
+        value = startupValue;
+    }
+}
+
+void Config::Reload()
+{
+    Config startup = config;
+    Load();
+    // The widgets and the audio/workspace backends were created from these
+    KeepStartupValue(config.centerTime, startup.centerTime, "CenterTime");
+    KeepStartupValue(config.audioInput, startup.audioInput, "AudioInput");
+    KeepStartupValue(config.audioRevealer, startup.audioRevealer, "AudioRevealer");
+    KeepStartupValue(config.audioNumbers, startup.audioNumbers, "AudioNumbers");
+    KeepStartupValue(config.networkWidget, startup.networkWidget, "NetworkWidget");
+    KeepStartupValue(config.useHyprlandIPC, startup.useHyprlandIPC, "UseHyprlandIPC");
+    KeepStartupValue(config.useSwayIPC, startup.useSwayIPC, "UseSwayIPC");
+    KeepStartupValue(config.enableSNI, startup.enableSNI, "EnableSNI");
+    KeepStartupValue(config.privacyIndicator, startup.privacyIndicator, "PrivacyIndicator");
+    KeepStartupValue(config.privacyCamera, startup.privacyCamera, "PrivacyCamera");
+    KeepStartupValue(config.enableOSD, startup.enableOSD, "EnableOSD");
+    KeepStartupValue(config.windowTitle, startup.windowTitle, "WindowTitle");
+    KeepStartupValue(config.workspaceIcons, startup.workspaceIcons, "WorkspaceIcons");
+    KeepStartupValue(config.location, startup.location, "Location");
+}
+
 RuntimeConfig& RuntimeConfig::Get()
 {
     static RuntimeConfig config;
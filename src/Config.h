@@ -13,7 +13,8 @@ public:
     std::string lockCommand = "";   // idk, no standard way of doing this.
     std::string exitCommand = "";   // idk, no standard way of doing this.
     std::string batteryFolder = ""; // this can be BAT0, BAT1, etc. Usually in /sys/class/power_supply
-    std::vector<std::string> workspaceSymbols = std::vector<std::string>(9, "");
+    std::string backlightFolder = ""; // Usually in /sys/class/backlight. Empty = first one found
+    std::unordered_map<std::string, std::string> workspaceSymbols; // Keyed by workspace number or name
     std::string defaultWorkspaceSymbol = "";
     std::string dateTimeStyle = "%a %D - %H:%M:%S %Z"; // A sane default
 
@@ -29,8 +30,14 @@ public:
     bool networkWidget = true;
     bool workspaceScrollOnMonitor = true; // Scroll through workspaces on monitor instead of all
     bool workspaceScrollInvert = false;   // Up = +1, instead of Up = -1
-    bool useHyprlandIPC = false;          // Use Hyprland IPC instead of ext_workspaces protocol (Less buggy, but also less performant)
+    bool useHyprlandIPC = false;          // Use Hyprland IPC instead of ext_workspaces protocol (Less buggy)
+    bool useSwayIPC = false;              // Use Sway's i3 IPC instead of ext_workspaces protocol
     bool enableSNI = true;                // Enable tray icon
+    bool privacyIndicator = true;         // Show an indicator, while an application records audio
+    bool privacyCamera = false;           // Also show it, while a /dev/video* device is open (Scans /proc)
+    bool enableOSD = true;                // Show on-screen-displays from the bar process, when the volume, mic or brightness changes
+    bool windowTitle = false;             // Show the title of the focused window next to the workspaces (Horizontal bars only)
+    bool workspaceIcons = false;          // Show the icons of the applications on each workspace (Hyprland IPC only)
 
     // Controls for color progression of the network widget
     uint32_t minUploadBytes = 0;                  // Bottom limit of the network widgets upload. Everything below it is considered "under"
@@ -42,8 +49,18 @@ public:
 
     uint32_t checkUpdateInterval = 5 * 60; // Interval to run the "checkPackagesCommand". In seconds
 
+    uint32_t privacyCameraInterval = 5; // Interval between /proc scans for camera users. In seconds
+
+    uint32_t osdCloseTime = 2000; // How long an OSD stays visible after the last change. In milliseconds
+
     uint32_t timeSpace = 300; // How much time should be reserved for the time widget.
 
+    uint32_t windowTitleWidth = 300; // Fixed width of the window title. Longer titles are elided
+
+    uint32_t workspaceIconSize = 16; // Size of the application icons on the workspaces. In pixels
+
+    uint32_t numWorkspaces = 9; // Workspaces 1 to numWorkspaces are always shown. Other workspaces are only shown while they exist
+
     char location = 'T'; // The Location of the bar. Can be L,R,T,B
 
     // SNIIconSize: ["Title String"], ["Size"]
@@ -55,6 +72,8 @@ public:
     double audioMaxVolume = 100.f; // Map the maximum volume to this value
 
     static void Load();
+    // Like Load, but keeps the values, that define the layout and the backends
+    static void Reload();
     static const Config& Get();
 };
 
@@ -0,0 +1,404 @@
+#include "Control.h"
+#include "Common.h"
+
+#include <map>
+#include <unordered_map>
+#include <cerrno>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <glib-unix.h>
+
+namespace Control
+{
+    struct Client
+    {
+        int fd;
+        guint readSource = 0;
+        guint writeSource = 0;
+        std::string in;
+        std::string out;
+        bool closeAfterWrite = false;
+    };
+
+    static int listenFd = -1;
+    static guint listenSource = 0;
+    static std::unordered_map<int, Client> clients;
+    static std::unordered_map<std::string, Handler> commands;
+    // Sorted, so the query output is stable
+    static std::map<std::string, std::string> metrics;
+
+    // Requests are tiny; anything bigger is garbage
+    static constexpr size_t maxLineLength = 4096;
+
+    std::string GetSocketPath()
+    {
+        // $XDG_RUNTIME_DIR, otherwise the user's cache dir. Never a world-writable directory, where another user could take the path first.
+        return std::string(g_get_user_runtime_dir()) + "/gBar.sock";
+    }
+
+    static bool FillAddress(sockaddr_un& addr)
+    {
+        std::string path = GetSocketPath();
+        addr = {};
+        addr.sun_family = AF_UNIX;
+        if (path.size() >= sizeof(addr.sun_path))
+        {
+            LOG("Control: Socket path too long: " << path);
+            return false;
+        }
+        memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+        return true;
+    }
+
+    static std::vector<std::string_view> SplitArgs(std::string_view line)
+    {
+        std::vector<std::string_view> args;
+        size_t pos = 0;
+        while (pos < line.size())
+        {
+            size_t begin = line.find_first_not_of(" \t\r", pos);
+            if (begin == std::string_view::npos)
+            {
+                break;
+            }
+            size_t end = line.find_first_of(" \t\r", begin);
+            if (end == std::string_view::npos)
+            {
+                end = line.size();
+            }
+            args.push_back(line.substr(begin, end - begin));
+            pos = end;
+        }
+        return args;
+    }
+
+    static void Dispatch(std::string_view line, std::string& out)
+    {
+        std::vector<std::string_view> args = SplitArgs(line);
+        if (args.empty())
+        {
+            return;
+        }
+
+        std::string response;
+        auto it = commands.find(std::string(args[0]));
+        if (it == commands.end())
+        {
+            out += "error unknown command: " + std::string(args[0]) + "\n";
+            return;
+        }
+        if (it->second(args, response))
+        {
+            out += response;
+            out += "ok\n";
+        }
+        else
+        {
+            out += "error " + response + "\n";
+        }
+    }
+
+    static void CloseClient(int fd)
+    {
+        auto it = clients.find(fd);
+        if (it == clients.end())
+        {
+            return;
+        }
+        if (it->second.readSource)
+        {
+            g_source_remove(it->second.readSource);
+        }
+        if (it->second.writeSource)
+        {
+            g_source_remove(it->second.writeSource);
+        }
+        close(fd);
+        clients.erase(it);
+    }
+
+    static int OnWritable(int fd, GIOCondition, void*);
+
+    // Returns false, if the client has been closed
+    static bool Flush(Client& client)
+    {
+        while (!client.out.empty())
+        {
+            ssize_t written = send(client.fd, client.out.data(), client.out.size(), MSG_NOSIGNAL);
+            if (written < 0)
+            {
+                if (errno == EAGAIN || errno == EWOULDBLOCK)
+                {
+                    // Continue, once the socket is writable again
+                    if (!client.writeSource)
+                    {
+                        client.writeSource = g_unix_fd_add(client.fd, G_IO_OUT, OnWritable, nullptr);
+                    }
+                    return true;
+                }
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                CloseClient(client.fd);
+                return false;
+            }
+            client.out.erase(0, written);
+        }
+        if (client.closeAfterWrite)
+        {
+            CloseClient(client.fd);
+            return false;
+        }
+        return true;
+    }
+
+    static int OnWritable(int fd, GIOCondition, void*)
+    {
+        auto it = clients.find(fd);
+        if (it == clients.end())
+        {
+            return G_SOURCE_REMOVE;
+        }
+        Client& client = it->second;
+        // This source is done either way; Flush registers a new one, if it has to wait again.
+        client.writeSource = 0;
+        Flush(client);
+        return G_SOURCE_REMOVE;
+    }
+
+    static int OnReadable(int fd, GIOCondition, void*)
+    {
+        auto it = clients.find(fd);
+        if (it == clients.end())
+        {
+            return G_SOURCE_REMOVE;
+        }
+        Client& client = it->second;
+
+        char buf[1024];
+        while (true)
+        {
+            ssize_t len = read(fd, buf, sizeof(buf));
+            if (len > 0)
+            {
+                client.in.append(buf, len);
+                continue;
+            }
+            if (len < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+            {
+                break;
+            }
+            // EOF or error: Answer what is still pending, then close.
+            client.closeAfterWrite = true;
+            break;
+        }
+
+        size_t lineStart = 0;
+        size_t newline;
+        while ((newline = client.in.find('\n', lineStart)) != std::string::npos)
+        {
+            Dispatch(std::string_view(client.in).substr(lineStart, newline - lineStart), client.out);
+            lineStart = newline + 1;
+        }
+        client.in.erase(0, lineStart);
+        if (client.in.size() > maxLineLength)
+        {
+            client.out += "error request too long\n";
+            client.in.clear();
+            client.closeAfterWrite = true;
+        }
+
+        if (client.closeAfterWrite)
+        {
+            // Removed by returning G_SOURCE_REMOVE
+            client.readSource = 0;
+        }
+        bool keepSource = client.readSource != 0;
+        Flush(client);
+        return keepSource && clients.count(fd) ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+    }
+
+    static int OnAccept(int, GIOCondition, void*)
+    {
+        while (true)
+        {
+            int fd = accept4(listenFd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+            if (fd < 0)
+            {
+                if (errno == EINTR)
+                {
+                    continue;
+                }
+                if (errno != EAGAIN && errno != EWOULDBLOCK)
+                {
+                    LOG("Control: accept failed: " << strerror(errno));
+                }
+                break;
+            }
+            Client& client = clients[fd];
+            client.fd = fd;
+            client.readSource = g_unix_fd_add(fd, (GIOCondition)(G_IO_IN | G_IO_HUP | G_IO_ERR), OnReadable, nullptr);
+        }
+        return G_SOURCE_CONTINUE;
+    }
+
+    static void AddBuiltinCommands()
+    {
+        AddCommand("query",
+                   [](const std::vector<std::string_view>&, std::string& response)
+                   {
+                       for (auto& [key, value] : metrics)
+                       {
+                           response += key + " " + value + "\n";
+                       }
+                       return true;
+                   });
+        AddCommand("help",
+                   [](const std::vector<std::string_view>&, std::string& response)
+                   {
+                       for (auto& [name, handler] : commands)
+                       {
+                           response += name + "\n";
+                       }
+                       return true;
+                   });
+    }
+
+    // Doesn't block: A stale socket refuses the connection right away
+    static bool IsServed(const sockaddr_un& addr)
+    {
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            return false;
+        }
+        int res = connect(fd, (const sockaddr*)&addr, sizeof(addr));
+        // EAGAIN: Someone is listening, but the backlog is full
+        bool served = res == 0 || errno == EAGAIN || errno == EINPROGRESS;
+        close(fd);
+        return served;
+    }
+
+    void Init()
+    {
+        sockaddr_un addr;
+        if (!FillAddress(addr))
+        {
+            return;
+        }
+
+        // A socket file that nobody answers on is a leftover of a crashed bar.
+        if (access(addr.sun_path, F_OK) == 0)
+        {
+            if (IsServed(addr))
+            {
+                LOG("Control: Another bar is already serving " << addr.sun_path << ", not serving it here.");
+                return;
+            }
+            unlink(addr.sun_path);
+        }
+
+        // The cache dir fallback may not exist yet
+        g_mkdir_with_parents(g_get_user_runtime_dir(), 0700);
+        listenFd = socket(AF_UNIX, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+        if (listenFd < 0)
+        {
+            LOG("Control: socket failed: " << strerror(errno));
+            return;
+        }
+        if (bind(listenFd, (sockaddr*)&addr, sizeof(addr)) < 0 || listen(listenFd, 8) < 0)
+        {
+            LOG("Control: Cannot listen on " << addr.sun_path << ": " << strerror(errno));
+            close(listenFd);
+            listenFd = -1;
+            return;
+        }
+        listenSource = g_unix_fd_add(listenFd, G_IO_IN, OnAccept, nullptr);
+        AddBuiltinCommands();
+        LOG("Control: Listening on " << addr.sun_path);
+    }
+
+    void Shutdown()
+    {
+        while (!clients.empty())
+        {
+            CloseClient(clients.begin()->first);
+        }
+        if (listenFd >= 0)
+        {
+            g_source_remove(listenSource);
+            listenSource = 0;
+            close(listenFd);
+            listenFd = -1;
+            unlink(GetSocketPath().c_str());
+        }
+    }
+
+    void AddCommand(const std::string& name, Handler&& handler)
+    {
+        commands[name] = std::move(handler);
+    }
+
+    void SetMetric(const std::string& key, const std::string& value)
+    {
+        metrics[key] = value;
+    }
+
+    bool Send(const std::string& request, std::string& response)
+    {
+        sockaddr_un addr;
+        if (!FillAddress(addr))
+        {
+            return false;
+        }
+        int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+        if (fd < 0)
+        {
+            return false;
+        }
+        // Don't hang forever, if the bar is stuck
+        timeval timeout{1, 0};
+        setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+        setsockopt(fd, SOL_SOCKET, SO_SNDTIMEO, &timeout, sizeof(timeout));
+        if (connect(fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+        {
+            close(fd);
+            return false;
+        }
+
+        std::string line = request + "\n";
+        if (send(fd, line.data(), line.size(), MSG_NOSIGNAL) != (ssize_t)line.size())
+        {
+            close(fd);
+            return false;
+        }
+        shutdown(fd, SHUT_WR);
+
+        response.clear();
+        char buf[1024];
+        ssize_t len;
+        while ((len = read(fd, buf, sizeof(buf))) > 0)
+        {
+            response.append(buf, len);
+        }
+        close(fd);
+
+        // The last line is the status
+        if (response.empty() || response.back() != '\n')
+        {
+            return false;
+        }
+        size_t statusStart = response.rfind('\n', response.size() - 2);
+        statusStart = statusStart == std::string::npos ? 0 : statusStart + 1;
+        return response.compare(statusStart, 3, "ok\n") == 0;
+    }
+}
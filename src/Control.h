@@ -0,0 +1,30 @@
+#pragma once
+#include <string>
+#include <string_view>
+#include <vector>
+#include <functional>
+
+// Control socket of the running bar ($XDG_RUNTIME_DIR/gBar.sock).
+// Line protocol: A request is one line of space separated words.
+// The response are zero or more data lines, followed by either "ok" or "error <message>".
+namespace Control
+{
+    // Return false on failure and put the error message into response. On success, response holds the data lines (each terminated by '\n').
+    using Handler = std::function<bool(const std::vector<std::string_view>& args, std::string& response)>;
+
+    // Starts serving the socket from the main loop. Only one process can serve it.
+    void Init();
+    void Shutdown();
+
+    // args[0] is the command name itself.
+    void AddCommand(const std::string& name, Handler&& handler);
+
+    // Last value of a metric, that is reported by "query". Set by whoever samples it, so querying doesn't sample again.
+    void SetMetric(const std::string& key, const std::string& value);
+
+    std::string GetSocketPath();
+
+    // Client side: Sends a request to the running bar and blocks until the response is complete.
+    // Returns false, if no bar is listening or the request failed.
+    bool Send(const std::string& request, std::string& response);
+}
@@ -0,0 +1,148 @@
+#include "IconCache.h"
+#include "Common.h"
+
+#include <list>
+#include <algorithm>
+#include <unordered_map>
+#include <cstdio>
+
+namespace IconCache
+{
+    struct Entry
+    {
+        std::shared_ptr<Surface> surface;
+        size_t bytes;
+    };
+
+    // Front is the most recently used
+    static std::list<Entry> entries;
+    static std::unordered_map<std::string, std::list<Entry>::iterator> lookup;
+    static size_t totalBytes = 0;
+    // A few hundred tray/app icons at typical sizes
+    static constexpr size_t maxBytes = 8 * 1024 * 1024;
+
+    Surface::~Surface()
+    {
+        if (surface)
+        {
+            cairo_surface_destroy(surface);
+        }
+    }
+
+    static uint64_t Hash(const uint8_t* data, size_t size)
+    {
+        // FNV-1a
+        uint64_t hash = 14695981039346656037ull;
+        for (size_t i = 0; i < size; i++)
+        {
+            hash ^= data[i];
+            hash *= 1099511628211ull;
+        }
+        return hash;
+    }
+
+    static Ref Find(const std::string& key)
+    {
+        auto it = lookup.find(key);
+        if (it == lookup.end())
+        {
+            return nullptr;
+        }
+        entries.splice(entries.begin(), entries, it->second);
+        return it->second->surface;
+    }
+
+    static void Evict()
+    {
+        auto it = entries.end();
+        while (totalBytes > maxBytes && it != entries.begin())
+        {
+            --it;
+            // Still drawn somewhere, evicting it wouldn't free anything
+            if (it->surface.use_count() > 1)
+            {
+                continue;
+            }
+            totalBytes -= it->bytes;
+            lookup.erase(it->surface->key);
+            it = entries.erase(it);
+        }
+    }
+
+    static Ref Insert(std::shared_ptr<Surface>&& surface)
+    {
+        Ref ref = surface;
+        cairo_surface_t* cairoSurface = surface->surface;
+        size_t bytes = cairo_image_surface_get_stride(cairoSurface) * cairo_image_surface_get_height(cairoSurface);
+        entries.push_front({std::move(surface), bytes});
+        lookup[ref->key] = entries.begin();
+        totalBytes += bytes;
+        // ref is still held, so the new entry survives
+        Evict();
+        return ref;
+    }
+
+    Ref GetSource(size_t width, size_t height, const uint8_t* rgba)
+    {
+        char key[64];
+        snprintf(key, sizeof(key), "%zux%zu:%016llx", width, height, (unsigned long long)Hash(rgba, width * height * 4));
+        Ref cached = Find(key);
+        if (cached)
+        {
+            return cached;
+        }
+
+        auto surface = std::make_shared<Surface>();
+        surface->key = key;
+        surface->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, width, height);
+        cairo_surface_flush(surface->surface);
+        uint8_t* data = cairo_image_surface_get_data(surface->surface);
+        int stride = cairo_image_surface_get_stride(surface->surface);
+        for (size_t y = 0; y < height; y++)
+        {
+            const uint8_t* src = rgba + y * width * 4;
+            uint32_t* dst = (uint32_t*)(data + y * stride);
+            for (size_t x = 0; x < width; x++)
+            {
+                uint32_t a = src[x * 4 + 3];
+                // Cairo wants premultiplied, native endian ARGB
+                uint32_t r = (src[x * 4 + 0] * a + 127) / 255;
+                uint32_t g = (src[x * 4 + 1] * a + 127) / 255;
+                uint32_t b = (src[x * 4 + 2] * a + 127) / 255;
+                dst[x] = (a << 24) | (r << 16) | (g << 8) | b;
+            }
+        }
+        cairo_surface_mark_dirty(surface->surface);
+        return Insert(std::move(surface));
+    }
+
+    Ref GetScaled(const Ref& source, uint32_t size, int scale)
+    {
+        std::string key = source->key + "@" + std::to_string(size) + "x" + std::to_string(scale);
+        Ref cached = Find(key);
+        if (cached)
+        {
+            return cached;
+        }
+
+        int pixels = size * scale;
+        double width = cairo_image_surface_get_width(source->surface);
+        double height = cairo_image_surface_get_height(source->surface);
+        auto surface = std::make_shared<Surface>();
+        surface->key = std::move(key);
+        surface->surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, pixels, pixels);
+
+        // Keep the aspect ratio and center it
+        double factor = std::min(pixels / width, pixels / height);
+        cairo_t* cr = cairo_create(surface->surface);
+        cairo_translate(cr, (pixels - width * factor) / 2, (pixels - height * factor) / 2);
+        cairo_scale(cr, factor, factor);
+        cairo_set_source_surface(cr, source->surface, 0, 0);
+        // Box filters when scaling down (cairo >= 1.14)
+        cairo_pattern_set_filter(cairo_get_source(cr), CAIRO_FILTER_GOOD);
+        cairo_paint(cr);
+        cairo_destroy(cr);
+        cairo_surface_set_device_scale(surface->surface, scale, scale);
+        return Insert(std::move(surface));
+    }
+}
@@ -0,0 +1,31 @@
+#pragma once
+#include <cairo.h>
+#include <memory>
+#include <string>
+#include <cstdint>
+
+// Process wide cache of decoded icons as premultiplied cairo surfaces, shared by every widget showing them.
+// Also caches the icons pre-scaled to the size they are drawn at, so drawing is a plain copy.
+// Unused entries are evicted least recently used first, once the cache exceeds its memory cap.
+namespace IconCache
+{
+    struct Surface
+    {
+        // ARGB32, premultiplied. The device scale is set for scaled surfaces.
+        cairo_surface_t* surface = nullptr;
+        // Cache key
+        std::string key;
+
+        Surface() = default;
+        Surface(const Surface&) = delete;
+        ~Surface();
+    };
+    // Keeps the surface alive (and in the cache), while it is used
+    using Ref = std::shared_ptr<const Surface>;
+
+    // rgba is straight alpha and tightly packed. Keyed by the content, so identical icons share one surface.
+    Ref GetSource(size_t width, size_t height, const uint8_t* rgba);
+
+    // source fit into size x size logical pixels for a monitor with the given scale factor.
+    Ref GetScaled(const Ref& source, uint32_t size, int scale);
+}
@@ -0,0 +1,569 @@
+#include "IconIndex.h"
+#include "Common.h"
+
+#include <unordered_map>
+#include <unordered_set>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace IconIndex
+{
+    // Cache file layout, all offsets are relative to the start of the section they point into:
+    //   Header | Dir[numDirs] | uint32_t bucket[numBuckets] | Entry[numEntries] | strings
+    // The first numRoots dirs are the roots in lookup order, followed by every directory below them. Adding or removing an icon changes the
+    // mtime of its directory, so comparing the mtimes is enough to notice a stale index.
+    static constexpr char magic[8] = {'g', 'B', 'a', 'r', 'I', 'd', 'x', '\0'};
+    static constexpr uint32_t version = 1;
+    static constexpr uint32_t none = UINT32_MAX;
+
+    struct Header
+    {
+        char magic[8];
+        uint32_t version;
+        uint32_t numRoots;
+        uint32_t numDirs;
+        uint32_t numBuckets;
+        uint32_t numEntries;
+        uint32_t stringsSize;
+    };
+    static_assert(sizeof(Header) == 32);
+
+    struct Dir
+    {
+        // Into strings
+        uint32_t path;
+        uint32_t pad = 0;
+        // -1 for roots, that don't exist
+        int64_t mtimeSec;
+        int64_t mtimeNsec;
+    };
+    static_assert(sizeof(Dir) == 24);
+
+    struct Entry
+    {
+        // Into strings, without the extension
+        uint32_t name;
+        uint32_t dir;
+        // From the NxN directory, 0 if unknown
+        uint32_t size;
+        // Next entry with the same name
+        uint32_t next;
+    };
+    static_assert(sizeof(Entry) == 16);
+
+    // Points into either the mapped cache file or a freshly built buffer
+    struct View
+    {
+        const Header* header = nullptr;
+        const Dir* dirs = nullptr;
+        const uint32_t* buckets = nullptr;
+        const Entry* entries = nullptr;
+        const char* strings = nullptr;
+
+        bool Set(const uint8_t* data, size_t size)
+        {
+            if (size < sizeof(Header))
+            {
+                return false;
+            }
+            header = (const Header*)data;
+            if (memcmp(header->magic, magic, sizeof(magic)) != 0 || header->version != version)
+            {
+                return false;
+            }
+            // Power of two, so the hash can be masked
+            if (header->numBuckets == 0 || (header->numBuckets & (header->numBuckets - 1)) != 0 || header->numRoots > header->numDirs)
+            {
+                return false;
+            }
+            size_t expected = sizeof(Header) + (size_t)header->numDirs * sizeof(Dir) + (size_t)header->numBuckets * sizeof(uint32_t) +
+                              (size_t)header->numEntries * sizeof(Entry) + header->stringsSize;
+            if (size != expected || header->stringsSize == 0)
+            {
+                return false;
+            }
+            dirs = (const Dir*)(data + sizeof(Header));
+            buckets = (const uint32_t*)(dirs + header->numDirs);
+            entries = (const Entry*)(buckets + header->numBuckets);
+            strings = (const char*)(entries + header->numEntries);
+            // Everything is terminated, so a corrupt offset can't read past the end
+            if (strings[header->stringsSize - 1] != '\0')
+            {
+                return false;
+            }
+            for (uint32_t i = 0; i < header->numDirs; i++)
+            {
+                if (dirs[i].path >= header->stringsSize)
+                {
+                    return false;
+                }
+            }
+            for (uint32_t i = 0; i < header->numBuckets; i++)
+            {
+                if (buckets[i] != none && buckets[i] >= header->numEntries)
+                {
+                    return false;
+                }
+            }
+            for (uint32_t i = 0; i < header->numEntries; i++)
+            {
+                const Entry& entry = entries[i];
+                if (entry.name >= header->stringsSize || entry.dir >= header->numDirs || (entry.next != none && entry.next <= i))
+                {
+                    return false;
+                }
+            }
+            return true;
+        }
+    };
+
+    static View view;
+    static void* mapped = nullptr;
+    static size_t mappedSize = 0;
+    // Backing of the view, if the cache file couldn't be written
+    static std::vector<uint8_t> built;
+
+    static bool loaded = false;
+    // The first miss of a name rechecks the directories (e.g. for a newly installed app), later ones don't. Cleared on a rebuild.
+    static std::unordered_set<std::string> misses;
+
+    static uint32_t Hash(const char* str, size_t length)
+    {
+        // FNV-1a
+        uint32_t hash = 2166136261u;
+        for (size_t i = 0; i < length; i++)
+        {
+            hash ^= (uint8_t)str[i];
+            hash *= 16777619u;
+        }
+        return hash;
+    }
+
+    static std::vector<std::string> GetRoots()
+    {
+        std::vector<std::string> roots;
+        std::unordered_set<std::string> seen;
+        auto add = [&](std::string&& root)
+        {
+            // /usr/share is usually part of $XDG_DATA_DIRS as well
+            if (seen.insert(root).second)
+            {
+                roots.push_back(std::move(root));
+            }
+        };
+        const char* dataDirs = getenv("XDG_DATA_DIRS");
+        if (dataDirs)
+        {
+            for (auto& dataDir : Utils::Split(dataDirs, ':'))
+            {
+                if (!dataDir.empty())
+                {
+                    add(dataDir + "/icons");
+                }
+            }
+        }
+        add("/usr/share/icons");
+        return roots;
+    }
+
+    static std::string GetCachePath()
+    {
+        const char* cacheHome = getenv("XDG_CACHE_HOME");
+        if (cacheHome && *cacheHome)
+        {
+            return std::string(cacheHome) + "/gBar/icon-index";
+        }
+        const char* home = getenv("HOME");
+        if (home)
+        {
+            return std::string(home) + "/.cache/gBar/icon-index";
+        }
+        return "";
+    }
+
+    // Pixel size of a theme directory, e.g. 48x48 or 24x24@2
+    static uint32_t ParseSize(const char* name, uint32_t parentSize)
+    {
+        char* end;
+        unsigned long width = strtoul(name, &end, 10);
+        if (end == name || *end != 'x')
+        {
+            return parentSize;
+        }
+        const char* heightStr = end + 1;
+        strtoul(heightStr, &end, 10);
+        if (end == heightStr)
+        {
+            return parentSize;
+        }
+        unsigned long scale = 1;
+        if (*end == '@')
+        {
+            const char* scaleStr = end + 1;
+            scale = strtoul(scaleStr, &end, 10);
+            if (end == scaleStr || scale == 0)
+            {
+                return parentSize;
+            }
+        }
+        return *end == '\0' ? (uint32_t)(width * scale) : parentSize;
+    }
+
+    struct Builder
+    {
+        std::vector<Dir> dirs;
+        std::vector<Entry> entries;
+        std::string strings;
+        // Name -> first and last entry of its chain
+        std::unordered_map<std::string, std::pair<uint32_t, uint32_t>> chains;
+
+        uint32_t AddString(const std::string& str)
+        {
+            uint32_t offset = strings.size();
+            strings.append(str.c_str(), str.size() + 1);
+            return offset;
+        }
+
+        uint32_t AddDir(const std::string& path, const struct stat* st)
+        {
+            Dir dir{};
+            dir.path = AddString(path);
+            dir.mtimeSec = st ? st->st_mtim.tv_sec : -1;
+            dir.mtimeNsec = st ? st->st_mtim.tv_nsec : -1;
+            dirs.push_back(dir);
+            return dirs.size() - 1;
+        }
+
+        void AddIcon(std::string&& name, uint32_t dir, uint32_t size)
+        {
+            uint32_t index = entries.size();
+            auto [it, inserted] = chains.try_emplace(std::move(name), index, index);
+            // Same names share the string, appending keeps the scan (= root) order in the chain
+            entries.push_back({inserted ? AddString(it->first) : entries[it->second.first].name, dir, size, none});
+            if (!inserted)
+            {
+                entries[it->second.second].next = index;
+                it->second.second = index;
+            }
+        }
+
+        void Scan(const std::string& path, uint32_t dirIndex, uint32_t size)
+        {
+            DIR* dir = opendir(path.c_str());
+            if (!dir)
+            {
+                return;
+            }
+            std::vector<std::pair<std::string, uint32_t>> subdirs;
+            struct dirent* ent;
+            while ((ent = readdir(dir)))
+            {
+                if (strcmp(ent->d_name, ".") == 0 || strcmp(ent->d_name, "..") == 0)
+                {
+                    continue;
+                }
+                unsigned char type = ent->d_type;
+                if (type == DT_UNKNOWN || type == DT_LNK)
+                {
+                    // Linked icons count, linked directories aren't followed (like before, avoids loops)
+                    struct stat st;
+                    if (fstatat(dirfd(dir), ent->d_name, &st, type == DT_LNK ? 0 : AT_SYMLINK_NOFOLLOW) != 0)
+                    {
+                        continue;
+                    }
+                    type = S_ISREG(st.st_mode) ? DT_REG : (S_ISDIR(st.st_mode) && type == DT_UNKNOWN ? DT_DIR : DT_UNKNOWN);
+                }
+                size_t length = strlen(ent->d_name);
+                if (type == DT_DIR)
+                {
+                    subdirs.emplace_back(ent->d_name, ParseSize(ent->d_name, size));
+                }
+                else if (type == DT_REG && length > 4 && strcmp(ent->d_name + length - 4, ".png") == 0)
+                {
+                    AddIcon(std::string(ent->d_name, length - 4), dirIndex, size);
+                }
+            }
+            closedir(dir);
+
+            for (auto& [subdir, subdirSize] : subdirs)
+            {
+                std::string subdirPath = path + "/" + subdir;
+                struct stat st;
+                if (stat(subdirPath.c_str(), &st) != 0)
+                {
+                    continue;
+                }
+                Scan(subdirPath, AddDir(subdirPath, &st), subdirSize);
+            }
+        }
+
+        std::vector<uint8_t> Serialize(uint32_t numRoots)
+        {
+            uint32_t numBuckets = 16;
+            // Load factor <= 0.5
+            while (numBuckets < chains.size() * 2)
+            {
+                numBuckets *= 2;
+            }
+            std::vector<uint32_t> buckets(numBuckets, none);
+            for (auto& [name, chain] : chains)
+            {
+                uint32_t bucket = Hash(name.c_str(), name.size()) & (numBuckets - 1);
+                while (buckets[bucket] != none)
+                {
+                    bucket = (bucket + 1) & (numBuckets - 1);
+                }
+                buckets[bucket] = chain.first;
+            }
+
+            Header header{};
+            memcpy(header.magic, magic, sizeof(magic));
+            header.version = version;
+            header.numRoots = numRoots;
+            header.numDirs = dirs.size();
+            header.numBuckets = numBuckets;
+            header.numEntries = entries.size();
+            header.stringsSize = strings.size();
+
+            std::vector<uint8_t> out;
+            auto append = [&](const void* data, size_t size)
+            {
+                out.insert(out.end(), (const uint8_t*)data, (const uint8_t*)data + size);
+            };
+            append(&header, sizeof(header));
+            append(dirs.data(), dirs.size() * sizeof(Dir));
+            append(buckets.data(), buckets.size() * sizeof(uint32_t));
+            append(entries.data(), entries.size() * sizeof(Entry));
+            append(strings.data(), strings.size());
+            return out;
+        }
+    };
+
+    static void Unload()
+    {
+        if (mapped)
+        {
+            munmap(mapped, mappedSize);
+            mapped = nullptr;
+            mappedSize = 0;
+        }
+        built.clear();
+        view = {};
+    }
+
+    static bool MapCache(const std::string& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+        {
+            return false;
+        }
+        struct stat st;
+        if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(Header))
+        {
+            close(fd);
+            return false;
+        }
+        void* data = mmap(nullptr, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        if (data == MAP_FAILED)
+        {
+            return false;
+        }
+        if (!view.Set((const uint8_t*)data, st.st_size))
+        {
+            LOG("IconIndex: Ignoring corrupt cache " << path);
+            munmap(data, st.st_size);
+            view = {};
+            return false;
+        }
+        mapped = data;
+        mappedSize = st.st_size;
+        return true;
+    }
+
+    // Whether the index still describes the directories on disk
+    static bool IsUpToDate(const std::vector<std::string>& roots)
+    {
+        if (view.header->numRoots != roots.size())
+        {
+            return false;
+        }
+        for (uint32_t i = 0; i < view.header->numDirs; i++)
+        {
+            const Dir& dir = view.dirs[i];
+            const char* path = view.strings + dir.path;
+            if (i < roots.size() && roots[i] != path)
+            {
+                return false;
+            }
+            struct stat st;
+            bool exists = stat(path, &st) == 0;
+            if (!exists)
+            {
+                if (dir.mtimeSec != -1)
+                {
+                    return false;
+                }
+                continue;
+            }
+            if (dir.mtimeSec != st.st_mtim.tv_sec || dir.mtimeNsec != st.st_mtim.tv_nsec)
+            {
+                return false;
+            }
+        }
+        return true;
+    }
+
+    static void WriteCache(const std::string& path, const std::vector<uint8_t>& data)
+    {
+        std::string dir = path.substr(0, path.rfind('/'));
+        std::string parent = dir.substr(0, dir.rfind('/'));
+        // ~/.cache might not exist yet
+        mkdir(parent.c_str(), 0700);
+        mkdir(dir.c_str(), 0700);
+
+        // Write to a temporary and rename, so other instances never map a half written file
+        std::string tmpPath = path + "." + std::to_string(getpid());
+        int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+        if (fd < 0)
+        {
+            LOG("IconIndex: Cannot write " << tmpPath << ": " << strerror(errno));
+            return;
+        }
+        size_t written = 0;
+        while (written < data.size())
+        {
+            ssize_t res = write(fd, data.data() + written, data.size() - written);
+            if (res < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (res <= 0)
+            {
+                LOG("IconIndex: Cannot write " << tmpPath << ": " << strerror(errno));
+                close(fd);
+                unlink(tmpPath.c_str());
+                return;
+            }
+            written += res;
+        }
+        close(fd);
+        if (rename(tmpPath.c_str(), path.c_str()) != 0)
+        {
+            LOG("IconIndex: Cannot rename " << tmpPath << ": " << strerror(errno));
+            unlink(tmpPath.c_str());
+        }
+    }
+
+    static void Rebuild(const std::vector<std::string>& roots, const std::string& cachePath)
+    {
+        Unload();
+        misses.clear();
+        LOG("IconIndex: Scanning icon directories");
+        Builder builder;
+        // Roots first, so their mtimes are validated and their order is known
+        std::vector<struct stat> rootStats(roots.size());
+        for (size_t i = 0; i < roots.size(); i++)
+        {
+            bool exists = stat(roots[i].c_str(), &rootStats[i]) == 0 && S_ISDIR(rootStats[i].st_mode);
+            builder.AddDir(roots[i], exists ? &rootStats[i] : nullptr);
+        }
+        for (size_t i = 0; i < roots.size(); i++)
+        {
+            if (builder.dirs[i].mtimeSec != -1)
+            {
+                builder.Scan(roots[i], i, 0);
+            }
+        }
+        LOG("IconIndex: Indexed " << builder.entries.size() << " icons in " << builder.dirs.size() << " directories");
+        built = builder.Serialize(roots.size());
+
+        if (!cachePath.empty())
+        {
+            WriteCache(cachePath, built);
+            if (MapCache(cachePath))
+            {
+                // Share the pages with the file
+                built.clear();
+                built.shrink_to_fit();
+                return;
+            }
+        }
+        view.Set(built.data(), built.size());
+    }
+
+    static void Validate()
+    {
+        std::vector<std::string> roots = GetRoots();
+        std::string cachePath = GetCachePath();
+        if (!view.header && !cachePath.empty())
+        {
+            MapCache(cachePath);
+        }
+        if (view.header && IsUpToDate(roots))
+        {
+            return;
+        }
+        Rebuild(roots, cachePath);
+    }
+
+    static uint32_t Lookup(const std::string& name, uint32_t size)
+    {
+        uint32_t mask = view.header->numBuckets - 1;
+        uint32_t bucket = Hash(name.c_str(), name.size()) & mask;
+        // Load factor is at most 0.5, so there is always an empty bucket to stop at
+        for (uint32_t probes = 0; probes <= mask && view.buckets[bucket] != none; probes++)
+        {
+            const Entry* entry = &view.entries[view.buckets[bucket]];
+            if (name != view.strings + entry->name)
+            {
+                bucket = (bucket + 1) & mask;
+                continue;
+            }
+
+            uint32_t best = view.buckets[bucket];
+            for (uint32_t i = best; i != none; i = view.entries[i].next)
+            {
+                uint32_t candidate = view.entries[i].size;
+                uint32_t current = view.entries[best].size;
+                bool better = size == 0 ? candidate > current
+                                        : std::abs((int64_t)candidate - size) < std::abs((int64_t)current - size);
+                if (better)
+                {
+                    best = i;
+                }
+            }
+            return best;
+        }
+        return none;
+    }
+
+    std::string Find(const std::string& name, uint32_t size)
+    {
+        if (!loaded)
+        {
+            loaded = true;
+            Validate();
+        }
+        uint32_t entry = Lookup(name, size);
+        if (entry == none && misses.count(name) == 0)
+        {
+            Validate();
+            entry = Lookup(name, size);
+        }
+        if (entry == none)
+        {
+            misses.insert(name);
+            return "";
+        }
+        return std::string(view.strings + view.dirs[view.entries[entry].dir].path) + "/" + name + ".png";
+    }
+}
@@ -0,0 +1,12 @@
+#pragma once
+#include <string>
+#include <cstdint>
+
+// Index of the png icons below $XDG_DATA_DIRS/icons and /usr/share/icons, so looking up an icon by name doesn't walk the whole tree.
+// Built once and stored in $XDG_CACHE_HOME/gBar/icon-index, which is mapped on startup and rebuilt, once a directory has changed.
+namespace IconIndex
+{
+    // Full path of the icon with the file name name.png, "" if there is none.
+    // Prefers the icon closest to size, 0 prefers the largest one.
+    std::string Find(const std::string& name, uint32_t size = 0);
+}
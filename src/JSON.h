@@ -0,0 +1,296 @@
+#pragma once
+#include <string_view>
+#include <vector>
+#include <utility>
+#include <cstdlib>
+#include <cstdint>
+#include <string>
+#include <algorithm>
+#include <cctype>
+
+// Small JSON parser for IPC replies.
+// Strings reference the parsed buffer (still escaped), so the buffer has to outlive the values.
+namespace JSON
+{
+    enum class Type
+    {
+        Null,
+        Bool,
+        Number,
+        String,
+        Array,
+        Object
+    };
+
+    struct Value
+    {
+        Type type = Type::Null;
+        bool boolean = false;
+        double number = 0;
+        // Contents of a string, without the quotes and not unescaped.
+        std::string_view string;
+        std::vector<Value> elements;
+        std::vector<std::pair<std::string_view, Value>> members;
+
+        // nullptr, if this is not an object or the key doesn't exist
+        const Value* Get(std::string_view key) const
+        {
+            for (auto& [name, value] : members)
+            {
+                if (name == key)
+                    return &value;
+            }
+            return nullptr;
+        }
+
+        // Convenience accessors with a fallback for missing keys/wrong types
+        int64_t GetInt(std::string_view key, int64_t fallback = 0) const
+        {
+            const Value* value = Get(key);
+            return value && value->type == Type::Number ? (int64_t)value->number : fallback;
+        }
+        bool GetBool(std::string_view key, bool fallback = false) const
+        {
+            const Value* value = Get(key);
+            return value && value->type == Type::Bool ? value->boolean : fallback;
+        }
+        std::string_view GetString(std::string_view key, std::string_view fallback = {}) const
+        {
+            const Value* value = Get(key);
+            return value && value->type == Type::String ? value->string : fallback;
+        }
+    };
+
+    namespace Impl
+    {
+        struct Parser
+        {
+            std::string_view src;
+            size_t pos = 0;
+
+            void SkipWhitespace()
+            {
+                while (pos < src.size() && (src[pos] == ' ' || src[pos] == '\n' || src[pos] == '\r' || src[pos] == '\t'))
+                    pos++;
+            }
+
+            bool Consume(std::string_view literal)
+            {
+                if (src.substr(pos, literal.size()) != literal)
+                    return false;
+                pos += literal.size();
+                return true;
+            }
+
+            bool ParseString(std::string_view& out)
+            {
+                // Opening quote already checked
+                pos++;
+                size_t begin = pos;
+                while (pos < src.size())
+                {
+                    if (src[pos] == '\\')
+                    {
+                        pos += 2;
+                        continue;
+                    }
+                    if (src[pos] == '"')
+                    {
+                        out = src.substr(begin, pos - begin);
+                        pos++;
+                        return true;
+                    }
+                    pos++;
+                }
+                return false;
+            }
+
+            bool ParseNumber(double& out)
+            {
+                size_t begin = pos;
+                while (pos < src.size() && (isdigit((unsigned char)src[pos]) || src[pos] == '-' || src[pos] == '+' || src[pos] == '.' ||
+                                            src[pos] == 'e' || src[pos] == 'E'))
+                    pos++;
+                if (begin == pos)
+                    return false;
+                // strtod needs a terminated string, numbers are short.
+                char buf[64];
+                size_t len = std::min(pos - begin, sizeof(buf) - 1);
+                src.copy(buf, len, begin);
+                buf[len] = '\0';
+                char* end;
+                out = strtod(buf, &end);
+                return end != buf;
+            }
+
+            bool ParseValue(Value& out, uint32_t depth)
+            {
+                // Don't blow the stack on garbage
+                if (depth > 64)
+                    return false;
+                SkipWhitespace();
+                if (pos >= src.size())
+                    return false;
+
+                switch (src[pos])
+                {
+                case '"': out.type = Type::String; return ParseString(out.string);
+                case 't':
+                    out.type = Type::Bool;
+                    out.boolean = true;
+                    return Consume("true");
+                case 'f':
+                    out.type = Type::Bool;
+                    out.boolean = false;
+                    return Consume("false");
+                case 'n': out.type = Type::Null; return Consume("null");
+                case '[':
+                {
+                    out.type = Type::Array;
+                    pos++;
+                    SkipWhitespace();
+                    if (pos < src.size() && src[pos] == ']')
+                    {
+                        pos++;
+                        return true;
+                    }
+                    while (true)
+                    {
+                        Value& element = out.elements.emplace_back();
+                        if (!ParseValue(element, depth + 1))
+                            return false;
+                        SkipWhitespace();
+                        if (pos >= src.size())
+                            return false;
+                        if (src[pos++] == ']')
+                            return true;
+                        if (src[pos - 1] != ',')
+                            return false;
+                    }
+                }
+                case '{':
+                {
+                    out.type = Type::Object;
+                    pos++;
+                    SkipWhitespace();
+                    if (pos < src.size() && src[pos] == '}')
+                    {
+                        pos++;
+                        return true;
+                    }
+                    while (true)
+                    {
+                        SkipWhitespace();
+                        if (pos >= src.size() || src[pos] != '"')
+                            return false;
+                        auto& member = out.members.emplace_back();
+                        if (!ParseString(member.first))
+                            return false;
+                        SkipWhitespace();
+                        if (!Consume(":"))
+                            return false;
+                        if (!ParseValue(member.second, depth + 1))
+                            return false;
+                        SkipWhitespace();
+                        if (pos >= src.size())
+                            return false;
+                        if (src[pos++] == '}')
+                            return true;
+                        if (src[pos - 1] != ',')
+                            return false;
+                    }
+                }
+                default: out.type = Type::Number; return ParseNumber(out.number);
+                }
+            }
+        };
+    }
+
+    // Parses all top level values in the buffer (e.g. the concatenated replies of a batch request).
+    // Returns false on a syntax error; values parsed until then are kept.
+    inline bool ParseAll(std::string_view src, std::vector<Value>& out)
+    {
+        Impl::Parser parser{src};
+        while (true)
+        {
+            parser.SkipWhitespace();
+            if (parser.pos >= src.size())
+                return true;
+            Value value;
+            if (!parser.ParseValue(value, 0))
+                return false;
+            out.push_back(std::move(value));
+        }
+    }
+
+    inline bool Parse(std::string_view src, Value& out)
+    {
+        Impl::Parser parser{src};
+        return parser.ParseValue(out, 0);
+    }
+
+    // Resolves the escape sequences of a parsed string
+    inline std::string Unescape(std::string_view escaped)
+    {
+        std::string out;
+        out.reserve(escaped.size());
+        for (size_t i = 0; i < escaped.size(); i++)
+        {
+            if (escaped[i] != '\\' || i + 1 >= escaped.size())
+            {
+                out += escaped[i];
+                continue;
+            }
+            char c = escaped[++i];
+            switch (c)
+            {
+            case 'n': out += '\n'; break;
+            case 't': out += '\t'; break;
+            case 'r': out += '\r'; break;
+            case 'b': out += '\b'; break;
+            case 'f': out += '\f'; break;
+            case 'u':
+            {
+                if (i + 4 >= escaped.size())
+                    return out;
+                uint32_t codepoint = strtoul(std::string(escaped.substr(i + 1, 4)).c_str(), nullptr, 16);
+                i += 4;
+                // Surrogate pair
+                if (codepoint >= 0xD800 && codepoint < 0xDC00 && i + 6 < escaped.size() && escaped[i + 1] == '\\' && escaped[i + 2] == 'u')
+                {
+                    uint32_t low = strtoul(std::string(escaped.substr(i + 3, 4)).c_str(), nullptr, 16);
+                    codepoint = 0x10000 + ((codepoint - 0xD800) << 10) + (low - 0xDC00);
+                    i += 6;
+                }
+                // UTF-8
+                if (codepoint < 0x80)
+                {
+                    out += (char)codepoint;
+                }
+                else if (codepoint < 0x800)
+                {
+                    out += (char)(0xC0 | (codepoint >> 6));
+                    out += (char)(0x80 | (codepoint & 0x3F));
+                }
+                else if (codepoint < 0x10000)
+                {
+                    out += (char)(0xE0 | (codepoint >> 12));
+                    out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+                    out += (char)(0x80 | (codepoint & 0x3F));
+                }
+                else
+                {
+                    out += (char)(0xF0 | (codepoint >> 18));
+                    out += (char)(0x80 | ((codepoint >> 12) & 0x3F));
+                    out += (char)(0x80 | ((codepoint >> 6) & 0x3F));
+                    out += (char)(0x80 | (codepoint & 0x3F));
+                }
+                break;
+            }
+            // \", \\ and \/
+            default: out += c; break;
+            }
+        }
+        return out;
+    }
+}
@@ -0,0 +1,184 @@
+#include "Mixer.h"
+#include "System.h"
+#include "Common.h"
+#include <unordered_map>
+
+namespace Mixer
+{
+    namespace DynCtx
+    {
+        struct Row
+        {
+            Box* box;
+            Text* name;
+            Slider* slider;
+        };
+
+        // Keyed by sink input index, so rows can be added and removed without rebuilding the list
+        std::unordered_map<uint32_t, Row> rows;
+        Box* streamListBox;
+        Window* win;
+
+        void UpdateRow(Row& row, const System::SinkInput& input)
+        {
+            row.name->SetText(input.name);
+            row.box->SetTooltip(input.description);
+            row.slider->SetValue(input.volume);
+            if (input.muted)
+            {
+                row.box->AddClass("muted");
+            }
+            else
+            {
+                row.box->RemoveClass("muted");
+            }
+        }
+
+        void AddRow(const System::SinkInput& input)
+        {
+            auto box = Widget::Create<Box>();
+            box->SetClass("mixer-stream");
+            box->SetSpacing({8, false});
+            {
+                auto name = Widget::Create<Text>();
+                name->SetClass("mixer-app-name");
+                name->SetHorizontalTransform({-1, false, Alignment::Left});
+
+                auto slider = Widget::Create<Slider>();
+                slider->SetOrientation(Orientation::Horizontal);
+                slider->SetHorizontalTransform({100, true, Alignment::Fill});
+                slider->SetClass("mixer-volume");
+                slider->SetRange({0, 1, 0.01});
+                slider->SetScrollSpeed((double)Config::Get().audioScrollSpeed / 100.);
+                slider->OnValueChange(
+                    [index = input.index](Slider&, double value)
+                    {
+                        System::SetSinkInputVolume(index, value);
+                    });
+
+                Row row{box.get(), name.get(), slider.get()};
+                UpdateRow(row, input);
+                rows[input.index] = row;
+
+                box->AddChild(std::move(name));
+                box->AddChild(std::move(slider));
+            }
+            streamListBox->AddChild(std::move(box));
+        }
+
+        void OnSinkInputChanged(System::ChangeType type, const System::SinkInput& input)
+        {
+            auto it = rows.find(input.index);
+            switch (type)
+            {
+            case System::ChangeType::Added:
+            case System::ChangeType::Changed:
+                if (it == rows.end())
+                {
+                    AddRow(input);
+                }
+                else
+                {
+                    UpdateRow(it->second, input);
+                }
+                break;
+            case System::ChangeType::Removed:
+                if (it != rows.end())
+                {
+                    streamListBox->RemoveChild(it->second.box);
+                    rows.erase(it);
+                }
+                break;
+            }
+        }
+
+        void Close(Button&)
+        {
+            win->Close();
+        }
+    }
+
+    void WidgetHeader(Widget& parentWidget)
+    {
+        auto headerBox = Widget::Create<Box>();
+        headerBox->SetClass("mixer-header-box");
+        {
+            auto headerText = Widget::Create<Text>();
+            headerText->SetText("󰕾 Mixer");
+            headerText->SetHorizontalTransform({-1, true, Alignment::Left});
+            headerBox->AddChild(std::move(headerText));
+
+            auto headerClose = Widget::Create<Button>();
+            headerClose->SetText("");
+            headerClose->SetClass("mixer-close");
+            headerClose->OnClick(DynCtx::Close);
+            headerBox->AddChild(std::move(headerClose));
+        }
+        parentWidget.AddChild(std::move(headerBox));
+    }
+
+    void WidgetBody(Widget& parentWidget)
+    {
+        auto bodyBox = Widget::Create<Box>();
+        DynCtx::streamListBox = bodyBox.get();
+        bodyBox->SetOrientation(Orientation::Vertical);
+        bodyBox->SetClass("mixer-body-box");
+
+        // Initial state is already known, everything else is driven by events.
+        for (auto& [index, input] : System::GetSinkInputs())
+        {
+            DynCtx::AddRow(input);
+        }
+        System::AddSinkInputCallback(DynCtx::OnSinkInputChanged);
+
+        parentWidget.AddChild(std::move(bodyBox));
+    }
+
+    void Create(Window& window, UNUSED int32_t monitor)
+    {
+        DynCtx::win = &window;
+        auto mainWidget = Widget::Create<Box>();
+        mainWidget->SetSpacing({8, false});
+        mainWidget->SetOrientation(Orientation::Vertical);
+        mainWidget->SetVerticalTransform({32, true, Alignment::Fill});
+        mainWidget->SetHorizontalTransform({300, true, Alignment::Fill});
+        mainWidget->SetClass("mixer-bg");
+
+        WidgetHeader(*mainWidget);
+        WidgetBody(*mainWidget);
+
+        window.SetExclusive(false);
+        Anchor anchor;
+        Anchor marginAnchor;
+        switch (Config::Get().location)
+        {
+        case 'T':
+            anchor = Anchor::Right | Anchor::Top;
+            marginAnchor = Anchor::Top;
+            break;
+        case 'B':
+            anchor = Anchor::Bottom | Anchor::Right;
+            marginAnchor = Anchor::Bottom;
+            break;
+        case 'L':
+            anchor = Anchor::Left | Anchor::Bottom;
+            marginAnchor = Anchor::Left;
+            // TODO: Config
+            window.SetMargin(Anchor::Bottom, 150);
+            break;
+        case 'R':
+            anchor = Anchor::Right | Anchor::Bottom;
+            marginAnchor = Anchor::Right;
+            // TODO: Config
+            window.SetMargin(Anchor::Bottom, 150);
+            break;
+        default:
+            LOG("Invalid location char \"" << Config::Get().location << "\"!");
+            anchor = Anchor::Right | Anchor::Top;
+            marginAnchor = Anchor::Top;
+        }
+        window.SetMargin(marginAnchor, 8);
+        window.SetAnchor(anchor);
+        window.SetMainWidget(std::move(mainWidget));
+    }
+}
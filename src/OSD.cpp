@@ -0,0 +1,260 @@
+#include "OSD.h"
+#include "System.h"
+#include "Config.h"
+#include "Common.h"
+#include "Control.h"
+
+#include <array>
+
+namespace OSD
+{
+    namespace DynCtx
+    {
+        struct Surface
+        {
+            std::unique_ptr<Window> window;
+            Slider* slider = nullptr;
+            Text* icon = nullptr;
+            // Changes before this time (monotonic, us) are caused by us.
+            int64_t inhibitUntil = 0;
+        };
+        std::array<Surface, 3> surfaces;
+        bool created = false;
+
+        Surface* visible = nullptr;
+        guint closeTimer = 0;
+
+        System::AudioInfo lastAudio;
+
+        // PulseAudio round trip + pamixer startup. Generous, since a missed inhibit just shows the OSD.
+        constexpr int64_t inhibitTime = 500 * 1000;
+
+        Surface& Get(Type type)
+        {
+            return surfaces[(size_t)type];
+        }
+
+        void RestartCloseTimer()
+        {
+            if (closeTimer)
+            {
+                g_source_remove(closeTimer);
+            }
+            closeTimer = g_timeout_add(
+                Config::Get().osdCloseTime,
+                +[](void*) -> int
+                {
+                    closeTimer = 0;
+                    if (visible)
+                    {
+                        visible->window->Hide();
+                        visible = nullptr;
+                    }
+                    return false;
+                },
+                nullptr);
+        }
+
+        void OnChangeValue(Type type, double value)
+        {
+            Inhibit(type);
+            // Keep it open, while it is being dragged
+            RestartCloseTimer();
+            switch (type)
+            {
+            case Type::Volume: System::SetVolumeSink(value); break;
+            case Type::Mic: System::SetVolumeSource(value); break;
+            // Insensitive, see CreateSurface
+            case Type::Brightness: break;
+            }
+        }
+
+        void UpdateSurface(Type type)
+        {
+            Surface& surface = Get(type);
+            switch (type)
+            {
+            case Type::Volume:
+            {
+                System::AudioInfo info = System::GetAudioInfo();
+                surface.slider->SetValue(info.sinkVolume);
+                surface.icon->SetText(info.sinkMuted ? "󰝟" : "󰕾");
+                break;
+            }
+            case Type::Mic:
+            {
+                System::AudioInfo info = System::GetAudioInfo();
+                surface.slider->SetValue(info.sourceVolume);
+                surface.icon->SetText(info.sourceMuted ? "󰍭" : "󰍬");
+                break;
+            }
+            case Type::Brightness:
+                surface.slider->SetValue(System::GetBrightness());
+                surface.icon->SetText("󰃠");
+                break;
+            }
+        }
+
+        bool IsInhibited(Type type)
+        {
+            return g_get_monotonic_time() < Get(type).inhibitUntil;
+        }
+
+        void OnAudioChanged(const System::AudioInfo& info)
+        {
+            if ((info.sinkVolume != lastAudio.sinkVolume || info.sinkMuted != lastAudio.sinkMuted) && !IsInhibited(Type::Volume))
+            {
+                Show(Type::Volume);
+            }
+            if ((info.sourceVolume != lastAudio.sourceVolume || info.sourceMuted != lastAudio.sourceMuted) && !IsInhibited(Type::Mic))
+            {
+                Show(Type::Mic);
+            }
+            lastAudio = info;
+        }
+
+        void OnBrightnessChanged(double)
+        {
+            if (!IsInhibited(Type::Brightness))
+            {
+                Show(Type::Brightness);
+            }
+        }
+
+        void CreateSurface(Type type, int32_t monitor)
+        {
+            Surface& surface = Get(type);
+            surface.window = std::make_unique<Window>(monitor);
+
+            auto mainWidget = Widget::Create<Box>();
+            mainWidget->SetSpacing({8, false});
+            mainWidget->SetVerticalTransform({16, true, Alignment::Fill});
+            mainWidget->SetClass("bar");
+            mainWidget->AddClass("osd");
+
+            auto padding = Widget::Create<Box>();
+            padding->SetHorizontalTransform({8, true, Alignment::Fill});
+            mainWidget->AddChild(std::move(padding));
+
+            auto slider = Widget::Create<Slider>();
+            slider->SetOrientation(Orientation::Horizontal);
+            slider->SetHorizontalTransform({100, true, Alignment::Fill});
+            slider->SetInverted(true);
+            slider->SetRange({0, 1, 0.01});
+            slider->OnValueChange(
+                [type](Slider&, double value)
+                {
+                    OnChangeValue(type, value);
+                });
+
+            auto icon = Widget::Create<Text>();
+            icon->SetHorizontalTransform({-1, true, Alignment::Fill, 0, 8});
+            switch (type)
+            {
+            case Type::Volume:
+                slider->SetClass("audio-volume");
+                icon->SetClass("audio-icon");
+                break;
+            case Type::Mic:
+                slider->SetClass("mic-volume");
+                icon->SetClass("mic-icon");
+                break;
+            case Type::Brightness:
+                slider->SetClass("brightness-volume");
+                icon->SetClass("brightness-icon");
+                // Writing the backlight needs elevated permissions, so it is only a display
+                slider->SetSensitive(false);
+                break;
+            }
+            surface.slider = slider.get();
+            surface.icon = icon.get();
+            mainWidget->AddChild(std::move(slider));
+            mainWidget->AddChild(std::move(icon));
+
+            padding = Widget::Create<Box>();
+            mainWidget->AddChild(std::move(padding));
+
+            surface.window->SetExclusive(false);
+            surface.window->SetAnchor(Anchor::Bottom);
+            surface.window->SetMargin(Anchor::Bottom, 50);
+            surface.window->SetMainWidget(std::move(mainWidget));
+
+            UpdateSurface(type);
+            // Create the layer surface and widgets now, so revealing it later is just a map.
+            surface.window->Create();
+        }
+    }
+
+    void Create(int32_t monitor)
+    {
+        if (DynCtx::created)
+        {
+            return;
+        }
+        DynCtx::created = true;
+
+        DynCtx::CreateSurface(Type::Volume, monitor);
+        DynCtx::CreateSurface(Type::Mic, monitor);
+        DynCtx::CreateSurface(Type::Brightness, monitor);
+
+        Control::AddCommand("osd",
+                            [](const std::vector<std::string_view>& args, std::string& response)
+                            {
+                                if (args.size() == 2 && args[1] == "volume")
+                                {
+                                    Show(Type::Volume);
+                                }
+                                else if (args.size() == 2 && args[1] == "mic")
+                                {
+                                    Show(Type::Mic);
+                                }
+                                else if (args.size() == 2 && args[1] == "brightness" && System::GetBrightness() >= 0)
+                                {
+                                    Show(Type::Brightness);
+                                }
+                                else
+                                {
+                                    response = "usage: osd volume|mic|brightness";
+                                    return false;
+                                }
+                                return true;
+                            });
+
+        DynCtx::lastAudio = System::GetAudioInfo();
+        System::AddAudioCallback(DynCtx::OnAudioChanged);
+        System::AddBrightnessCallback(DynCtx::OnBrightnessChanged);
+    }
+
+    void Show(Type type)
+    {
+        if (!DynCtx::created)
+        {
+            LOG("OSD: Not created!");
+            return;
+        }
+        if (type == Type::Brightness && System::GetBrightness() < 0)
+        {
+            LOG("OSD: No backlight available!");
+            return;
+        }
+        DynCtx::Surface& surface = DynCtx::Get(type);
+        DynCtx::UpdateSurface(type);
+        if (DynCtx::visible != &surface)
+        {
+            // Only one OSD at a time
+            if (DynCtx::visible)
+            {
+                DynCtx::visible->window->Hide();
+            }
+            surface.window->Show();
+            DynCtx::visible = &surface;
+        }
+
+        DynCtx::RestartCloseTimer();
+    }
+
+    void Inhibit(Type type)
+    {
+        DynCtx::Get(type).inhibitUntil = g_get_monotonic_time() + DynCtx::inhibitTime;
+    }
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include "Widget.h"
+#include "Window.h"
+
+namespace OSD
+{
+    enum class Type
+    {
+        Volume,
+        Mic,
+        Brightness
+    };
+
+    // Creates the (hidden) OSD windows. Has to be called before the main window is run.
+    void Create(int32_t monitor);
+
+    // Reveals the OSD of this type with the current value and (re)starts its close timer.
+    void Show(Type type);
+
+    // The next change of this type was caused by us (e.g. the bar's volume slider), so don't reveal the OSD for it.
+    void Inhibit(Type type);
+}
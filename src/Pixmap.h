@@ -0,0 +1,57 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define PIXMAP_SIMD_X86
+#include <immintrin.h>
+#endif
+
+// Conversion of tray icon pixmaps. Kept free of GTK, so bench/ArgbToRgba.cpp can time and compare the variants.
+namespace Pixmap
+{
+    // Pixmaps are ARGB32 in network byte order(=a, r, g, b in memory), pixbufs want r, g, b, a.
+    inline void ArgbToRgbaScalar(const uint8_t* src, uint8_t* dst, size_t numPixels)
+    {
+        for (size_t i = 0; i < numPixels * 4; i += 4)
+        {
+            dst[i + 0] = src[i + 1];
+            dst[i + 1] = src[i + 2];
+            dst[i + 2] = src[i + 3];
+            dst[i + 3] = src[i + 0];
+        }
+    }
+
+#ifdef PIXMAP_SIMD_X86
+    // 4 pixels per shuffle. Compiled for SSSE3 regardless of the build flags, only called if the CPU supports it.
+    __attribute__((target("ssse3"))) inline void ArgbToRgbaSSSE3(const uint8_t* src, uint8_t* dst, size_t numPixels)
+    {
+        const __m128i mask = _mm_setr_epi8(1, 2, 3, 0, 5, 6, 7, 4, 9, 10, 11, 8, 13, 14, 15, 12);
+        size_t i = 0;
+        for (; i + 4 <= numPixels; i += 4)
+        {
+            __m128i pixels = _mm_loadu_si128((const __m128i*)(src + i * 4));
+            _mm_storeu_si128((__m128i*)(dst + i * 4), _mm_shuffle_epi8(pixels, mask));
+        }
+        ArgbToRgbaScalar(src + i * 4, dst + i * 4, numPixels - i);
+    }
+
+    inline bool HasSSSE3()
+    {
+        static bool hasSSSE3 = __builtin_cpu_supports("ssse3");
+        return hasSSSE3;
+    }
+#endif
+
+    inline void ArgbToRgba(const uint8_t* src, uint8_t* dst, size_t numPixels)
+    {
+#ifdef PIXMAP_SIMD_X86
+        if (HasSSSE3())
+        {
+            ArgbToRgbaSSSE3(src, dst, numPixels);
+            return;
+        }
+#endif
+        ArgbToRgbaScalar(src, dst, numPixels);
+    }
+}
@@ -0,0 +1,273 @@
+#include "Process.h"
+#include "Common.h"
+
+#include <unordered_map>
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+
+#include <fcntl.h>
+#include <spawn.h>
+#include <sys/syscall.h>
+#include <sys/wait.h>
+#include <glib.h>
+#include <glib-unix.h>
+
+extern char** environ;
+
+namespace Process
+{
+    struct Child
+    {
+        pid_t pid = -1;
+        int pidfd = -1;
+        int outputFd = -1;
+        guint exitSource = 0;
+        guint outputSource = 0;
+        guint timeoutSource = 0;
+        bool exited = false;
+        Result result;
+        std::function<void(const Result&)> onFinish;
+    };
+
+    static std::unordered_map<Handle, Child> children;
+    static Handle nextHandle = 1;
+    // Don't let a runaway command fill up the memory
+    static constexpr size_t maxOutput = 1024 * 1024;
+
+    static void* ToData(Handle handle)
+    {
+        return (void*)(uintptr_t)handle;
+    }
+
+    static Handle FromData(void* data)
+    {
+        return (Handle)(uintptr_t)data;
+    }
+
+    static void CloseOutput(Child& child)
+    {
+        if (child.outputSource)
+        {
+            g_source_remove(child.outputSource);
+            child.outputSource = 0;
+        }
+        if (child.outputFd >= 0)
+        {
+            close(child.outputFd);
+            child.outputFd = -1;
+        }
+    }
+
+    // Finishes the child, once it exited and all of its output is read
+    static void TryFinish(Handle handle)
+    {
+        auto it = children.find(handle);
+        Child& child = it->second;
+        if (!child.exited || child.outputFd >= 0)
+        {
+            return;
+        }
+        if (child.timeoutSource)
+        {
+            g_source_remove(child.timeoutSource);
+        }
+        Child finished = std::move(child);
+        children.erase(it);
+        if (finished.onFinish)
+        {
+            finished.onFinish(finished.result);
+        }
+    }
+
+    static void OnExited(Handle handle, int status)
+    {
+        Child& child = children.at(handle);
+        child.exited = true;
+        child.result.exitCode = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+        TryFinish(handle);
+    }
+
+    static int OnPidfd(int, GIOCondition, void* data)
+    {
+        Handle handle = FromData(data);
+        Child& child = children.at(handle);
+        int status = 0;
+        // The pidfd is readable, once the child exited, so this doesn't block
+        while (waitpid(child.pid, &status, 0) < 0 && errno == EINTR)
+        {
+        }
+        close(child.pidfd);
+        child.pidfd = -1;
+        child.exitSource = 0;
+        OnExited(handle, status);
+        return G_SOURCE_REMOVE;
+    }
+
+    static int OnOutput(int fd, GIOCondition, void* data)
+    {
+        Handle handle = FromData(data);
+        Child& child = children.at(handle);
+        char buf[4096];
+        while (true)
+        {
+            ssize_t len = read(fd, buf, sizeof(buf));
+            if (len > 0)
+            {
+                size_t keep = std::min((size_t)len, maxOutput - child.result.output.size());
+                child.result.output.append(buf, keep);
+                continue;
+            }
+            if (len < 0 && errno == EINTR)
+            {
+                continue;
+            }
+            if (len < 0 && errno == EAGAIN)
+            {
+                return G_SOURCE_CONTINUE;
+            }
+            // EOF or error
+            break;
+        }
+        child.outputSource = 0;
+        close(child.outputFd);
+        child.outputFd = -1;
+        TryFinish(handle);
+        return G_SOURCE_REMOVE;
+    }
+
+    // Kills the command and everything it started. The output may be held open by a grandchild, so stop waiting for it.
+    static void Kill(Child& child)
+    {
+        if (!child.exited)
+        {
+            kill(-child.pid, SIGKILL);
+        }
+        CloseOutput(child);
+    }
+
+    Handle Run(const std::string& command, std::function<void(const Result&)>&& onFinish, const Options& options)
+    {
+        Handle handle = nextHandle++;
+        Child& child = children[handle];
+        child.onFinish = std::move(onFinish);
+
+        int pipeFds[2] = {-1, -1};
+        posix_spawn_file_actions_t actions;
+        posix_spawn_file_actions_init(&actions);
+        if (options.captureOutput)
+        {
+            if (pipe2(pipeFds, O_CLOEXEC) != 0)
+            {
+                LOG("Process: Cannot create pipe: " << strerror(errno));
+                posix_spawn_file_actions_destroy(&actions);
+                child.exited = true;
+                TryFinish(handle);
+                return 0;
+            }
+            // dup2 clears O_CLOEXEC on stdout
+            posix_spawn_file_actions_adddup2(&actions, pipeFds[1], STDOUT_FILENO);
+        }
+
+        posix_spawnattr_t attr;
+        posix_spawnattr_init(&attr);
+        // Don't pass on our signal handling, e.g. an ignored SIGPIPE
+        sigset_t mask;
+        sigemptyset(&mask);
+        posix_spawnattr_setsigmask(&attr, &mask);
+        sigset_t defaults;
+        sigemptyset(&defaults);
+        sigaddset(&defaults, SIGPIPE);
+        sigaddset(&defaults, SIGINT);
+        sigaddset(&defaults, SIGTERM);
+        posix_spawnattr_setsigdefault(&attr, &defaults);
+        // Own process group, so a timeout also kills whatever the shell started
+        posix_spawnattr_setpgroup(&attr, 0);
+        posix_spawnattr_setflags(&attr, POSIX_SPAWN_SETSIGMASK | POSIX_SPAWN_SETSIGDEF | POSIX_SPAWN_SETPGROUP);
+
+        const char* argv[] = {"/bin/sh", "-c", command.c_str(), nullptr};
+        int err = posix_spawn(&child.pid, "/bin/sh", &actions, &attr, (char* const*)argv, environ);
+        posix_spawn_file_actions_destroy(&actions);
+        posix_spawnattr_destroy(&attr);
+        if (pipeFds[1] >= 0)
+        {
+            close(pipeFds[1]);
+        }
+        if (err != 0)
+        {
+            LOG("Process: Cannot run \"" << command << "\": " << strerror(err));
+            if (pipeFds[0] >= 0)
+            {
+                close(pipeFds[0]);
+            }
+            child.exited = true;
+            TryFinish(handle);
+            return 0;
+        }
+
+        if (options.captureOutput)
+        {
+            child.outputFd = pipeFds[0];
+            fcntl(child.outputFd, F_SETFL, fcntl(child.outputFd, F_GETFL) | O_NONBLOCK);
+            child.outputSource = g_unix_fd_add(child.outputFd, (GIOCondition)(G_IO_IN | G_IO_HUP | G_IO_ERR), OnOutput, ToData(handle));
+        }
+
+#ifdef SYS_pidfd_open
+        child.pidfd = (int)syscall(SYS_pidfd_open, child.pid, 0);
+#endif
+        if (child.pidfd >= 0)
+        {
+            child.exitSource = g_unix_fd_add(child.pidfd, G_IO_IN, OnPidfd, ToData(handle));
+        }
+        else
+        {
+            // Kernel < 5.3
+            child.exitSource = g_child_watch_add(
+                child.pid,
+                +[](GPid, int status, void* data)
+                {
+                    Handle handle = FromData(data);
+                    children.at(handle).exitSource = 0;
+                    OnExited(handle, status);
+                },
+                ToData(handle));
+        }
+
+        if (options.timeoutMs)
+        {
+            child.timeoutSource = g_timeout_add(
+                options.timeoutMs,
+                +[](void* data) -> int
+                {
+                    Handle handle = FromData(data);
+                    Child& child = children.at(handle);
+                    LOG("Process: Command timed out, killing it");
+                    child.timeoutSource = 0;
+                    child.result.timedOut = true;
+                    Kill(child);
+                    TryFinish(handle);
+                    return G_SOURCE_REMOVE;
+                },
+                ToData(handle));
+        }
+        return handle;
+    }
+
+    void Cancel(Handle handle)
+    {
+        auto it = children.find(handle);
+        if (it == children.end())
+        {
+            return;
+        }
+        it->second.result.cancelled = true;
+        Kill(it->second);
+        TryFinish(handle);
+    }
+
+    bool IsRunning(Handle handle)
+    {
+        return children.count(handle) != 0;
+    }
+}
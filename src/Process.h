@@ -0,0 +1,41 @@
+#pragma once
+#include <functional>
+#include <string>
+#include <cstdint>
+
+// Runs shell commands without blocking the main loop. Children are started with posix_spawn, watched with a pidfd in the GLib loop
+// and always reaped. Their stdout can be collected through a non-blocking pipe.
+// Only call this from the main thread, the callbacks are invoked from the main loop.
+namespace Process
+{
+    struct Options
+    {
+        // Collect stdout into Result::output. Otherwise it is inherited from gBar.
+        bool captureOutput = false;
+        // Kill the command, if it runs longer than this. 0 never kills it.
+        uint32_t timeoutMs = 0;
+    };
+
+    struct Result
+    {
+        // -1, if it didn't exit normally (killed, couldn't be started)
+        int exitCode = -1;
+        std::string output;
+        bool timedOut = false;
+        bool cancelled = false;
+
+        bool Success() const { return exitCode == 0; }
+    };
+
+    // 0 is never a valid handle
+    using Handle = uint32_t;
+
+    // Runs "/bin/sh -c command" in its own process group. onFinish is called, once it exited and its output is read to the end.
+    // Returns 0, if it couldn't be started. onFinish is called right away then.
+    Handle Run(const std::string& command, std::function<void(const Result&)>&& onFinish = nullptr, const Options& options = {});
+
+    // Kills the whole process group. onFinish is still called, with Result::cancelled set.
+    void Cancel(Handle handle);
+
+    bool IsRunning(Handle handle);
+}
@@ -2,49 +2,47 @@
 #include "System.h"
 #include "Common.h"
 #include "Config.h"
+#include "Process.h"
 
 #include <cmath>
+#include <cstring>
 #include <pulse/pulseaudio.h>
+#include <pulse/glib-mainloop.h>
 #include <stdlib.h>
 #include <algorithm>
-#include <list>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
 
 namespace PulseAudio
 {
 
-    static pa_mainloop* mainLoop;
+    static pa_glib_mainloop* mainLoop;
     static pa_context* context;
-    static std::list<pa_operation*> pendingOperations;
 
     static System::AudioInfo info;
     static bool queueUpdate = false;
     static bool blockUpdate = false;
 
-    inline void FlushLoop()
+    struct VolumeCommand
     {
-        while (pendingOperations.size() > 0)
-        {
-            pa_mainloop_iterate(mainLoop, 0, nullptr);
-            // Remove done or cancelled operations
-            pendingOperations.remove_if(
-                [](pa_operation* op)
-                {
-                    pa_operation_state_t state = pa_operation_get_state(op);
-                    if (state == PA_OPERATION_DONE)
-                    {
-                        pa_operation_unref(op);
-                        return true;
-                    }
-                    else if (state == PA_OPERATION_CANCELLED)
-                    {
-                        LOG("Warning: Cancelled pa_operation!");
-                        pa_operation_unref(op);
-                        return true;
-                    }
-                    return false;
-                });
-        }
-    }
+        Process::Handle running = 0;
+        std::string pending;
+    };
+    static VolumeCommand sinkVolumeCommand;
+    static VolumeCommand sourceVolumeCommand;
+
+    static Utils::CallbackList<const System::AudioInfo&> audioCallbacks;
+
+    static std::unordered_map<uint32_t, System::SinkInput> sinkInputs;
+    // Needed for pa_cvolume_set
+    static std::unordered_map<uint32_t, uint8_t> sinkInputChannels;
+    static Utils::CallbackList<System::ChangeType, const System::SinkInput&> sinkInputCallbacks;
+
+    static std::unordered_map<uint32_t, System::SourceOutput> sourceOutputs;
+    static Utils::CallbackList<System::ChangeType, const System::SourceOutput&> sourceOutputCallbacks;
+    // Recording from these doesn't use the microphone, e.g. level meters of pavucontrol
+    static std::unordered_set<uint32_t> monitorSources;
 
     inline double PAVolumeToDouble(const pa_cvolume* volume)
     {
@@ -81,87 +79,291 @@ namespace PulseAudio
     inline void UpdateInfo()
     {
         LOG("PulseAudio: Update info");
-        struct ServerInfo
-        {
-            const char* defaultSink = nullptr;
-            const char* defaultSource = nullptr;
-        } serverInfo;
-
         // 1. Get default sink
-        auto getServerInfo = [](pa_context*, const pa_server_info* paInfo, void* out)
+        auto getServerInfo = [](pa_context*, const pa_server_info* paInfo, void*)
         {
             if (!paInfo)
                 return;
 
-            ServerInfo* serverInfo = (ServerInfo*)out;
-            serverInfo->defaultSink = paInfo->default_sink_name;
-            serverInfo->defaultSource = paInfo->default_source_name;
-
-            auto sinkInfo = [](pa_context*, const pa_sink_info* paInfo, int, void* audioInfo)
+            auto sinkInfo = [](pa_context*, const pa_sink_info* paInfo, int, void*)
             {
                 if (!paInfo)
                     return;
 
-                System::AudioInfo* out = (System::AudioInfo*)audioInfo;
-
                 double vol = PAVolumeToDoubleWithMinMax(&paInfo->volume);
-                out->sinkVolume = vol;
-                out->sinkMuted = paInfo->mute;
+                if (info.sinkVolume != vol || info.sinkMuted != (bool)paInfo->mute)
+                {
+                    info.sinkVolume = vol;
+                    info.sinkMuted = paInfo->mute;
+                    audioCallbacks.Invoke(info);
+                }
             };
-            if (serverInfo->defaultSink)
+            if (paInfo->default_sink_name)
             {
-                pa_operation* op = pa_context_get_sink_info_by_name(context, serverInfo->defaultSink, +sinkInfo, &info);
-                pa_operation_ref(op);
-                pendingOperations.push_back(op);
+                pa_operation* op = pa_context_get_sink_info_by_name(context, paInfo->default_sink_name, +sinkInfo, nullptr);
+                pa_operation_unref(op);
             }
 
-            auto sourceInfo = [](pa_context*, const pa_source_info* paInfo, int, void* audioInfo)
+            auto sourceInfo = [](pa_context*, const pa_source_info* paInfo, int, void*)
             {
                 if (!paInfo)
                     return;
 
-                System::AudioInfo* out = (System::AudioInfo*)audioInfo;
-
                 double vol = PAVolumeToDouble(&paInfo->volume);
-                out->sourceVolume = vol;
-                out->sourceMuted = paInfo->mute;
+                if (info.sourceVolume != vol || info.sourceMuted != (bool)paInfo->mute)
+                {
+                    info.sourceVolume = vol;
+                    info.sourceMuted = paInfo->mute;
+                    audioCallbacks.Invoke(info);
+                }
             };
-            if (serverInfo->defaultSource)
+            if (paInfo->default_source_name)
             {
-                pa_operation* op = pa_context_get_source_info_by_name(context, serverInfo->defaultSource, +sourceInfo, &info);
-                pa_operation_ref(op);
-                pendingOperations.push_back(op);
+                pa_operation* op = pa_context_get_source_info_by_name(context, paInfo->default_source_name, +sourceInfo, nullptr);
+                pa_operation_unref(op);
             }
         };
 
-        pa_operation* op = pa_context_get_server_info(context, +getServerInfo, &serverInfo);
-        pa_operation_ref(op);
-        pendingOperations.push_back(op);
-        FlushLoop();
+        // The callbacks are dispatched from the GLib main loop, no need to wait for them.
+        pa_operation* op = pa_context_get_server_info(context, +getServerInfo, nullptr);
+        pa_operation_unref(op);
     }
 
-    inline System::AudioInfo GetInfo()
+    inline void OnSinkInputInfo(pa_context*, const pa_sink_input_info* paInfo, int eol, void*)
+    {
+        if (eol || !paInfo)
+            return;
+
+        System::SinkInput input{};
+        input.index = paInfo->index;
+        const char* appName = pa_proplist_gets(paInfo->proplist, PA_PROP_APPLICATION_NAME);
+        input.description = paInfo->name ? paInfo->name : "";
+        input.name = appName ? appName : input.description;
+        input.volume = PAVolumeToDouble(&paInfo->volume);
+        input.muted = paInfo->mute;
+
+        sinkInputChannels[paInfo->index] = paInfo->volume.channels;
+        auto [it, added] = sinkInputs.insert_or_assign(paInfo->index, std::move(input));
+        sinkInputCallbacks.Invoke(added ? System::ChangeType::Added : System::ChangeType::Changed, it->second);
+    }
+
+    inline void OnSinkInputRemoved(uint32_t index)
+    {
+        auto it = sinkInputs.find(index);
+        if (it == sinkInputs.end())
+            return;
+
+        System::SinkInput removed = std::move(it->second);
+        sinkInputs.erase(it);
+        sinkInputChannels.erase(index);
+        sinkInputCallbacks.Invoke(System::ChangeType::Removed, removed);
+    }
+
+    inline void OnSourceInfo(pa_context*, const pa_source_info* paInfo, int eol, void*)
+    {
+        if (eol || !paInfo)
+            return;
+
+        if (paInfo->monitor_of_sink != PA_INVALID_INDEX)
+            monitorSources.insert(paInfo->index);
+        else
+            monitorSources.erase(paInfo->index);
+    }
+
+    inline void OnSourceOutputRemoved(uint32_t index);
+
+    // Peak meters and streams from monitor sources don't record the microphone
+    inline bool IsMeterStream(const pa_source_output_info* paInfo)
+    {
+        if (monitorSources.count(paInfo->source))
+            return true;
+        // Streams with PA_STREAM_PEAK_DETECT are resampled by the "peaks" resampler
+        if (paInfo->resample_method && strcmp(paInfo->resample_method, "peaks") == 0)
+            return true;
+        const char* role = pa_proplist_gets(paInfo->proplist, PA_PROP_MEDIA_ROLE);
+        return role && strcmp(role, "peak") == 0;
+    }
+
+    inline void OnSourceOutputInfo(pa_context*, const pa_source_output_info* paInfo, int eol, void*)
     {
-        pa_mainloop_iterate(mainLoop, 0, nullptr);
-        if (queueUpdate && !blockUpdate)
+        if (eol || !paInfo)
+            return;
+
+        if (IsMeterStream(paInfo))
         {
-            UpdateInfo();
+            // May have been moved to a monitor source
+            OnSourceOutputRemoved(paInfo->index);
+            return;
         }
-        queueUpdate = false;
-        blockUpdate = false;
+
+        System::SourceOutput output{};
+        output.index = paInfo->index;
+        const char* appName = pa_proplist_gets(paInfo->proplist, PA_PROP_APPLICATION_NAME);
+        output.name = appName ? appName : (paInfo->name ? paInfo->name : "");
+        output.recording = !paInfo->corked;
+
+        auto [it, added] = sourceOutputs.insert_or_assign(paInfo->index, std::move(output));
+        sourceOutputCallbacks.Invoke(added ? System::ChangeType::Added : System::ChangeType::Changed, it->second);
+    }
+
+    inline void OnSourceOutputRemoved(uint32_t index)
+    {
+        auto it = sourceOutputs.find(index);
+        if (it == sourceOutputs.end())
+            return;
+
+        System::SourceOutput removed = std::move(it->second);
+        sourceOutputs.erase(it);
+        sourceOutputCallbacks.Invoke(System::ChangeType::Removed, removed);
+    }
+
+    inline System::AudioInfo GetInfo()
+    {
+        // Kept up-to-date by the subscription
         return info;
     }
 
+    inline uint32_t AddAudioCallback(std::function<void(const System::AudioInfo&)>&& callback)
+    {
+        return audioCallbacks.Add(std::move(callback));
+    }
+
+    inline void RemoveAudioCallback(uint32_t handle)
+    {
+        audioCallbacks.Remove(handle);
+    }
+
+    inline const std::unordered_map<uint32_t, System::SinkInput>& GetSinkInputs()
+    {
+        return sinkInputs;
+    }
+
+    inline uint32_t AddSinkInputCallback(std::function<void(System::ChangeType, const System::SinkInput&)>&& callback)
+    {
+        return sinkInputCallbacks.Add(std::move(callback));
+    }
+
+    inline void RemoveSinkInputCallback(uint32_t handle)
+    {
+        sinkInputCallbacks.Remove(handle);
+    }
+
+    inline const std::unordered_map<uint32_t, System::SourceOutput>& GetSourceOutputs()
+    {
+        return sourceOutputs;
+    }
+
+    inline uint32_t AddSourceOutputCallback(std::function<void(System::ChangeType, const System::SourceOutput&)>&& callback)
+    {
+        return sourceOutputCallbacks.Add(std::move(callback));
+    }
+
+    inline void RemoveSourceOutputCallback(uint32_t handle)
+    {
+        sourceOutputCallbacks.Remove(handle);
+    }
+
+    inline void OnContextReady()
+    {
+        auto subscribeCallback = [](pa_context*, pa_subscription_event_type_t type, uint32_t index, void*)
+        {
+            uint32_t facility = type & PA_SUBSCRIPTION_EVENT_FACILITY_MASK;
+            uint32_t eventType = type & PA_SUBSCRIPTION_EVENT_TYPE_MASK;
+            switch (facility)
+            {
+            case PA_SUBSCRIPTION_EVENT_SOURCE:
+                if (eventType == PA_SUBSCRIPTION_EVENT_REMOVE)
+                {
+                    monitorSources.erase(index);
+                }
+                else
+                {
+                    pa_operation* op = pa_context_get_source_info_by_index(context, index, OnSourceInfo, nullptr);
+                    pa_operation_unref(op);
+                }
+                [[fallthrough]];
+            case PA_SUBSCRIPTION_EVENT_SINK:
+            case PA_SUBSCRIPTION_EVENT_SERVER:
+                if (!queueUpdate)
+                {
+                    // Batch bursts of events (e.g. dragging a slider) into one update
+                    queueUpdate = true;
+                    g_idle_add(
+                        +[](void*) -> int
+                        {
+                            // A running pamixer would only echo the values we just set
+                            bool settingVolume = Process::IsRunning(sinkVolumeCommand.running) || Process::IsRunning(sourceVolumeCommand.running);
+                            if (!blockUpdate && !settingVolume)
+                            {
+                                UpdateInfo();
+                            }
+                            queueUpdate = false;
+                            blockUpdate = false;
+                            return false;
+                        },
+                        nullptr);
+                }
+                break;
+            case PA_SUBSCRIPTION_EVENT_SINK_INPUT:
+                if (eventType == PA_SUBSCRIPTION_EVENT_REMOVE)
+                {
+                    OnSinkInputRemoved(index);
+                }
+                else
+                {
+                    // Only fetch the stream, that changed
+                    pa_operation* op = pa_context_get_sink_input_info(context, index, OnSinkInputInfo, nullptr);
+                    pa_operation_unref(op);
+                }
+                break;
+            case PA_SUBSCRIPTION_EVENT_SOURCE_OUTPUT:
+                if (eventType == PA_SUBSCRIPTION_EVENT_REMOVE)
+                {
+                    OnSourceOutputRemoved(index);
+                }
+                else
+                {
+                    pa_operation* op = pa_context_get_source_output_info(context, index, OnSourceOutputInfo, nullptr);
+                    pa_operation_unref(op);
+                }
+                break;
+            default: break;
+            }
+        };
+        pa_context_set_subscribe_callback(context, +subscribeCallback, nullptr);
+
+        // Subscribe to source and sink changes
+        auto subscribeSuccess = [](pa_context*, int success, void*)
+        {
+            ASSERT(success >= 0, "Failed to subscribe to pulseaudio");
+        };
+        auto mask = PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SOURCE | PA_SUBSCRIPTION_MASK_SERVER | PA_SUBSCRIPTION_MASK_SINK_INPUT |
+                    PA_SUBSCRIPTION_MASK_SOURCE_OUTPUT;
+        pa_operation* op = pa_context_subscribe(context, (pa_subscription_mask_t)mask, +subscribeSuccess, nullptr);
+        pa_operation_unref(op);
+
+        // Initialise info
+        UpdateInfo();
+
+        // Initial list of streams, from now on only the subscription updates them.
+        // Replies arrive in order, so the monitor sources are known before the source outputs.
+        op = pa_context_get_source_info_list(context, OnSourceInfo, nullptr);
+        pa_operation_unref(op);
+        op = pa_context_get_sink_input_info_list(context, OnSinkInputInfo, nullptr);
+        pa_operation_unref(op);
+        op = pa_context_get_source_output_info_list(context, OnSourceOutputInfo, nullptr);
+        pa_operation_unref(op);
+    }
+
     inline void Init()
     {
-        mainLoop = pa_mainloop_new();
-        pa_mainloop_api* api = pa_mainloop_get_api(mainLoop);
+        // Dispatch from the GLib main loop, so events arrive without us polling the server.
+        mainLoop = pa_glib_mainloop_new(nullptr);
+        pa_mainloop_api* api = pa_glib_mainloop_get_api(mainLoop);
 
         context = pa_context_new(api, "gBar PA context");
-        int res = pa_context_connect(context, nullptr, PA_CONTEXT_NOAUTOSPAWN, nullptr);
-
-        bool ready = false;
-        auto stateCallback = [](pa_context* c, void* ready)
+        // Connect asynchronously, everything else is set up once the context is ready
+        auto stateCallback = [](pa_context* c, void*)
         {
             switch (pa_context_get_state(c))
             {
@@ -175,39 +377,33 @@ namespace PulseAudio
                 break;
             case PA_CONTEXT_READY:
                 LOG("PulseAudio: Context is ready!");
-                *(bool*)ready = true;
+                OnContextReady();
                 break;
             }
         };
-        pa_context_set_state_callback(context, +stateCallback, &ready);
-
-        while (!ready)
-        {
-            pa_mainloop_iterate(mainLoop, 0, nullptr);
-        }
+        pa_context_set_state_callback(context, +stateCallback, nullptr);
 
-        // Subscribe to source and sink changes
-        auto subscribeSuccess = [](pa_context*, int success, void*)
-        {
-            ASSERT(success >= 0, "Failed to subscribe to pulseaudio");
-        };
-        pa_operation* op = pa_context_subscribe(context, (pa_subscription_mask_t)(PA_SUBSCRIPTION_MASK_SINK | PA_SUBSCRIPTION_MASK_SOURCE),
-                                                +subscribeSuccess, nullptr);
-        pa_operation_ref(op);
-        pendingOperations.push_back(op);
-        FlushLoop();
+        int res = pa_context_connect(context, nullptr, PA_CONTEXT_NOAUTOSPAWN, nullptr);
+        ASSERT(res >= 0, "pa_context_connect failed!");
+    }
 
-        auto subscribeCallback = [](pa_context*, pa_subscription_event_type_t type, uint32_t, void*)
+    // Only one pamixer per target at a time, so they can't overtake each other. While a slider is dragged, only the latest value is applied.
+    inline void RunVolumeCommand(VolumeCommand& command, std::string&& cmd)
+    {
+        if (Process::IsRunning(command.running))
         {
-            if (type == PA_SUBSCRIPTION_EVENT_CHANGE)
-                queueUpdate = true;
-        };
-        pa_context_set_subscribe_callback(context, +subscribeCallback, nullptr);
-
-        // Initialise info
-        UpdateInfo();
-
-        ASSERT(res >= 0, "pa_context_connect failed!");
+            command.pending = std::move(cmd);
+            return;
+        }
+        command.running = Process::Run(cmd,
+                                       [&command](const Process::Result&)
+                                       {
+                                           command.running = 0;
+                                           if (!command.pending.empty())
+                                           {
+                                               RunVolumeCommand(command, std::exchange(command.pending, {}));
+                                           }
+                                       });
     }
 
     inline void SetVolumeSink(double value)
@@ -219,7 +415,7 @@ namespace PulseAudio
         std::string cmd = "pamixer --allow-boost --set-volume " + std::to_string((uint32_t)(valClamped * 100));
         info.sinkVolume = std::clamp(value, 0., 1.); // We need to stay in 0/1 range
         blockUpdate = true;
-        system(cmd.c_str());
+        RunVolumeCommand(sinkVolumeCommand, std::move(cmd));
     }
 
     inline void SetVolumeSource(double value)
@@ -231,11 +427,34 @@ namespace PulseAudio
         std::string cmd = "pamixer --default-source --set-volume " + std::to_string((uint32_t)(valClamped * 100));
         info.sourceVolume = valClamped;
         blockUpdate = true;
-        system(cmd.c_str());
+        RunVolumeCommand(sourceVolumeCommand, std::move(cmd));
+    }
+
+    inline void SetSinkInputVolume(uint32_t index, double value)
+    {
+        auto channels = sinkInputChannels.find(index);
+        if (channels == sinkInputChannels.end())
+        {
+            LOG("Audio: Set volume of unknown sink input " << index);
+            return;
+        }
+        double valClamped = std::clamp(value, 0., 1.);
+        LOG("Audio: Set volume of sink input " << index << ": " << valClamped);
+
+        pa_cvolume volume;
+        pa_cvolume_set(&volume, channels->second, (pa_volume_t)(valClamped * PA_VOLUME_NORM));
+        pa_operation* op = pa_context_set_sink_input_volume(context, index, &volume, nullptr, nullptr);
+        pa_operation_unref(op);
+
+        sinkInputs[index].volume = valClamped;
     }
 
     inline void Shutdown()
     {
-        pa_mainloop_free(mainLoop);
+        // Disconnecting terminates the context right away, which the state callback would treat as an error
+        pa_context_set_state_callback(context, nullptr, nullptr);
+        pa_context_disconnect(context);
+        pa_context_unref(context);
+        pa_glib_mainloop_free(mainLoop);
     }
 }
@@ -3,6 +3,8 @@
 #include "Widget.h"
 #include "Config.h"
 #include "Common.h"
+#include "IconIndex.h"
+#include "Pixmap.h"
 
 #ifdef WITH_SNI
 
@@ -10,13 +12,13 @@
 #include <sni-item.h>
 #include <gio/gio.h>
 #include <libdbusmenu-gtk/menu.h>
+#include <libdbusmenu-glib/client.h>
 
 #define STB_IMAGE_IMPLEMENTATION
 #include <stb/stb_image.h>
 
 #include <fstream>
 #include <cstdio>
-#include <unordered_set>
 
 namespace SNI
 {
@@ -26,151 +28,225 @@ namespace SNI
 
     guint hostID;
 
+    // Properties, that are refetched together on a New* signal
+    enum PropertyGroup
+    {
+        GroupIcon,
+        GroupToolTip,
+        GroupMenu,
+        NumGroups
+    };
+    static const std::vector<const char*> groupProperties[NumGroups] = {
+        {"IconPixmap", "IconName", "IconThemePath"},
+        {"ToolTip"},
+        {"Menu"},
+    };
+
     struct Item
     {
         std::string name;
         std::string object;
         size_t w = 0;
         size_t h = 0;
-        uint8_t* iconData = nullptr;
+        std::vector<uint8_t> iconData;
 
         std::string tooltip = "";
 
         std::string menuObjectPath = "";
 
+        // Passive items are hidden, like most trays do
+        std::string status = "";
+
+        // Set while the item is shown
         EventBox* gtkEvent = nullptr;
+        Texture* texture = nullptr;
+
+        // Kept for the lifetime of the item. The dbusmenu client fetches the layout in the background and follows LayoutUpdated.
+        GtkMenu* menu = nullptr;
 
         int watcherID = -1;
+        guint signalID = 0;
+        // Cancels the property fetches, once the item is removed
+        GCancellable* cancellable = nullptr;
+        // PropertyGroup bits, that changed since the last flush
+        uint32_t dirtyGroups = 0;
+        // Bumped on every fetch, so replies to an older fetch of the group are dropped
+        uint32_t generation[NumGroups] = {};
     };
-    std::vector<Item> items;
+    // Pointers to the items are handed to gtk, so they need to be stable
+    std::vector<std::unique_ptr<Item>> items;
 
     std::unordered_map<std::string, Item> clientsToQuery;
-    std::unordered_set<std::string> reloadedNames;
+
+    // GetAll requests in flight, by bus name
+    struct PendingLoad
+    {
+        std::string name;
+        std::string object;
+        GCancellable* cancellable = nullptr;
+    };
+    std::unordered_map<std::string, PendingLoad*> pendingLoads;
+    // A hung item shouldn't keep its slot in the tray forever
+    static constexpr int loadTimeout = 5000;
 
     // Gtk stuff, TODO: Allow more than one instance
     // Simply removing the gtk_drawing_areas doesn't trigger proper redrawing
     //   HACK: Make an outer permanent and an inner box, which will be deleted and readded
-    Widget* parentBox;
-    Widget* iconBox;
+    Widget* parentBox = nullptr;
+    Widget* iconBox = nullptr;
+    // Registrations and property changes are handled together, once per frame
+    static guint flushSource = 0;
 
-    static Item CreateItem(std::string&& name, std::string&& object)
+    // Configured by SNIIconSize
+    static int GetIconSize(const Item& item)
     {
-        Item item{};
-        item.name = name;
-        item.object = object;
-        auto getProperty = [&](const char* prop) -> GVariant*
+        bool wasExplicitOverride = false;
+        int size = 24;
+        for (auto& [filter, iconSize] : Config::Get().sniIconSizes)
         {
-            GError* err = nullptr;
-            GVariant* params[2];
-            params[0] = g_variant_new_string("org.kde.StatusNotifierItem");
-            params[1] = g_variant_new_string(prop);
-            GVariant* param = g_variant_new_tuple(params, 2);
-            GVariant* res = g_dbus_connection_call_sync(dbusConnection, name.c_str(), object.c_str(), "org.freedesktop.DBus.Properties", "Get", param,
-                                                        G_VARIANT_TYPE("(v)"), G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &err);
-            if (err)
+            if (item.tooltip.find(filter) != std::string::npos)
             {
-                g_error_free(err);
-                return nullptr;
+                wasExplicitOverride = true;
+                size = iconSize;
             }
-            // There's probably a better method than to use 3 variants
-            // g_variant_unref(params[0]);
-            // g_variant_unref(params[1]);
-            // g_variant_unref(param);
-            return res;
-        };
-        GVariant* iconPixmap = getProperty("IconPixmap");
-        if (iconPixmap)
+            else if (filter == "*" && !wasExplicitOverride)
+            {
+                size = iconSize;
+            }
+        }
+        return size;
+    }
+
+    // Decodes the pixmap of a(iiay) closest to size. Returns false, if there is no usable one.
+    static bool LoadIconPixmap(Item& item, GVariant* pixmaps, int size)
+    {
+        GVariant* bestData = nullptr;
+        int bestWidth = 0;
+        int bestHeight = 0;
+        size_t numPixmaps = g_variant_n_children(pixmaps);
+        for (size_t i = 0; i < numPixmaps; i++)
         {
-            // Only get first item
-            GVariant* arr = nullptr;
-            g_variant_get(iconPixmap, "(v)", &arr);
+            int width = 0;
+            int height = 0;
+            GVariant* data = nullptr;
+            g_variant_get_child(pixmaps, i, "(ii@ay)", &width, &height, &data);
+
+            gsize length = 0;
+            g_variant_get_fixed_array(data, &length, 1);
+            if (width <= 0 || height <= 0 || length < (size_t)width * height * 4)
+            {
+                LOG("SNI: Ignoring invalid " << width << "x" << height << " pixmap of " << item.name);
+                g_variant_unref(data);
+                continue;
+            }
+
+            // Prefer scaling down over scaling up
+            int distance = std::abs(std::max(width, height) - size);
+            int bestDistance = std::abs(std::max(bestWidth, bestHeight) - size);
+            if (!bestData || distance < bestDistance || (distance == bestDistance && std::max(width, height) > std::max(bestWidth, bestHeight)))
+            {
+                if (bestData)
+                {
+                    g_variant_unref(bestData);
+                }
+                bestData = data;
+                bestWidth = width;
+                bestHeight = height;
+            }
+            else
+            {
+                g_variant_unref(data);
+            }
+        }
+        if (!bestData)
+        {
+            return false;
+        }
 
-            GVariantIter* arrIter = nullptr;
-            g_variant_get(arr, "a(iiay)", &arrIter);
+        LOG("SNI: Using " << bestWidth << "x" << bestHeight << " pixmap of " << numPixmaps);
+        gsize length = 0;
+        // Points into the reply, no copy
+        const uint8_t* argb = (const uint8_t*)g_variant_get_fixed_array(bestData, &length, 1);
+        item.w = bestWidth;
+        item.h = bestHeight;
+        item.iconData.resize(item.w * item.h * 4);
+        Pixmap::ArgbToRgba(argb, item.iconData.data(), item.w * item.h);
+        g_variant_unref(bestData);
+        return true;
+    }
 
-            int width;
-            int height;
-            GVariantIter* data = nullptr;
-            g_variant_iter_next(arrIter, "(iiay)", &width, &height, &data);
+    // The Parse* functions take an a{sv} of properties (e.g. the reply to Properties.GetAll), missing properties are skipped.
+    static GVariant* GetProperty(GVariant* props, const char* prop, const GVariantType* type = nullptr)
+    {
+        // Already unboxed from the v
+        return g_variant_lookup_value(props, prop, type);
+    }
 
-            LOG("SNI: Width: " << width);
-            LOG("SNI: Height: " << height);
-            item.w = width;
-            item.h = height;
-            item.iconData = new uint8_t[width * height * 4];
+    static void ParseToolTip(Item& item, GVariant* props)
+    {
+        // Steam e.g. doesn't have one
+        GVariant* tooltipVar = GetProperty(props, "ToolTip");
+        if (tooltipVar)
+        {
+            const gchar* title = nullptr;
+            if (g_variant_is_container(tooltipVar) && g_variant_n_children(tooltipVar) >= 4)
+            {
+                // According to spec, ToolTip is of type (sa(iiab)ss) => 4 children
+                // Most icons only set the "title" component (e.g. Discord, KeePassXC, ...)
+                g_variant_get_child(tooltipVar, 2, "&s", &title);
+            }
+            else
+            {
+                // TeamViewer only exposes a string, which is not according to spec!
+                title = g_variant_get_string(tooltipVar, nullptr);
+            }
 
-            uint8_t px = 0;
-            int i = 0;
-            while (g_variant_iter_next(data, "y", &px))
+            if (title != nullptr)
             {
-                item.iconData[i] = px;
-                i++;
+                item.tooltip = title;
             }
-            for (int i = 0; i < width * height; i++)
+            else
             {
-                struct Px
-                {
-                    // This should be bgra...
-                    // Since source is ARGB32 in network order(=big-endian)
-                    // and x86 Linux is little-endian, we *should* swap b and r...
-                    uint8_t a, r, g, b;
-                };
-                Px& pixel = ((Px*)item.iconData)[i];
-                // Swap to create rgba
-                pixel = {pixel.r, pixel.g, pixel.b, pixel.a};
+                LOG("SNI: Error querying tooltip");
             }
+            LOG("SNI: Title: " << item.tooltip);
+            g_variant_unref(tooltipVar);
+        }
+    }
+
+    static void ParseIcon(Item& item, GVariant* props)
+    {
+        item.w = 0;
+        item.h = 0;
+        item.iconData.clear();
 
-            g_variant_iter_free(data);
-            g_variant_iter_free(arrIter);
-            g_variant_unref(arr);
+        // Typed, since it is indexed below
+        GVariant* iconPixmap = g_variant_lookup_value(props, "IconPixmap", G_VARIANT_TYPE("a(iiay)"));
+        bool hasPixmap = false;
+        if (iconPixmap)
+        {
+            // GetAll also returns unset pixmaps, fall back to the icon name then
+            hasPixmap = LoadIconPixmap(item, iconPixmap, GetIconSize(item));
             g_variant_unref(iconPixmap);
         }
-        else
+        if (!hasPixmap)
         {
-            auto findIconWithoutPath = [](const char* iconName) -> std::string
+            auto findIconWithoutPath = [&item](const char* iconName) -> std::string
             {
-                std::string iconPath;
-                const char* dataDirs = getenv("XDG_DATA_DIRS");
-                // Nothing defined, look in $XDG_DATA_DIRS/icons
+                // Nothing defined, look in $XDG_DATA_DIRS/icons and /usr/share/icons
                 // network-manager-applet does this e.g.
-                if (dataDirs)
-                {
-                    for (auto& dataDir : Utils::Split(dataDirs, ':'))
-                    {
-                        LOG("SNI: Searching icon " << iconName << " in " << dataDir << "/icons");
-                        std::string path = Utils::FindFileWithName(dataDir + "/icons", iconName, ".png");
-                        if (path != "")
-                        {
-                            iconPath = path;
-                            break;
-                        }
-                    }
-                }
-                if (iconPath == "")
-                {
-                    // Fallback to /usr/share/icons
-                    LOG("SNI: Searching icon " << iconName << " in "
-                                               << "/usr/share/icons");
-                    iconPath = Utils::FindFileWithName("/usr/share/icons", iconName, ".png");
-                }
-                return iconPath;
+                return IconIndex::Find(iconName, GetIconSize(item));
             };
 
             // Get icon theme path
-            GVariant* themePathVariant = getProperty("IconThemePath"); // Not defined by freedesktop, I think ayatana does this...
-            GVariant* iconNameVariant = getProperty("IconName");
+            GVariant* themePathVariant = GetProperty(props, "IconThemePath", G_VARIANT_TYPE_STRING); // Not defined by freedesktop, I think ayatana does this...
+            GVariant* iconNameVariant = GetProperty(props, "IconName", G_VARIANT_TYPE_STRING);
 
             std::string iconPath;
             if (themePathVariant && iconNameVariant)
             {
-                // Why GLib?
-                GVariant* themePathStr = nullptr;
-                g_variant_get(themePathVariant, "(v)", &themePathStr);
-                GVariant* iconNameStr = nullptr;
-                g_variant_get(iconNameVariant, "(v)", &iconNameStr);
-
-                const char* themePath = g_variant_get_string(themePathStr, nullptr);
-                const char* iconName = g_variant_get_string(iconNameStr, nullptr);
+                const char* themePath = g_variant_get_string(themePathVariant, nullptr);
+                const char* iconName = g_variant_get_string(iconNameVariant, nullptr);
                 if (strlen(themePath) == 0)
                 {
                     iconPath = findIconWithoutPath(iconName);
@@ -181,16 +257,11 @@ namespace SNI
                 }
 
                 g_variant_unref(themePathVariant);
-                g_variant_unref(themePathStr);
                 g_variant_unref(iconNameVariant);
-                g_variant_unref(iconNameStr);
             }
             else if (iconNameVariant)
             {
-                GVariant* iconNameStr = nullptr;
-                g_variant_get(iconNameVariant, "(v)", &iconNameStr);
-
-                const char* iconName = g_variant_get_string(iconNameStr, nullptr);
+                const char* iconName = g_variant_get_string(iconNameVariant, nullptr);
                 iconPath = findIconWithoutPath(iconName);
                 if (iconPath == "")
                 {
@@ -199,18 +270,21 @@ namespace SNI
                 }
 
                 g_variant_unref(iconNameVariant);
-                g_variant_unref(iconNameStr);
             }
             else
             {
+                if (themePathVariant)
+                {
+                    g_variant_unref(themePathVariant);
+                }
                 LOG("SNI: Unknown path!");
-                return item;
+                return;
             }
 
             if (iconPath == "")
             {
-                LOG("SNI: Cannot find icon path for " << name);
-                return item;
+                LOG("SNI: Cannot find icon path for " << item.name);
+                return;
             }
 
             int width, height, channels;
@@ -218,183 +292,425 @@ namespace SNI
             if (!pixels)
             {
                 LOG("SNI: Cannot open " << iconPath);
-                return item;
+                return;
             }
             item.w = width;
             item.h = height;
-            item.iconData = new uint8_t[width * height * 4];
             // Already rgba32
-            memcpy(item.iconData, pixels, width * height * 4);
+            item.iconData.assign(pixels, pixels + width * height * 4);
             stbi_image_free(pixels);
         }
+    }
 
-        // Query tooltip(Steam e.g. doesn't have one)
-        GVariant* tooltip = getProperty("ToolTip");
-        if (tooltip)
-        {
-            GVariant* tooltipVar;
-            g_variant_get_child(tooltip, 0, "v", &tooltipVar);
-            const gchar* title = nullptr;
-            if (g_variant_is_container(tooltipVar) && g_variant_n_children(tooltipVar) >= 4)
-            {
-                // According to spec, ToolTip is of type (sa(iiab)ss) => 4 children
-                // Most icons only set the "title" component (e.g. Discord, KeePassXC, ...)
-                g_variant_get_child(tooltipVar, 2, "s", &title);
-            }
-            else
-            {
-                // TeamViewer only exposes a string, which is not according to spec!
-                title = g_variant_get_string(tooltipVar, nullptr);
-            }
-
-            if (title != nullptr)
-            {
-                item.tooltip = title;
-            }
-            else
-            {
-                LOG("SNI: Error querying tooltip");
-            }
-            LOG("SNI: Title: " << item.tooltip);
-            g_variant_unref(tooltip);
-            g_variant_unref(tooltipVar);
-        }
-
-        // Query menu
-        GVariant* menuPath = getProperty("Menu");
-        if (menuPath)
+    static void ParseMenu(Item& item, GVariant* props)
+    {
+        GVariant* menuVariant = GetProperty(props, "Menu", G_VARIANT_TYPE_OBJECT_PATH);
+        if (menuVariant)
         {
-            GVariant* menuVariant;
-            g_variant_get_child(menuPath, 0, "v", &menuVariant);
             const char* objectPath;
-            g_variant_get(menuVariant, "o", &objectPath);
+            g_variant_get(menuVariant, "&o", &objectPath);
             LOG("SNI: Menu object path: " << objectPath);
 
             item.menuObjectPath = objectPath;
 
             g_variant_unref(menuVariant);
-            g_variant_unref(menuPath);
         }
+    }
 
-        return item;
+    static void ParseStatus(Item& item, GVariant* props)
+    {
+        GVariant* statusVariant = GetProperty(props, "Status", G_VARIANT_TYPE_STRING);
+        if (statusVariant)
+        {
+            item.status = g_variant_get_string(statusVariant, nullptr);
+            g_variant_unref(statusVariant);
+        }
     }
 
-    static void InvalidateWidget();
+    static void ParseItemProperties(Item& item, GVariant* props)
+    {
+        // First, since the icon size is configured by it
+        ParseToolTip(item, props);
+        ParseIcon(item, props);
+        ParseMenu(item, props);
+        ParseStatus(item, props);
+    }
 
-    static void DBusNameVanished(GDBusConnection*, const char* name, void*)
+    static bool IsShown(const Item& item)
+    {
+        return !item.iconData.empty() && item.status != "Passive";
+    }
+
+    static Item* FindItem(const std::string& name)
     {
         auto it = std::find_if(items.begin(), items.end(),
-                               [&](const Item& item)
+                               [&](const std::unique_ptr<Item>& item)
                                {
-                                   return item.name == name;
+                                   return item->name == name;
                                });
-        if (it != items.end())
+        return it != items.end() ? it->get() : nullptr;
+    }
+
+    static void InvalidateWidget();
+    static void LoadItem(const std::string& name, const std::string& object);
+
+    static void CancelLoad(const std::string& name)
+    {
+        auto it = pendingLoads.find(name);
+        if (it != pendingLoads.end())
         {
-            LOG("SNI: " << name << " vanished!");
-            g_bus_unwatch_name(it->watcherID);
-            items.erase(it);
-            InvalidateWidget();
-            return;
+            // The reply callback frees the request
+            g_cancellable_cancel(it->second->cancellable);
+            pendingLoads.erase(it);
         }
+    }
 
-        auto toRegisterIt = clientsToQuery.find(name);
-        if (toRegisterIt != clientsToQuery.end())
+    // The menu outlives the tray widgets, so it has to be detached before they are destroyed
+    static void DetachMenu(Item& item)
+    {
+        if (item.menu && gtk_menu_get_attach_widget(item.menu))
         {
-            clientsToQuery.erase(toRegisterIt);
+            gtk_menu_popdown(item.menu);
+            gtk_menu_detach(item.menu);
         }
+    }
 
-        LOG("SNI: Cannot remove unregistered bus name " << name);
-        return;
+    static void DestroyMenu(Item& item)
+    {
+        if (item.menu)
+        {
+            DetachMenu(item);
+            gtk_widget_destroy((GtkWidget*)item.menu);
+            g_object_unref(item.menu);
+            item.menu = nullptr;
+        }
     }
 
-    static void ItemPropertyChanged(GDBusConnection*, const char* senderName, const char* object, const char*, const char*, GVariant*, void* name)
+    // (Re)creates the menu for menuObjectPath, which starts fetching its layout right away
+    static void CreateMenu(Item& item)
     {
-        if (reloadedNames.insert(senderName).second == false)
+        DestroyMenu(item);
+        if (item.menuObjectPath.empty())
         {
-            // senderName has already requested a change, ignore
-            LOG("SNI: " << senderName << " already signaled property change");
             return;
         }
+        item.menu = (GtkMenu*)dbusmenu_gtkmenu_new(item.name.data(), item.menuObjectPath.data());
+        g_object_ref_sink(item.menu);
+    }
 
-        std::string nameStr = (const char*)name;
-        LOG("SNI: Reloading " << (const char*)name << " " << object << " (Sender: " << senderName << ")");
-        // We don't care about *what* changed, just remove and reload
+    static void RemoveItem(const std::string& name)
+    {
         auto it = std::find_if(items.begin(), items.end(),
-                               [&](const Item& item)
+                               [&](const std::unique_ptr<Item>& item)
                                {
-                                   return item.name == nameStr;
+                                   return item->name == name;
                                });
-        // We can't trust the object path given to us, since ItemPropertyChanged is called multiple times with the same name, but with different
-        // object paths.
-        std::string itemObjectPath = it->object;
-        LOG("SNI: Actual object path: " << itemObjectPath)
-        if (it != items.end())
+        if (it == items.end())
         {
-            g_bus_unwatch_name(it->watcherID);
-            items.erase(it);
+            return;
         }
-        else
+        Item& item = **it;
+        g_bus_unwatch_name(item.watcherID);
+        g_dbus_connection_signal_unsubscribe(dbusConnection, item.signalID);
+        // The fetch callbacks hold their own reference
+        g_cancellable_cancel(item.cancellable);
+        g_object_unref(item.cancellable);
+        DestroyMenu(item);
+        items.erase(it);
+    }
+
+    static void DBusNameVanished(GDBusConnection*, const char* name, void*)
+    {
+        CancelLoad(name);
+        clientsToQuery.erase(name);
+        if (FindItem(name))
         {
-            LOG("SNI: Coudn't remove item " << nameStr << " when reloading");
+            LOG("SNI: " << name << " vanished!");
+            RemoveItem(name);
+            InvalidateWidget();
+            return;
         }
-        clientsToQuery[nameStr] = {nameStr, itemObjectPath};
+
+        LOG("SNI: Cannot remove unregistered bus name " << name);
+        return;
     }
 
-    static TimerResult UpdateWidgets(Box&)
+    // Applies changed properties to the shown widget, without rebuilding the tray
+    static void UpdateItemWidget(Item& item)
     {
-        // Flush connection, so we hopefully don't deadlock with any client
+        bool shown = item.texture != nullptr;
+        if (shown != IsShown(item))
+        {
+            // Appeared or disappeared
+            InvalidateWidget();
+            return;
+        }
+        if (!shown)
+        {
+            return;
+        }
+        item.texture->SetBuf(item.w, item.h, item.iconData.data());
+        item.texture->SetTooltip(item.tooltip);
+    }
+
+    // Replies to the Properties.Get calls of one group
+    struct PropertyFetch
+    {
+        std::string name;
+        PropertyGroup group;
+        uint32_t generation;
+        GCancellable* cancellable;
+        GVariantDict props;
+        size_t pendingReplies;
+    };
+    struct PropertyCall
+    {
+        PropertyFetch* fetch;
+        const char* property;
+    };
+
+    static void OnPropertyFetched(GObject* source, GAsyncResult* result, void* data)
+    {
+        PropertyCall* call = (PropertyCall*)data;
+        PropertyFetch* fetch = call->fetch;
         GError* err = nullptr;
-        g_dbus_connection_flush_sync(dbusConnection, nullptr, &err);
-        if (err)
+        GVariant* reply = g_dbus_connection_call_finish((GDBusConnection*)source, result, &err);
+        if (reply)
         {
-            LOG("SNI: g_dbus_connection_call_sync failed: " << err->message);
+            GVariant* value = nullptr;
+            g_variant_get(reply, "(v)", &value);
+            g_variant_dict_insert_value(&fetch->props, call->property, value);
+            g_variant_unref(value);
+            g_variant_unref(reply);
+        }
+        else
+        {
+            // Optional properties (e.g. IconThemePath) are allowed to fail
             g_error_free(err);
         }
+        delete call;
+        if (--fetch->pendingReplies > 0)
+        {
+            return;
+        }
 
-        if (RuntimeConfig::Get().hasSNI == false || Config::Get().enableSNI == false)
+        GVariant* props = g_variant_dict_end(&fetch->props);
+        g_variant_ref_sink(props);
+        Item* item = FindItem(fetch->name);
+        // Removed items cancel, newer fetches of the group bump the generation
+        if (!g_cancellable_is_cancelled(fetch->cancellable) && item && item->generation[fetch->group] == fetch->generation)
         {
-            // Don't bother
-            return TimerResult::Delete;
+            switch (fetch->group)
+            {
+            case GroupIcon: ParseIcon(*item, props); break;
+            case GroupToolTip: ParseToolTip(*item, props); break;
+            case GroupMenu:
+            {
+                std::string oldMenu = item->menuObjectPath;
+                ParseMenu(*item, props);
+                if (item->menuObjectPath != oldMenu)
+                {
+                    CreateMenu(*item);
+                }
+                break;
+            }
+            default: break;
+            }
+            UpdateItemWidget(*item);
         }
+        g_variant_unref(props);
+        g_object_unref(fetch->cancellable);
+        delete fetch;
+    }
+
+    static void FetchGroup(Item& item, PropertyGroup group)
+    {
+        const std::vector<const char*>& properties = groupProperties[group];
+        PropertyFetch* fetch = new PropertyFetch{item.name, group, ++item.generation[group], item.cancellable, {}, properties.size()};
+        g_object_ref(fetch->cancellable);
+        g_variant_dict_init(&fetch->props, nullptr);
+        for (const char* property : properties)
+        {
+            g_dbus_connection_call(dbusConnection, item.name.c_str(), item.object.c_str(), "org.freedesktop.DBus.Properties", "Get",
+                                   g_variant_new("(ss)", "org.kde.StatusNotifierItem", property), G_VARIANT_TYPE("(v)"), G_DBUS_CALL_FLAGS_NONE,
+                                   loadTimeout, item.cancellable, OnPropertyFetched, new PropertyCall{fetch, property});
+        }
+    }
+
+    static int Flush(void*)
+    {
+        flushSource = 0;
+        // The widget is updated, once the replies arrive
         for (auto& [name, client] : clientsToQuery)
         {
-            LOG("SNI: Creating Item " << client.name << " " << client.object);
-            Item item = CreateItem(std::move(client.name), std::move(client.object));
-            // Add handler for removing
-            item.watcherID = g_bus_watch_name_on_connection(dbusConnection, item.name.c_str(), G_BUS_NAME_WATCHER_FLAGS_NONE, nullptr,
-                                                            DBusNameVanished, nullptr, nullptr);
-
-            // Add handler for icon change
-            char* staticBuf = new char[item.name.size() + 1]{0x0};
-            memcpy(staticBuf, item.name.c_str(), item.name.size());
-            g_dbus_connection_signal_subscribe(
-                dbusConnection, item.name.c_str(), "org.kde.StatusNotifierItem", nullptr, nullptr, nullptr, G_DBUS_SIGNAL_FLAGS_NONE,
-                ItemPropertyChanged, staticBuf,
-                +[](void* ptr)
+            LoadItem(client.name, client.object);
+        }
+        clientsToQuery.clear();
+
+        for (auto& item : items)
+        {
+            for (int group = 0; group < NumGroups; group++)
+            {
+                if (item->dirtyGroups & BIT(group))
                 {
-                    LOG("SNI: Delete static name buffer for " << (char*)ptr);
-                    delete[] (char*)ptr;
-                });
+                    FetchGroup(*item, (PropertyGroup)group);
+                }
+            }
+            item->dirtyGroups = 0;
+        }
+        return G_SOURCE_REMOVE;
+    }
+
+    static void ScheduleFlush()
+    {
+        if (!flushSource)
+        {
+            // About a frame, so a burst of signals (e.g. an animated icon) or registrations (e.g. on startup) is handled at once
+            flushSource = g_timeout_add(16, Flush, nullptr);
+        }
+    }
+
+    static void MarkDirty(Item& item, PropertyGroup group)
+    {
+        item.dirtyGroups |= BIT(group);
+        ScheduleFlush();
+    }
 
-            items.push_back(std::move(item));
+    static void ItemSignal(GDBusConnection*, const char*, const char*, const char*, const char* signalName, GVariant* params, void* name)
+    {
+        Item* item = FindItem((const char*)name);
+        if (!item)
+        {
+            return;
         }
-        if (clientsToQuery.size() > 0)
+        if (strcmp(signalName, "NewIcon") == 0)
         {
-            InvalidateWidget();
+            MarkDirty(*item, GroupIcon);
         }
-        clientsToQuery.clear();
-        return TimerResult::Ok;
+        else if (strcmp(signalName, "NewToolTip") == 0)
+        {
+            MarkDirty(*item, GroupToolTip);
+        }
+        else if (strcmp(signalName, "NewMenu") == 0)
+        {
+            MarkDirty(*item, GroupMenu);
+        }
+        else if (strcmp(signalName, "NewStatus") == 0 && g_variant_is_of_type(params, G_VARIANT_TYPE("(s)")))
+        {
+            // Part of the signal, nothing to fetch
+            const char* status = nullptr;
+            g_variant_get(params, "(&s)", &status);
+            LOG("SNI: " << item->name << " is now " << status);
+            item->status = status;
+            UpdateItemWidget(*item);
+        }
+        // NewTitle, NewAttentionIcon and NewOverlayIcon change nothing we show
+    }
+
+    static void OnItemLoaded(GObject* source, GAsyncResult* result, void* data)
+    {
+        PendingLoad* load = (PendingLoad*)data;
+        GError* err = nullptr;
+        GVariant* reply = g_dbus_connection_call_finish((GDBusConnection*)source, result, &err);
+        bool cancelled = g_cancellable_is_cancelled(load->cancellable);
+        g_object_unref(load->cancellable);
+        if (cancelled)
+        {
+            // Vanished or reloaded, already removed from pendingLoads
+            LOG("SNI: Cancelled loading " << load->name);
+            if (err)
+            {
+                g_error_free(err);
+            }
+            if (reply)
+            {
+                g_variant_unref(reply);
+            }
+            delete load;
+            return;
+        }
+        pendingLoads.erase(load->name);
+        if (err)
+        {
+            // Also the case for timeouts
+            LOG("SNI: Cannot load " << load->name << " " << load->object << ": " << err->message);
+            g_error_free(err);
+            delete load;
+            return;
+        }
+
+        // Re-registered
+        RemoveItem(load->name);
+
+        auto item = std::make_unique<Item>();
+        item->name = std::move(load->name);
+        item->object = std::move(load->object);
+        item->cancellable = g_cancellable_new();
+        delete load;
+
+        GVariant* props = g_variant_get_child_value(reply, 0);
+        ParseItemProperties(*item, props);
+        // Prefetch, so the first click doesn't wait for the layout
+        CreateMenu(*item);
+        g_variant_unref(props);
+        g_variant_unref(reply);
+
+        // Add handler for removing
+        item->watcherID = g_bus_watch_name_on_connection(dbusConnection, item->name.c_str(), G_BUS_NAME_WATCHER_FLAGS_NONE, nullptr,
+                                                         DBusNameVanished, nullptr, nullptr);
+
+        // Add handler for property changes
+        char* staticBuf = new char[item->name.size() + 1]{0x0};
+        memcpy(staticBuf, item->name.c_str(), item->name.size());
+        item->signalID = g_dbus_connection_signal_subscribe(
+            dbusConnection, item->name.c_str(), "org.kde.StatusNotifierItem", nullptr, nullptr, nullptr, G_DBUS_SIGNAL_FLAGS_NONE, ItemSignal,
+            staticBuf,
+            +[](void* ptr)
+            {
+                LOG("SNI: Delete static name buffer for " << (char*)ptr);
+                delete[] (char*)ptr;
+            });
+
+        items.push_back(std::move(item));
+        InvalidateWidget();
+    }
+
+    static void LoadItem(const std::string& name, const std::string& object)
+    {
+        // Only the newest request for a name counts
+        CancelLoad(name);
+
+        LOG("SNI: Loading Item " << name << " " << object);
+        PendingLoad* load = new PendingLoad{name, object, g_cancellable_new()};
+        pendingLoads[name] = load;
+        g_dbus_connection_call(dbusConnection, name.c_str(), object.c_str(), "org.freedesktop.DBus.Properties", "GetAll",
+                               g_variant_new("(s)", "org.kde.StatusNotifierItem"), G_VARIANT_TYPE("(a{sv})"), G_DBUS_CALL_FLAGS_NONE, loadTimeout,
+                               load->cancellable, OnItemLoaded, load);
     }
 
     // SNI implements the GTK-Thingies itself internally
+    static void ForgetWidgets()
+    {
+        for (auto& item : items)
+        {
+            DetachMenu(*item);
+            item->gtkEvent = nullptr;
+            item->texture = nullptr;
+        }
+    }
+
+    // Rebuilds the tray. Only needed, when items are added, removed, shown or hidden
     static void InvalidateWidget()
     {
+        ForgetWidgets();
+        if (!parentBox)
+        {
+            // Between bars, shown once it has a new one
+            return;
+        }
         LOG("SNI: Clearing old children");
         parentBox->RemoveChild(iconBox);
 
-        // Allow further updates from the icon
-        reloadedNames.clear();
-
         auto container = Widget::Create<Box>();
         container->SetSpacing({4, false});
         container->SetOrientation(Utils::GetOrientation());
@@ -403,31 +719,40 @@ namespace SNI
 
         // Sort items, so they don't jump around randomly
         std::sort(items.begin(), items.end(),
-                  [](const Item& a, const Item& b)
+                  [](const std::unique_ptr<Item>& a, const std::unique_ptr<Item>& b)
                   {
-                      return a.name < b.name;
+                      return a->name < b->name;
                   });
 
-        for (auto& item : items)
+        for (auto& itemPtr : items)
         {
-            if (item.iconData)
+            Item& item = *itemPtr;
+            if (IsShown(item))
             {
                 auto eventBox = Widget::Create<EventBox>();
                 item.gtkEvent = eventBox.get();
 
                 eventBox->SetOnCreate(
-                    [&](Widget& w)
+                    [&item](Widget& w)
                     {
                         auto clickFn = [](GtkWidget*, GdkEventButton* event, void* data) -> gboolean
                         {
-                            if (event->button == 1)
+                            Item* item = (Item*)data;
+                            if (event->button == 1 && item->menu)
                             {
-                                Item* item = (Item*)data;
-
-                                GtkMenu* menu = (GtkMenu*)dbusmenu_gtkmenu_new(item->name.data(), item->menuObjectPath.data());
-                                LOG(menu);
-                                gtk_menu_attach_to_widget(menu, item->gtkEvent->Get(), nullptr);
-                                gtk_menu_popup_at_pointer(menu, (GdkEvent*)event);
+                                // Lets the app update the menu. Async, so the popup doesn't wait for it.
+                                DbusmenuClient* client = (DbusmenuClient*)dbusmenu_gtkmenu_get_client((DbusmenuGtkMenu*)item->menu);
+                                DbusmenuMenuitem* root = client ? dbusmenu_client_get_root(client) : nullptr;
+                                if (root)
+                                {
+                                    dbusmenu_menuitem_send_about_to_show(root, nullptr, nullptr);
+                                }
+
+                                if (!gtk_menu_get_attach_widget(item->menu))
+                                {
+                                    gtk_menu_attach_to_widget(item->menu, item->gtkEvent->Get(), nullptr);
+                                }
+                                gtk_menu_popup_at_pointer(item->menu, (GdkEvent*)event);
                                 LOG(item->menuObjectPath << " click");
                             }
                             return GDK_EVENT_STOP;
@@ -437,21 +762,8 @@ namespace SNI
 
                 LOG("SNI: Add " << item.name << " to widget");
                 auto texture = Widget::Create<Texture>();
+                int size = GetIconSize(item);
                 bool wasExplicitOverride = false;
-                int size = 24;
-                for (auto& [filter, iconSize] : Config::Get().sniIconSizes)
-                {
-                    if (item.tooltip.find(filter) != std::string::npos)
-                    {
-                        wasExplicitOverride = true;
-                        size = iconSize;
-                    }
-                    else if (filter == "*" && !wasExplicitOverride)
-                    {
-                        size = iconSize;
-                    }
-                }
-                wasExplicitOverride = false;
                 for (auto& [filter, padding] : Config::Get().sniPaddingTop)
                 {
                     if (item.tooltip.find(filter) != std::string::npos)
@@ -465,9 +777,10 @@ namespace SNI
                     }
                 }
                 Utils::SetTransform(*texture, {size, true, Alignment::Fill}, {size, true, Alignment::Fill});
-                texture->SetBuf(item.w, item.h, item.iconData);
+                texture->SetBuf(item.w, item.h, item.iconData.data());
                 texture->SetTooltip(item.tooltip);
                 texture->SetAngle(Utils::GetAngle() == 270 ? 90 : 0);
+                item.texture = texture.get();
 
                 eventBox->AddChild(std::move(texture));
                 iconBox->AddChild(std::move(eventBox));
@@ -485,7 +798,6 @@ namespace SNI
         // Add parent box
         auto box = Widget::Create<Box>();
         auto container = Widget::Create<Box>();
-        container->AddTimer<Box>(UpdateWidgets, 1000, TimerDispatchBehaviour::LateDispatch);
         iconBox = container.get();
         parentBox = box.get();
         InvalidateWidget();
@@ -493,6 +805,14 @@ namespace SNI
         parent.AddChild(std::move(box));
     }
 
+    void RemoveWidget()
+    {
+        // Destroyed together with the bar
+        parentBox = nullptr;
+        iconBox = nullptr;
+        ForgetWidgets();
+    }
+
     // Methods
     static bool RegisterItem(sniWatcher* watcher, GDBusMethodInvocation* invocation, const char* service)
     {
@@ -511,9 +831,9 @@ namespace SNI
             object = "/StatusNotifierItem";
         }
         auto it = std::find_if(items.begin(), items.end(),
-                               [&](const Item& item)
+                               [&](const std::unique_ptr<Item>& item)
                                {
-                                   return item.name == name && item.object == object;
+                                   return item->name == name && item->object == object;
                                });
         if (it != items.end())
         {
@@ -524,6 +844,7 @@ namespace SNI
         sni_watcher_complete_register_status_notifier_item(watcher, invocation);
         LOG("SNI: Registered Item " << name << " " << object);
         clientsToQuery[name] = {name, std::move(object)};
+        ScheduleFlush();
         return true;
     }
 
@@ -592,6 +913,22 @@ namespace SNI
         sni_watcher_emit_status_notifier_host_registered(watcherSkeleton);
     }
 
-    void Shutdown() {}
+    void Shutdown()
+    {
+        for (auto& [name, load] : pendingLoads)
+        {
+            g_cancellable_cancel(load->cancellable);
+        }
+        pendingLoads.clear();
+        if (flushSource)
+        {
+            g_source_remove(flushSource);
+            flushSource = 0;
+        }
+        while (!items.empty())
+        {
+            RemoveItem(items.back()->name);
+        }
+    }
 }
 #endif
@@ -5,6 +5,8 @@ namespace SNI
 {
     void Init();
     void WidgetSNI(Widget& parent);
+    // The bar of the tray is going away. WidgetSNI can be called again with another one.
+    void RemoveWidget();
     void Shutdown();
 }
 #endif
@@ -3,24 +3,26 @@
 #include "NvidiaGPU.h"
 #include "AMDGPU.h"
 #include "PulseAudio.h"
+#include "Backlight.h"
 #include "Workspaces.h"
 #include "Config.h"
 #include "SNI.h"
 #include "Wayland.h"
+#include "BlueZ.h"
+#include "Process.h"
 
 #include <cstdlib>
 #include <fstream>
-#include <mutex>
 #include <string>
 #include <sstream>
 #include <iomanip>
-#include <thread>
 
 #include <gio/gio.h>
 
 #include <pulse/pulseaudio.h>
 
 #include <dlfcn.h>
+#include <dirent.h>
 #include <sys/statvfs.h>
 #include <unistd.h>
 
@@ -214,214 +216,71 @@ namespace System
 #ifdef WITH_BLUEZ
     void InitBluetooth()
     {
-        // Try connecting to d-bus and org.bluez
-        GDBusConnection* connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, nullptr);
-        if (!connection)
+        if (!BlueZ::Init())
         {
-            LOG("Can't connect to d-bus! Disabling Bluetooth!");
-            // dbus not found, disable bluetooth
-            RuntimeConfig::Get().hasBlueZ = false;
-        }
-
-        GError* err = nullptr;
-        GVariant* objects = g_dbus_connection_call_sync(connection, "org.bluez", "/", "org.freedesktop.DBus.ObjectManager", "GetManagedObjects",
-                                                        nullptr, G_VARIANT_TYPE("(a{oa{sa{sv}}})"), G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &err);
-        if (!objects)
-        {
-            LOG("Can't connect to BlueZ d-bus! Disabling Bluetooth!");
-            LOG(err->message);
-            g_error_free(err);
-            // Not found, disable bluetooth
+            LOG("Disabling Bluetooth!");
             RuntimeConfig::Get().hasBlueZ = false;
         }
     }
-    BluetoothInfo GetBluetoothInfo()
+    const BluetoothInfo& GetBluetoothInfo()
     {
-        BluetoothInfo out{};
-        if (!RuntimeConfig::Get().hasBlueZ)
-        {
-            LOG("Error: GetBluetoothInfo called, but bluetooth isn't available");
-            return out;
-        }
-        // Init D-Bus
-        GDBusConnection* connection = g_bus_get_sync(G_BUS_TYPE_SYSTEM, nullptr, nullptr);
-        ASSERT(connection, "Failed to connect to d-bus!");
-
-        GError* err = nullptr;
-        GVariant* objects = g_dbus_connection_call_sync(connection, "org.bluez", "/", "org.freedesktop.DBus.ObjectManager", "GetManagedObjects",
-                                                        nullptr, G_VARIANT_TYPE("(a{oa{sa{sv}}})"), G_DBUS_CALL_FLAGS_NONE, -1, nullptr, &err);
-        if (!objects)
-        {
-            LOG(err->message);
-            g_error_free(err);
-            exit(-1);
-        }
-
-        // First array
-        GVariantIter* topArray;
-        g_variant_get(objects, "(a{oa{sa{sv}}})", &topArray);
-
-        // Iterate the objects
-        GVariantIter* objectDescs;
-        while (g_variant_iter_next(topArray, "{oa{sa{sv}}}", NULL, &objectDescs))
-        {
-            // Iterate the descs
-            char* type = nullptr;
-            GVariantIter* propIter;
-            while (g_variant_iter_next(objectDescs, "{sa{sv}}", &type, &propIter))
-            {
-                if (strstr(type, "org.bluez.Adapter1"))
-                {
-                    std::string adapterName;
-                    bool powered = false;
-
-                    // This is a controller/adapter -> The "host"
-                    char* str = nullptr;
-                    GVariant* var = nullptr;
-                    while (g_variant_iter_next(propIter, "{sv}", &str, &var))
-                    {
-                        if (strstr(str, "Name"))
-                        {
-                            const char* name = g_variant_get_string(var, nullptr);
-                            // Copy it for us
-                            adapterName = name;
-                        }
-                        else if (strstr(str, "Powered"))
-                        {
-                            powered = g_variant_get_boolean(var);
-                        }
-                        g_free(str);
-                        g_variant_unref(var);
-                    }
-                    if (powered)
-                    {
-                        out.defaultController = std::move(adapterName);
-                    }
-                }
-                else if (strstr(type, "org.bluez.Device1"))
-                {
-                    std::string deviceMac;
-                    std::string deviceName;
-                    std::string deviceType;
-                    bool connected = false;
-                    bool paired = false;
-
-                    // This is a device -> One "client"
-                    char* str = nullptr;
-                    GVariant* var = nullptr;
-                    while (g_variant_iter_next(propIter, "{sv}", &str, &var))
-                    {
-                        if (strcmp(str, "Address") == 0)
-                        {
-                            const char* mac = g_variant_get_string(var, nullptr);
-                            // Copy it for us
-                            deviceMac = mac;
-                        }
-                        else if (strstr(str, "Name"))
-                        {
-                            const char* name = g_variant_get_string(var, nullptr);
-                            // Copy it for us
-                            deviceName = name;
-                        }
-                        else if (strstr(str, "Icon"))
-                        {
-                            const char* icon = g_variant_get_string(var, nullptr);
-                            // Copy it for us
-                            deviceType = icon;
-                        }
-                        else if (strstr(str, "Connected"))
-                        {
-                            connected = g_variant_get_boolean(var);
-                        }
-                        else if (strstr(str, "Paired"))
-                        {
-                            paired = g_variant_get_boolean(var);
-                        }
-                        g_free(str);
-                        g_variant_unref(var);
-                    }
-                    out.devices.push_back(BluetoothDevice{connected, paired, std::move(deviceMac), std::move(deviceName), std::move(deviceType)});
-                }
-                g_variant_iter_free(propIter);
-                g_free(type);
-            }
-            g_variant_iter_free(objectDescs);
-        }
-
-        g_variant_iter_free(topArray);
-        g_variant_unref(objects);
-
-        return out;
+        return BlueZ::GetInfo();
+    }
+    uint32_t AddBluetoothCallback(std::function<void(const BluetoothInfo&)>&& callback)
+    {
+        return BlueZ::AddCallback(std::move(callback));
+    }
+    void RemoveBluetoothCallback(uint32_t handle)
+    {
+        BlueZ::RemoveCallback(handle);
     }
 
-    static Process btctlProcess{-1};
     void StartBTScan()
     {
-        StopBTScan();
-        btctlProcess = OpenProcess("/bin/sh -c \"bluetoothctl scan on\"");
+        BlueZ::StartDiscovery();
     }
     void StopBTScan()
     {
-        if (btctlProcess.pid != -1)
-        {
-            // Ctrl-C stops bluetoothctl
-            kill(btctlProcess.pid, SIGINT);
-            btctlProcess = {-1};
-        }
+        BlueZ::StopDiscovery();
     }
 
-    void ConnectBTDevice(BluetoothDevice& device, std::function<void(bool, BluetoothDevice&)> onFinish)
+    void ConnectBTDevice(const BluetoothDevice& device, std::function<void(bool, const std::string&)> onFinish)
     {
-        auto thread = [&, mac = device.mac, onFinish]()
+        // 2. Connect
+        auto connect = [onFinish = std::move(onFinish)](bool success, const std::string& path) mutable
         {
-            // 1. Pair
-            if (!device.paired)
+            // Some devices connect on their own after pairing
+            const BluetoothDevice* current = BlueZ::FindDevice(path);
+            if (!success || !current || current->connected)
             {
-                int success = system(("bluetoothctl pair " + mac).c_str());
-                if (success != 0)
-                {
-                    onFinish(false, device);
-                    return;
-                }
-            }
-            // 2. Connect
-            if (!device.connected)
-            {
-                int success = system(("bluetoothctl connect " + mac).c_str());
-                if (success != 0)
-                {
-                    onFinish(false, device);
-                    return;
-                }
+                onFinish(success && current, path);
+                return;
             }
-            onFinish(true, device);
+            BlueZ::Call(path, "org.bluez.Device1", "Connect", -1, std::move(onFinish));
         };
-        std::thread worker(thread);
-        worker.detach();
+        // 1. Pair
+        if (!device.paired)
+        {
+            BlueZ::Pair(device.path, std::move(connect));
+        }
+        else
+        {
+            connect(true, device.path);
+        }
     }
-    void DisconnectBTDevice(BluetoothDevice& device, std::function<void(bool, BluetoothDevice&)> onFinish)
+    void DisconnectBTDevice(const BluetoothDevice& device, std::function<void(bool, const std::string&)> onFinish)
     {
-        auto thread = [&, mac = device.mac, onFinish]()
+        if (!device.connected)
         {
-            // 1. Disconnect
-            if (device.connected)
-            {
-                int success = system(("bluetoothctl disconnect " + mac).c_str());
-                if (success != 0)
-                {
-                    onFinish(false, device);
-                    return;
-                }
-            }
-            onFinish(true, device);
-        };
-        std::thread worker(thread);
-        worker.detach();
+            onFinish(true, device.path);
+            return;
+        }
+        BlueZ::Call(device.path, "org.bluez.Device1", "Disconnect", -1, std::move(onFinish));
     }
 
     void OpenBTWidget()
     {
-        OpenProcess("/bin/sh -c \"gBar bluetooth\"");
+        Process::Run("gBar bluetooth");
     }
 
     std::string BTTypeToIcon(const BluetoothDevice& dev)
@@ -450,6 +309,14 @@ namespace System
     {
         return PulseAudio::GetInfo();
     }
+    uint32_t AddAudioCallback(std::function<void(const AudioInfo&)>&& callback)
+    {
+        return PulseAudio::AddAudioCallback(std::move(callback));
+    }
+    void RemoveAudioCallback(uint32_t handle)
+    {
+        PulseAudio::RemoveAudioCallback(handle);
+    }
     void SetVolumeSink(double volume)
     {
         PulseAudio::SetVolumeSink(volume);
@@ -458,38 +325,242 @@ namespace System
     {
         PulseAudio::SetVolumeSource(volume);
     }
+    const std::unordered_map<uint32_t, SinkInput>& GetSinkInputs()
+    {
+        return PulseAudio::GetSinkInputs();
+    }
+    void SetSinkInputVolume(uint32_t index, double volume)
+    {
+        PulseAudio::SetSinkInputVolume(index, volume);
+    }
+    uint32_t AddSinkInputCallback(std::function<void(ChangeType, const SinkInput&)>&& callback)
+    {
+        return PulseAudio::AddSinkInputCallback(std::move(callback));
+    }
+    void RemoveSinkInputCallback(uint32_t handle)
+    {
+        PulseAudio::RemoveSinkInputCallback(handle);
+    }
+    const std::unordered_map<uint32_t, SourceOutput>& GetSourceOutputs()
+    {
+        return PulseAudio::GetSourceOutputs();
+    }
+    uint32_t AddSourceOutputCallback(std::function<void(ChangeType, const SourceOutput&)>&& callback)
+    {
+        return PulseAudio::AddSourceOutputCallback(std::move(callback));
+    }
+    void RemoveSourceOutputCallback(uint32_t handle)
+    {
+        PulseAudio::RemoveSourceOutputCallback(handle);
+    }
+
+    double GetBrightness()
+    {
+        return Backlight::GetBrightness();
+    }
+    uint32_t AddBrightnessCallback(std::function<void(double)>&& callback)
+    {
+        return Backlight::AddCallback(std::move(callback));
+    }
+    void RemoveBrightnessCallback(uint32_t handle)
+    {
+        Backlight::RemoveCallback(handle);
+    }
+
+    std::vector<std::string> GetCameraUsers()
+    {
+        std::vector<std::string> out;
+        DIR* proc = opendir("/proc");
+        if (!proc)
+        {
+            LOG("Cannot open /proc");
+            return out;
+        }
+        // Plain readdir/readlink, since most of /proc/[pid]/fd isn't readable for us anyways.
+        char fdDirPath[64];
+        char fdPath[320];
+        char target[64];
+        while (dirent* pidEntry = readdir(proc))
+        {
+            if (pidEntry->d_name[0] < '0' || pidEntry->d_name[0] > '9')
+                continue;
+
+            snprintf(fdDirPath, sizeof(fdDirPath), "/proc/%s/fd", pidEntry->d_name);
+            DIR* fdDir = opendir(fdDirPath);
+            if (!fdDir)
+                continue;
+
+            bool usesCamera = false;
+            while (dirent* fdEntry = readdir(fdDir))
+            {
+                if (fdEntry->d_name[0] == '.')
+                    continue;
+                snprintf(fdPath, sizeof(fdPath), "%s/%s", fdDirPath, fdEntry->d_name);
+                ssize_t len = readlink(fdPath, target, sizeof(target) - 1);
+                if (len <= 0)
+                    continue;
+                target[len] = '\0';
+                if (strncmp(target, "/dev/video", 10) == 0)
+                {
+                    usesCamera = true;
+                    break;
+                }
+            }
+            closedir(fdDir);
+
+            if (usesCamera)
+            {
+                std::ifstream commFile(std::string("/proc/") + pidEntry->d_name + "/comm");
+                std::string comm;
+                std::getline(commFile, comm);
+                if (std::find(out.begin(), out.end(), comm) == out.end())
+                {
+                    out.push_back(std::move(comm));
+                }
+            }
+        }
+        closedir(proc);
+        return out;
+    }
+
+    WindowInfo GetActiveWindow()
+    {
+#if defined WITH_WORKSPACES && defined WITH_HYPRLAND
+        if (Config::Get().useHyprlandIPC)
+        {
+            return Workspaces::GetActiveWindow();
+        }
+#endif
+        const Wayland::Toplevel* toplevel = Wayland::GetActiveToplevel();
+        if (!toplevel)
+        {
+            return {};
+        }
+        return {toplevel->title, toplevel->appId};
+    }
+    uint32_t AddActiveWindowCallback(std::function<void()>&& callback)
+    {
+#if defined WITH_WORKSPACES && defined WITH_HYPRLAND
+        if (Config::Get().useHyprlandIPC)
+        {
+            return Workspaces::AddActiveWindowCallback(std::move(callback));
+        }
+#endif
+        // Any toplevel change can change the active one. The callers compare anyways.
+        return Wayland::AddToplevelCallback(
+            [callback = std::move(callback)](Wayland::ToplevelHandle)
+            {
+                callback();
+            });
+    }
+    void RemoveActiveWindowCallback(uint32_t handle)
+    {
+#if defined WITH_WORKSPACES && defined WITH_HYPRLAND
+        if (Config::Get().useHyprlandIPC)
+        {
+            Workspaces::RemoveActiveWindowCallback(handle);
+            return;
+        }
+#endif
+        Wayland::RemoveToplevelCallback(handle);
+    }
 
 #ifdef WITH_WORKSPACES
-    void PollWorkspaces(uint32_t monitor, uint32_t numWorkspaces)
+    void GetWorkspaces(uint32_t monitor, std::vector<WorkspaceInfo>& out)
     {
-        Workspaces::PollStatus(monitor, numWorkspaces);
+        out.clear();
+        uint32_t numWorkspaces = Config::Get().numWorkspaces;
+        out.resize(numWorkspaces);
+        for (uint32_t i = 0; i < numWorkspaces; i++)
+        {
+            out[i].id = i + 1;
+            out[i].key = std::to_string(i + 1);
+            out[i].name = out[i].key;
+        }
+
+        size_t fixed = out.size();
+        Workspaces::PollStatus(monitor);
+        Workspaces::GetWorkspaces(
+            [&](uint32_t id, std::string_view name, WorkspaceStatus status, const std::vector<std::string>& apps)
+            {
+                if (id >= 1 && id <= numWorkspaces)
+                {
+                    // Always shown. The protocol can report the same number for multiple groups, the most visible one wins.
+                    out[id - 1].status = std::max(out[id - 1].status, status);
+                    out[id - 1].apps = apps;
+                    return;
+                }
+                WorkspaceInfo& info = out.emplace_back();
+                info.id = id;
+                info.name = name;
+                info.key = id ? std::to_string(id) : info.name;
+                info.status = status;
+                info.apps = apps;
+            });
+
+        // Numbered ones first, then the named ones
+        std::sort(out.begin() + fixed, out.end(),
+                  [](const WorkspaceInfo& a, const WorkspaceInfo& b)
+                  {
+                      if ((a.id == 0) != (b.id == 0))
+                          return a.id != 0;
+                      if (a.id != b.id)
+                          return a.id < b.id;
+                      return a.name < b.name;
+                  });
+        // Keys have to be unique. Duplicates are next to each other after sorting.
+        size_t unique = fixed;
+        for (size_t i = fixed; i < out.size(); i++)
+        {
+            if (unique > fixed && out[unique - 1].key == out[i].key)
+            {
+                out[unique - 1].status = std::max(out[unique - 1].status, out[i].status);
+                continue;
+            }
+            if (unique != i)
+            {
+                out[unique] = std::move(out[i]);
+            }
+            unique++;
+        }
+        out.resize(unique);
     }
-    WorkspaceStatus GetWorkspaceStatus(uint32_t workspace)
+    uint32_t AddWorkspaceCallback(std::function<void()>&& callback)
     {
-        return Workspaces::GetStatus(workspace);
+        return Workspaces::AddChangeCallback(std::move(callback));
     }
-    void GotoWorkspace(uint32_t workspace)
+    void RemoveWorkspaceCallback(uint32_t handle)
     {
-        return Workspaces::Goto(workspace);
+        Workspaces::RemoveChangeCallback(handle);
+    }
+    void GotoWorkspace(const WorkspaceInfo& workspace)
+    {
+        if (workspace.id)
+        {
+            Workspaces::Goto(workspace.id);
+        }
+        else
+        {
+            Workspaces::GotoNamed(workspace.name);
+        }
     }
     void GotoNextWorkspace(char direction)
     {
         return Workspaces::GotoNext(direction);
     }
-    std::string GetWorkspaceSymbol(int index)
+    const std::string& GetWorkspaceSymbol(const WorkspaceInfo& workspace)
     {
-        if (index < 0 || index > 9)
+        auto& symbols = Config::Get().workspaceSymbols;
+        auto it = symbols.find(workspace.key);
+        if (it != symbols.end() && !it->second.empty())
         {
-            LOG("Workspace Symbol Index Out Of Bounds: " + std::to_string(index));
-            return "";
+            return it->second;
         }
-
-        if (Config::Get().workspaceSymbols[index].empty())
+        if (workspace.id == 0)
         {
-            return Config::Get().defaultWorkspaceSymbol + " ";
+            return workspace.name;
         }
-
-        return Config::Get().workspaceSymbols[index] + " ";
+        return Config::Get().defaultWorkspaceSymbol;
     }
 #endif
 
@@ -549,55 +620,43 @@ namespace System
 
     void GetOutdatedPackagesAsync(std::function<void(uint32_t)>&& returnVal)
     {
-        static std::mutex configMutex;
-        configMutex.lock();
-        if (!RuntimeConfig::Get().hasPackagesScript)
+        static Process::Handle check = 0;
+        if (!RuntimeConfig::Get().hasPackagesScript || Process::IsRunning(check))
         {
-            configMutex.unlock();
             return; // Don't bother
         }
-        configMutex.unlock();
 
-        std::thread(
-            [](std::function<void(uint32_t)> returnVal)
+        // There is no "libpacman", so run the script. Killed before the next check would start.
+        Process::Options options;
+        options.captureOutput = true;
+        options.timeoutMs = 1000 * Config::Get().checkUpdateInterval;
+        check = Process::Run(
+            Config::Get().checkPackagesCommand,
+            [returnVal = std::move(returnVal)](const Process::Result& result)
             {
-                // We need a pipe, since there is no "libpacman". This should only be called every so often anyways
-                std::string number;
-                char buf[2056];
-                FILE* pipe = popen(Config::Get().checkPackagesCommand.c_str(), "r"); // Redirect stderr
-                ASSERT(pipe, "GetOutdatedPackages: Couldn't open pipe");
-                while (fgets(buf, sizeof(buf), pipe) != 0)
+                if (result.timedOut || result.cancelled)
                 {
-                    number.append(buf);
+                    LOG("GetOutdatedPackages: Command timed out");
+                    return;
                 }
-
-                ASSERT(feof(pipe), "GetOutdatedPackages: Cannot read to eof!");
-
-                int exitCode = pclose(pipe) / 256;
-                if (exitCode != 0)
+                if (!result.Success())
                 {
-                    configMutex.lock();
                     // Invalid script/error
                     LOG("GetOutdatedPackages: Invalid command. Disabling package widget!");
                     RuntimeConfig::Get().hasPackagesScript = false;
-                    configMutex.unlock();
                     return;
                 }
                 try
                 {
-                    returnVal(std::stoul(buf));
+                    returnVal(std::stoul(result.output));
                 }
-                catch (std::invalid_argument&)
+                catch (std::exception&)
                 {
-                    configMutex.lock();
                     LOG("GetOutdatedPackages: Invalid output of the package script. Disabling package widget!");
                     RuntimeConfig::Get().hasPackagesScript = false;
-                    configMutex.unlock();
-                    return;
                 }
             },
-            std::move(returnVal))
-            .detach();
+            options);
     }
 
     std::string GetTime()
@@ -611,27 +670,27 @@ namespace System
 
     void Shutdown()
     {
-        system("shutdown 0");
+        Process::Run("shutdown 0");
     }
 
     void Reboot()
     {
-        system("reboot");
+        Process::Run("reboot");
     }
 
     void ExitWM()
     {
-        system(Config::Get().exitCommand.c_str());
+        Process::Run(Config::Get().exitCommand);
     }
 
     void Lock()
     {
-        system(Config::Get().lockCommand.c_str());
+        Process::Run(Config::Get().lockCommand);
     }
 
     void Suspend()
     {
-        system(Config::Get().suspendCommand.c_str());
+        Process::Run(Config::Get().suspendCommand);
     }
 
     void Init()
@@ -660,6 +719,8 @@ namespace System
 
         PulseAudio::Init();
 
+        Backlight::Init();
+
 #ifdef WITH_SNI
         SNI::Init();
 #endif
@@ -672,6 +733,7 @@ namespace System
         NvidiaGPU::Shutdown();
 #endif
         PulseAudio::Shutdown();
+        Backlight::Shutdown();
 
 #ifdef WITH_WORKSPACES
         Workspaces::Shutdown();
@@ -679,6 +741,7 @@ namespace System
 
 #ifdef WITH_BLUEZ
         StopBTScan();
+        BlueZ::Shutdown();
 #endif
 #ifdef WITH_SNI
         SNI::Shutdown();
@@ -3,6 +3,7 @@
 #include <string>
 #include <vector>
 #include <cstdint>
+#include <unordered_map>
 
 namespace System
 {
@@ -48,6 +49,8 @@ namespace System
     {
         bool connected;
         bool paired;
+        // D-Bus object path, identifies the device
+        std::string path;
         std::string mac;
         std::string name;
         // Known types: input-[keyboard,mouse]; audio-headset
@@ -59,13 +62,17 @@ namespace System
         std::string defaultController;
         std::vector<BluetoothDevice> devices;
     };
-    BluetoothInfo GetBluetoothInfo();
+    // Kept up-to-date by BlueZ signals, doesn't query org.bluez.
+    const BluetoothInfo& GetBluetoothInfo();
+    // Called from the main loop, whenever an adapter or a device changed
+    uint32_t AddBluetoothCallback(std::function<void(const BluetoothInfo&)>&& callback);
+    void RemoveBluetoothCallback(uint32_t handle);
     void StartBTScan();
     void StopBTScan();
 
-    // MT functions, callback, is from different thread
-    void ConnectBTDevice(BluetoothDevice& device, std::function<void(bool, BluetoothDevice&)> onFinish);
-    void DisconnectBTDevice(BluetoothDevice& device, std::function<void(bool, BluetoothDevice&)> onFinish);
+    // Async, onFinish is called from the main loop with the object path of the device
+    void ConnectBTDevice(const BluetoothDevice& device, std::function<void(bool, const std::string&)> onFinish);
+    void DisconnectBTDevice(const BluetoothDevice& device, std::function<void(bool, const std::string&)> onFinish);
 
     void OpenBTWidget();
 
@@ -81,9 +88,67 @@ namespace System
         bool sourceMuted;
     };
     AudioInfo GetAudioInfo();
+    // Called from the main loop, whenever the volume or mute state of the default sink/source changes
+    uint32_t AddAudioCallback(std::function<void(const AudioInfo&)>&& callback);
+    void RemoveAudioCallback(uint32_t handle);
     void SetVolumeSink(double volume);
     void SetVolumeSource(double volume);
 
+    enum class ChangeType
+    {
+        Added,
+        Changed,
+        Removed
+    };
+
+    // An application stream
+    struct SinkInput
+    {
+        uint32_t index;
+        std::string name;        // Application name
+        std::string description; // Name of the stream, e.g. the media title
+        double volume;
+        bool muted;
+    };
+    // Kept up-to-date by PulseAudio events, doesn't query the server.
+    const std::unordered_map<uint32_t, SinkInput>& GetSinkInputs();
+    void SetSinkInputVolume(uint32_t index, double volume);
+    // Called from the main loop on every change. For ChangeType::Removed the last known state is passed.
+    uint32_t AddSinkInputCallback(std::function<void(ChangeType, const SinkInput&)>&& callback);
+    void RemoveSinkInputCallback(uint32_t handle);
+
+    // An application recording from a source
+    struct SourceOutput
+    {
+        uint32_t index;
+        std::string name; // Application name
+        bool recording;   // false, when the stream is corked
+    };
+    // Kept up-to-date by PulseAudio events, doesn't query the server.
+    const std::unordered_map<uint32_t, SourceOutput>& GetSourceOutputs();
+    uint32_t AddSourceOutputCallback(std::function<void(ChangeType, const SourceOutput&)>&& callback);
+    void RemoveSourceOutputCallback(uint32_t handle);
+
+    // Brightness of the backlight in [0, 1]. -1 if there is no backlight
+    double GetBrightness();
+    // Called from the main loop, whenever the brightness of the backlight changes
+    uint32_t AddBrightnessCallback(std::function<void(double)>&& callback);
+    void RemoveBrightnessCallback(uint32_t handle);
+
+    // Names of processes, that have a /dev/video* device open. Scans /proc, so don't call this too often.
+    std::vector<std::string> GetCameraUsers();
+
+    struct WindowInfo
+    {
+        std::string title;
+        std::string appId;
+    };
+    // Focused window (Hyprland IPC or wlr-foreign-toplevel-management). Empty, if no window is focused.
+    WindowInfo GetActiveWindow();
+    // Called from the main loop, when the focused window or its title might have changed
+    uint32_t AddActiveWindowCallback(std::function<void()>&& callback);
+    void RemoveActiveWindowCallback(uint32_t handle);
+
 #ifdef WITH_WORKSPACES
     enum class WorkspaceStatus
     {
@@ -93,12 +158,28 @@ namespace System
         Current,
         Active
     };
-    void PollWorkspaces(uint32_t monitor, uint32_t numWorkspaces);
-    WorkspaceStatus GetWorkspaceStatus(uint32_t workspace);
-    void GotoWorkspace(uint32_t workspace);
+    struct WorkspaceInfo
+    {
+        // Unique and stable while the workspace exists: The number for numbered workspaces, the name otherwise.
+        std::string key;
+        // 0 for workspaces without a number (named/special ones)
+        uint32_t id = 0;
+        std::string name;
+        WorkspaceStatus status = WorkspaceStatus::Dead;
+        // Sorted app-ids of the windows on it. Only filled with WorkspaceIcons
+        std::vector<std::string> apps;
+    };
+    // Workspaces 1 to NumWorkspaces (Dead, if they don't exist), followed by all other existing workspaces.
+    // Status is relative to the monitor. out is cleared first, so the buffer can be reused.
+    void GetWorkspaces(uint32_t monitor, std::vector<WorkspaceInfo>& out);
+    // Called from the main loop, when the workspace state might have changed
+    uint32_t AddWorkspaceCallback(std::function<void()>&& callback);
+    void RemoveWorkspaceCallback(uint32_t handle);
+    void GotoWorkspace(const WorkspaceInfo& workspace);
     // direction: + or -
     void GotoNextWorkspace(char direction);
-    std::string GetWorkspaceSymbol(int index);
+    // Configured symbol (WorkspaceSymbol-<key>). Falls back to DefaultWorkspaceSymbol for numbered and to the name for named workspaces.
+    const std::string& GetWorkspaceSymbol(const WorkspaceInfo& workspace);
 #endif
 
     // Bytes per second upload. dx is time since last call. Will always return 0 on first run
@@ -4,124 +4,473 @@
 #include "Config.h"
 #include <wayland-client.h>
 #include <ext-workspace-unstable-v1.h>
+#include <ext-workspace-v1.h>
+#include <wlr-foreign-toplevel-management-unstable-v1.h>
+#include <glib.h>
 
 namespace Wayland
 {
     // There's probably a better way to avoid the LUTs
-    static std::unordered_map<uint32_t, Monitor> monitors;
-    static std::unordered_map<zext_workspace_group_handle_v1*, WorkspaceGroup> workspaceGroups;
-    static std::unordered_map<zext_workspace_handle_v1*, Workspace> workspaces;
+    static std::map<uint32_t, Monitor> monitors;
+    static std::unordered_map<WorkspaceGroupHandle, WorkspaceGroup> workspaceGroups;
+    static std::unordered_map<WorkspaceHandle, Workspace> workspaces;
 
-    static uint32_t curID = 0;
+    static std::unordered_map<ToplevelHandle, Toplevel> toplevels;
+    // Changes since the last done event of the toplevel
+    static std::unordered_map<ToplevelHandle, Toplevel> pendingToplevels;
+    static ToplevelHandle activeToplevel = nullptr;
 
     static wl_display* display;
     static wl_registry* registry;
-    static zext_workspace_manager_v1* workspaceManager;
+    // Only one of them is bound. The staged protocol is preferred.
+    static ext_workspace_manager_v1* extWorkspaceManager;
+    static zext_workspace_manager_v1* zextWorkspaceManager;
 
-    static bool registeredMonitors = false;
-    static bool registeredGroup = false;
-    static bool registeredWorkspace = false;
-    static bool registeredWorkspaceInfo = false;
+    // Registry names of the managers, so we can choose after all globals have been announced
+    static uint32_t extManagerName = 0;
+    static uint32_t zextManagerName = 0;
+    static uint32_t toplevelManagerName = 0;
+    static uint32_t toplevelManagerVersion = 0;
+    static zwlr_foreign_toplevel_manager_v1* toplevelManager;
 
-    // Wayland callbacks
+    static GSource* displaySource = nullptr;
+    static Utils::CallbackList<> workspaceCallbacks;
+    static Utils::CallbackList<ToplevelHandle> toplevelCallbacks;
+
+    // Protocol independent handling of the workspace events
+
+    // Ids are only unique within a group, e.g. with workspaces per output
+    static void IndexWorkspace(WorkspaceHandle handle, const Workspace& ws)
+    {
+        auto groupIt = workspaceGroups.find(ws.parent);
+        if (groupIt != workspaceGroups.end())
+        {
+            groupIt->second.workspacesById[ws.id] = handle;
+        }
+    }
+
+    static void UnindexWorkspace(WorkspaceHandle handle, const Workspace& ws)
+    {
+        auto groupIt = workspaceGroups.find(ws.parent);
+        if (groupIt == workspaceGroups.end())
+        {
+            return;
+        }
+        auto idIt = groupIt->second.workspacesById.find(ws.id);
+        if (idIt != groupIt->second.workspacesById.end() && idIt->second == handle)
+        {
+            groupIt->second.workspacesById.erase(idIt);
+        }
+    }
+
+    static void UpdateWorkspaceId(WorkspaceHandle handle, Workspace& ws)
+    {
+        UnindexWorkspace(handle, ws);
+        // Prefer numeric names (like Hyprland's "1".."9"). Otherwise use the 1D position, for compositors that number their workspaces that way.
+        // Everything else becomes (uint32_t)-1, which never matches a workspace button
+        char* end;
+        unsigned long id = strtoul(ws.name.c_str(), &end, 10);
+        if (!ws.name.empty() && !*end)
+        {
+            ws.id = (uint32_t)id;
+        }
+        else if (!ws.coordinates.empty())
+        {
+            ws.id = ws.coordinates[0] + 1;
+        }
+        else
+        {
+            ws.id = (uint32_t)-1;
+        }
+        IndexWorkspace(handle, ws);
+        LOG("Workspace ID: " << ws.id);
+    }
 
-    // Workspace Callbacks
-    static void OnWorkspaceName(void*, zext_workspace_handle_v1* workspace, const char* name)
+    static void HandleWorkspaceName(WorkspaceHandle handle, const char* name)
     {
-        workspaces[workspace].id = std::stoul(name);
-        LOG("Workspace ID: " << workspaces[workspace].id);
-        registeredWorkspaceInfo = true;
+        Workspace& ws = workspaces[handle];
+        ws.name = name;
+        UpdateWorkspaceId(handle, ws);
     }
-    static void OnWorkspaceGeometry(void*, zext_workspace_handle_v1*, wl_array*) {}
-    static void OnWorkspaceState(void*, zext_workspace_handle_v1* ws, wl_array* arrState)
+
+    static void HandleWorkspaceCoordinates(WorkspaceHandle handle, wl_array* arrCoordinates)
     {
-        Workspace& workspace = workspaces[ws];
-        ASSERT(workspace.parent, "Wayland: Workspace not registered!");
-        WorkspaceGroup& group = workspaceGroups[workspace.parent];
+        Workspace& ws = workspaces[handle];
+        ws.coordinates.assign((uint32_t*)arrCoordinates->data, (uint32_t*)((uint8_t*)arrCoordinates->data + arrCoordinates->size));
+        UpdateWorkspaceId(handle, ws);
+    }
 
-        workspace.active = false;
-        // Manual wl_array_for_each, since that's broken for C++
-        for (zext_workspace_handle_v1_state* state = (zext_workspace_handle_v1_state*)arrState->data;
-             (uint8_t*)state < (uint8_t*)arrState->data + arrState->size; state += 1)
+    static void HandleWorkspaceActive(WorkspaceHandle handle, bool active)
+    {
+        Workspace& workspace = workspaces[handle];
+        workspace.active = active;
+        if (active)
         {
-            if (*state == ZEXT_WORKSPACE_HANDLE_V1_STATE_ACTIVE)
+            LOG("Wayland: Activate Workspace " << workspace.id);
+            // The staged protocol can send the state before the workspace is in a group. workspace_enter handles it then.
+            if (workspace.parent)
             {
-                LOG("Wayland: Activate Workspace " << workspace.id);
-                group.lastActiveWorkspace = ws;
-                workspace.active = true;
+                workspaceGroups[workspace.parent].lastActiveWorkspace = handle;
             }
         }
-        if (!workspace.active)
+        else
         {
             LOG("Wayland: Deactivate Workspace " << workspace.id);
         }
     }
-    static void OnWorkspaceRemove(void*, zext_workspace_handle_v1* ws)
+
+    static void HandleWorkspaceEnter(WorkspaceGroupHandle groupHandle, WorkspaceHandle handle)
     {
-        Workspace& workspace = workspaces[ws];
-        ASSERT(workspace.parent, "Wayland: Workspace not registered!");
-        WorkspaceGroup& group = workspaceGroups[workspace.parent];
-        auto it = std::find(group.workspaces.begin(), group.workspaces.end(), ws);
-        group.workspaces.erase(it);
+        WorkspaceGroup& group = workspaceGroups[groupHandle];
+        Workspace& workspace = workspaces[handle];
+        group.workspaces.push_back(handle);
+        workspace.parent = groupHandle;
+        IndexWorkspace(handle, workspace);
+        if (workspace.active)
+        {
+            group.lastActiveWorkspace = handle;
+        }
+    }
 
-        workspaces.erase(ws);
+    static void HandleWorkspaceLeave(WorkspaceGroupHandle groupHandle, WorkspaceHandle handle)
+    {
+        auto wsIt = workspaces.find(handle);
+        if (wsIt != workspaces.end() && wsIt->second.parent == groupHandle)
+        {
+            UnindexWorkspace(handle, wsIt->second);
+            wsIt->second.parent = nullptr;
+        }
+        auto groupIt = workspaceGroups.find(groupHandle);
+        if (groupIt != workspaceGroups.end())
+        {
+            WorkspaceGroup& group = groupIt->second;
+            auto it = std::find(group.workspaces.begin(), group.workspaces.end(), handle);
+            if (it != group.workspaces.end())
+            {
+                group.workspaces.erase(it);
+            }
+            if (group.lastActiveWorkspace == handle)
+            {
+                group.lastActiveWorkspace = nullptr;
+            }
+        }
+    }
+
+    static void HandleWorkspaceRemoved(WorkspaceHandle handle)
+    {
+        auto wsIt = workspaces.find(handle);
+        if (wsIt == workspaces.end())
+        {
+            return;
+        }
+        if (wsIt->second.parent)
+        {
+            HandleWorkspaceLeave(wsIt->second.parent, handle);
+        }
+        workspaces.erase(wsIt);
 
         LOG("Wayland: Removed workspace!");
     }
-    zext_workspace_handle_v1_listener workspaceListener = {OnWorkspaceName, OnWorkspaceGeometry, OnWorkspaceState, OnWorkspaceRemove};
 
-    // Workspace Group callbacks
-    static void OnWSGroupOutputEnter(void*, zext_workspace_group_handle_v1* group, wl_output* output)
+    static void HandleGroupOutputEnter(WorkspaceGroupHandle group, wl_output* output)
     {
         auto monitor = std::find_if(monitors.begin(), monitors.end(),
-                                    [&](const std::pair<uint32_t, Monitor>& mon)
+                                    [&](const std::pair<const uint32_t, Monitor>& mon)
                                     {
                                         return mon.second.output == output;
                                     });
-        ASSERT(monitor != monitors.end(), "Wayland: Registered WS group before monitor!");
+        if (monitor == monitors.end())
+        {
+            LOG("Wayland: Registered WS group before monitor!");
+            return;
+        }
         LOG("Wayland: Added group to monitor");
         monitor->second.workspaceGroup = group;
     }
-    static void OnWSGroupOutputLeave(void*, zext_workspace_group_handle_v1*, wl_output* output)
+
+    static void HandleGroupOutputLeave(WorkspaceGroupHandle group, wl_output* output)
     {
         auto monitor = std::find_if(monitors.begin(), monitors.end(),
-                                    [&](const std::pair<uint32_t, Monitor>& mon)
+                                    [&](const std::pair<const uint32_t, Monitor>& mon)
                                     {
                                         return mon.second.output == output;
                                     });
-        ASSERT(monitor != monitors.end(), "Wayland: Registered WS group before monitor!");
-        LOG("Wayland: Added group to monitor");
-        monitor->second.workspaceGroup = nullptr;
+        if (monitor != monitors.end() && monitor->second.workspaceGroup == group)
+        {
+            LOG("Wayland: Removed group from monitor");
+            monitor->second.workspaceGroup = nullptr;
+        }
     }
-    static void OnWSGroupWorkspaceAdded(void*, zext_workspace_group_handle_v1* workspace, zext_workspace_handle_v1* ws)
+
+    static void HandleGroupRemoved(WorkspaceGroupHandle group)
     {
-        LOG("Wayland: Added workspace!");
-        workspaceGroups[workspace].workspaces.push_back(ws);
-        workspaces[ws] = {workspace, (uint32_t)-1, false};
-        zext_workspace_handle_v1_add_listener(ws, &workspaceListener, nullptr);
-        registeredWorkspace = true;
+        for (auto& [id, monitor] : monitors)
+        {
+            if (monitor.workspaceGroup == group)
+            {
+                monitor.workspaceGroup = nullptr;
+            }
+        }
+        workspaceGroups.erase(group);
     }
-    static void OnWSGroupRemove(void*, zext_workspace_group_handle_v1* workspaceGroup)
+
+    static void HandleManagerFinished()
     {
-        workspaceGroups.erase(workspaceGroup);
+        LOG("Wayland: Workspace manager finished. Disabling workspaces!");
+        RuntimeConfig::Get().hasWorkspaces = false;
     }
-    zext_workspace_group_handle_v1_listener workspaceGroupListener = {OnWSGroupOutputEnter, OnWSGroupOutputLeave, OnWSGroupWorkspaceAdded,
-                                                                      OnWSGroupRemove};
 
-    // Workspace Manager Callbacks
-    static void OnWSManagerNewGroup(void*, zext_workspace_manager_v1*, zext_workspace_group_handle_v1* group)
+    // Wayland callbacks
+
+    // ext_workspace_v1 (staged)
+    namespace Ext
     {
-        // Register callbacks for the group.
-        registeredGroup = true;
-        zext_workspace_group_handle_v1_add_listener(group, &workspaceGroupListener, nullptr);
+        static void OnWorkspaceId(void*, ext_workspace_handle_v1*, const char*) {}
+        static void OnWorkspaceName(void*, ext_workspace_handle_v1* ws, const char* name)
+        {
+            HandleWorkspaceName((WorkspaceHandle)ws, name);
+        }
+        static void OnWorkspaceCoordinates(void*, ext_workspace_handle_v1* ws, wl_array* coordinates)
+        {
+            HandleWorkspaceCoordinates((WorkspaceHandle)ws, coordinates);
+        }
+        static void OnWorkspaceState(void*, ext_workspace_handle_v1* ws, uint32_t state)
+        {
+            HandleWorkspaceActive((WorkspaceHandle)ws, state & EXT_WORKSPACE_HANDLE_V1_STATE_ACTIVE);
+        }
+        static void OnWorkspaceCapabilities(void*, ext_workspace_handle_v1* ws, uint32_t capabilities)
+        {
+            workspaces[(WorkspaceHandle)ws].canActivate = capabilities & EXT_WORKSPACE_HANDLE_V1_WORKSPACE_CAPABILITIES_ACTIVATE;
+        }
+        static void OnWorkspaceRemoved(void*, ext_workspace_handle_v1* ws)
+        {
+            HandleWorkspaceRemoved((WorkspaceHandle)ws);
+            ext_workspace_handle_v1_destroy(ws);
+        }
+        ext_workspace_handle_v1_listener workspaceListener = {OnWorkspaceId,           OnWorkspaceName,   OnWorkspaceCoordinates, OnWorkspaceState,
+                                                              OnWorkspaceCapabilities, OnWorkspaceRemoved};
+
+        static void OnGroupCapabilities(void*, ext_workspace_group_handle_v1*, uint32_t) {}
+        static void OnGroupOutputEnter(void*, ext_workspace_group_handle_v1* group, wl_output* output)
+        {
+            HandleGroupOutputEnter((WorkspaceGroupHandle)group, output);
+        }
+        static void OnGroupOutputLeave(void*, ext_workspace_group_handle_v1* group, wl_output* output)
+        {
+            HandleGroupOutputLeave((WorkspaceGroupHandle)group, output);
+        }
+        static void OnGroupWorkspaceEnter(void*, ext_workspace_group_handle_v1* group, ext_workspace_handle_v1* ws)
+        {
+            HandleWorkspaceEnter((WorkspaceGroupHandle)group, (WorkspaceHandle)ws);
+        }
+        static void OnGroupWorkspaceLeave(void*, ext_workspace_group_handle_v1* group, ext_workspace_handle_v1* ws)
+        {
+            HandleWorkspaceLeave((WorkspaceGroupHandle)group, (WorkspaceHandle)ws);
+        }
+        static void OnGroupRemoved(void*, ext_workspace_group_handle_v1* group)
+        {
+            HandleGroupRemoved((WorkspaceGroupHandle)group);
+            ext_workspace_group_handle_v1_destroy(group);
+        }
+        ext_workspace_group_handle_v1_listener workspaceGroupListener = {OnGroupCapabilities,   OnGroupOutputEnter,    OnGroupOutputLeave,
+                                                                         OnGroupWorkspaceEnter, OnGroupWorkspaceLeave, OnGroupRemoved};
+
+        static void OnManagerWorkspaceGroup(void*, ext_workspace_manager_v1*, ext_workspace_group_handle_v1* group)
+        {
+            workspaceGroups[(WorkspaceGroupHandle)group] = {};
+            ext_workspace_group_handle_v1_add_listener(group, &workspaceGroupListener, nullptr);
+        }
+        static void OnManagerWorkspace(void*, ext_workspace_manager_v1*, ext_workspace_handle_v1* ws)
+        {
+            LOG("Wayland: Added workspace!");
+            // Not part of a group until workspace_enter
+            workspaces[(WorkspaceHandle)ws] = {};
+            ext_workspace_handle_v1_add_listener(ws, &workspaceListener, nullptr);
+        }
+        static void OnManagerDone(void*, ext_workspace_manager_v1*)
+        {
+            // All changes of one atomic update have been sent
+            workspaceCallbacks.Invoke();
+        }
+        static void OnManagerFinished(void*, ext_workspace_manager_v1*)
+        {
+            HandleManagerFinished();
+        }
+        ext_workspace_manager_v1_listener workspaceManagerListener = {OnManagerWorkspaceGroup, OnManagerWorkspace, OnManagerDone, OnManagerFinished};
     }
-    static void OnWSManagerDone(void*, zext_workspace_manager_v1*) {}
-    static void OnWSManagerFinished(void*, zext_workspace_manager_v1*)
+
+    // ext_workspace_unstable_v1
+    namespace ZExt
     {
-        LOG("Wayland: Workspace manager finished. Disabling workspaces!");
-        RuntimeConfig::Get().hasWorkspaces = false;
+        static void OnWorkspaceName(void*, zext_workspace_handle_v1* ws, const char* name)
+        {
+            HandleWorkspaceName((WorkspaceHandle)ws, name);
+        }
+        static void OnWorkspaceCoordinates(void*, zext_workspace_handle_v1* ws, wl_array* coordinates)
+        {
+            HandleWorkspaceCoordinates((WorkspaceHandle)ws, coordinates);
+        }
+        static void OnWorkspaceState(void*, zext_workspace_handle_v1* ws, wl_array* arrState)
+        {
+            bool active = false;
+            // Manual wl_array_for_each, since that's broken for C++
+            for (zext_workspace_handle_v1_state* state = (zext_workspace_handle_v1_state*)arrState->data;
+                 (uint8_t*)state < (uint8_t*)arrState->data + arrState->size; state += 1)
+            {
+                if (*state == ZEXT_WORKSPACE_HANDLE_V1_STATE_ACTIVE)
+                {
+                    active = true;
+                }
+            }
+            HandleWorkspaceActive((WorkspaceHandle)ws, active);
+        }
+        static void OnWorkspaceRemove(void*, zext_workspace_handle_v1* ws)
+        {
+            HandleWorkspaceRemoved((WorkspaceHandle)ws);
+            zext_workspace_handle_v1_destroy(ws);
+        }
+        zext_workspace_handle_v1_listener workspaceListener = {OnWorkspaceName, OnWorkspaceCoordinates, OnWorkspaceState, OnWorkspaceRemove};
+
+        static void OnGroupOutputEnter(void*, zext_workspace_group_handle_v1* group, wl_output* output)
+        {
+            HandleGroupOutputEnter((WorkspaceGroupHandle)group, output);
+        }
+        static void OnGroupOutputLeave(void*, zext_workspace_group_handle_v1* group, wl_output* output)
+        {
+            HandleGroupOutputLeave((WorkspaceGroupHandle)group, output);
+        }
+        static void OnGroupWorkspaceAdded(void*, zext_workspace_group_handle_v1* group, zext_workspace_handle_v1* ws)
+        {
+            LOG("Wayland: Added workspace!");
+            // The unstable protocol has no capabilities, activate is always there
+            Workspace& workspace = workspaces[(WorkspaceHandle)ws];
+            workspace = {};
+            workspace.canActivate = true;
+            HandleWorkspaceEnter((WorkspaceGroupHandle)group, (WorkspaceHandle)ws);
+            zext_workspace_handle_v1_add_listener(ws, &workspaceListener, nullptr);
+        }
+        static void OnGroupRemove(void*, zext_workspace_group_handle_v1* group)
+        {
+            HandleGroupRemoved((WorkspaceGroupHandle)group);
+            zext_workspace_group_handle_v1_destroy(group);
+        }
+        zext_workspace_group_handle_v1_listener workspaceGroupListener = {OnGroupOutputEnter, OnGroupOutputLeave, OnGroupWorkspaceAdded, OnGroupRemove};
+
+        static void OnManagerNewGroup(void*, zext_workspace_manager_v1*, zext_workspace_group_handle_v1* group)
+        {
+            // Register callbacks for the group.
+            workspaceGroups[(WorkspaceGroupHandle)group] = {};
+            zext_workspace_group_handle_v1_add_listener(group, &workspaceGroupListener, nullptr);
+        }
+        static void OnManagerDone(void*, zext_workspace_manager_v1*)
+        {
+            // All changes of one atomic update have been sent
+            workspaceCallbacks.Invoke();
+        }
+        static void OnManagerFinished(void*, zext_workspace_manager_v1*)
+        {
+            HandleManagerFinished();
+        }
+        zext_workspace_manager_v1_listener workspaceManagerListener = {OnManagerNewGroup, OnManagerDone, OnManagerFinished};
+    }
+
+    // zwlr_foreign_toplevel_management_v1
+    namespace Foreign
+    {
+        static Toplevel& GetPending(zwlr_foreign_toplevel_handle_v1* handle)
+        {
+            auto it = pendingToplevels.find((ToplevelHandle)handle);
+            if (it != pendingToplevels.end())
+            {
+                return it->second;
+            }
+            // Start from the current state, only the changed properties are sent
+            auto current = toplevels.find((ToplevelHandle)handle);
+            return pendingToplevels[(ToplevelHandle)handle] = current != toplevels.end() ? current->second : Toplevel{};
+        }
+
+        static void OnTitle(void*, zwlr_foreign_toplevel_handle_v1* handle, const char* title)
+        {
+            GetPending(handle).title = title;
+        }
+        static void OnAppId(void*, zwlr_foreign_toplevel_handle_v1* handle, const char* appId)
+        {
+            GetPending(handle).appId = appId;
+        }
+        static void OnOutputEnter(void*, zwlr_foreign_toplevel_handle_v1* handle, wl_output* output)
+        {
+            GetPending(handle).outputs.push_back(output);
+        }
+        static void OnOutputLeave(void*, zwlr_foreign_toplevel_handle_v1* handle, wl_output* output)
+        {
+            std::vector<wl_output*>& outputs = GetPending(handle).outputs;
+            auto it = std::find(outputs.begin(), outputs.end(), output);
+            if (it != outputs.end())
+            {
+                outputs.erase(it);
+            }
+        }
+        static void OnState(void*, zwlr_foreign_toplevel_handle_v1* handle, wl_array* arrState)
+        {
+            bool activated = false;
+            // Manual wl_array_for_each, since that's broken for C++
+            for (uint32_t* state = (uint32_t*)arrState->data; (uint8_t*)state < (uint8_t*)arrState->data + arrState->size; state += 1)
+            {
+                if (*state == ZWLR_FOREIGN_TOPLEVEL_HANDLE_V1_STATE_ACTIVATED)
+                {
+                    activated = true;
+                }
+            }
+            GetPending(handle).activated = activated;
+        }
+        static void OnDone(void*, zwlr_foreign_toplevel_handle_v1* handle)
+        {
+            auto it = pendingToplevels.find((ToplevelHandle)handle);
+            if (it == pendingToplevels.end())
+            {
+                return;
+            }
+            Toplevel& toplevel = toplevels[(ToplevelHandle)handle];
+            toplevel = std::move(it->second);
+            pendingToplevels.erase(it);
+
+            if (toplevel.activated)
+            {
+                activeToplevel = (ToplevelHandle)handle;
+            }
+            else if (activeToplevel == (ToplevelHandle)handle)
+            {
+                activeToplevel = nullptr;
+            }
+            toplevelCallbacks.Invoke((ToplevelHandle)handle);
+        }
+        static void OnClosed(void*, zwlr_foreign_toplevel_handle_v1* handle)
+        {
+            toplevels.erase((ToplevelHandle)handle);
+            pendingToplevels.erase((ToplevelHandle)handle);
+            if (activeToplevel == (ToplevelHandle)handle)
+            {
+                activeToplevel = nullptr;
+            }
+            toplevelCallbacks.Invoke((ToplevelHandle)handle);
+            zwlr_foreign_toplevel_handle_v1_destroy(handle);
+        }
+        static void OnParent(void*, zwlr_foreign_toplevel_handle_v1*, zwlr_foreign_toplevel_handle_v1*) {}
+        zwlr_foreign_toplevel_handle_v1_listener toplevelListener = {OnTitle, OnAppId, OnOutputEnter, OnOutputLeave,
+                                                                     OnState, OnDone,  OnClosed,      OnParent};
+
+        static void OnManagerToplevel(void*, zwlr_foreign_toplevel_manager_v1*, zwlr_foreign_toplevel_handle_v1* handle)
+        {
+            zwlr_foreign_toplevel_handle_v1_add_listener(handle, &toplevelListener, nullptr);
+        }
+        static void OnManagerFinished(void*, zwlr_foreign_toplevel_manager_v1* manager)
+        {
+            LOG("Wayland: Toplevel manager finished");
+            zwlr_foreign_toplevel_manager_v1_destroy(manager);
+            toplevelManager = nullptr;
+        }
+        zwlr_foreign_toplevel_manager_v1_listener toplevelManagerListener = {OnManagerToplevel, OnManagerFinished};
     }
-    zext_workspace_manager_v1_listener workspaceManagerListener = {OnWSManagerNewGroup, OnWSManagerDone, OnWSManagerFinished};
 
     // Output Callbacks
     // Very bloated, indeed
@@ -131,9 +480,15 @@ namespace Wayland
     static void OnOutputScale(void*, wl_output*, int32_t) {}
     static void OnOutputName(void*, wl_output* output, const char* name)
     {
-        LOG("Wayland: Registering monitor " << name << " at ID " << curID);
-        registeredMonitors = true;
-        monitors.try_emplace(curID++, Monitor{name, output, nullptr});
+        for (auto& [registryName, monitor] : monitors)
+        {
+            if (monitor.output == output)
+            {
+                LOG("Wayland: Registering monitor " << name << " (Registry name " << registryName << ")");
+                monitor.name = name;
+                return;
+            }
+        }
     }
     static void OnOutputDescription(void*, wl_output*, const char*) {}
     wl_output_listener outputListener = {OnOutputGeometry, OnOutputMode, OnOutputDone, OnOutputScale, OnOutputName, OnOutputDescription};
@@ -145,28 +500,149 @@ namespace Wayland
         {
             wl_output* output = (wl_output*)wl_registry_bind(registry, name, &wl_output_interface, 4);
             wl_output_add_listener(output, &outputListener, nullptr);
+            // Right away, so workspace groups can enter it before it has a name
+            monitors[name] = Monitor{"", output, nullptr};
         }
-        if (strcmp(interface, "zext_workspace_manager_v1") == 0 && !Config::Get().useHyprlandIPC)
+        // Bound in Init, once we know which ones are available
+        if (strcmp(interface, "ext_workspace_manager_v1") == 0)
         {
-            workspaceManager = (zext_workspace_manager_v1*)wl_registry_bind(registry, name, &zext_workspace_manager_v1_interface, version);
-            zext_workspace_manager_v1_add_listener(workspaceManager, &workspaceManagerListener, nullptr);
+            extManagerName = name;
+        }
+        if (strcmp(interface, "zext_workspace_manager_v1") == 0)
+        {
+            zextManagerName = name;
+        }
+        if (strcmp(interface, "zwlr_foreign_toplevel_manager_v1") == 0)
+        {
+            toplevelManagerName = name;
+            toplevelManagerVersion = version;
         }
     }
-    static void OnRegistryRemove(void*, wl_registry*, uint32_t) {}
+    static void OnRegistryRemove(void*, wl_registry*, uint32_t name)
+    {
+        auto it = monitors.find(name);
+        if (it == monitors.end())
+        {
+            return;
+        }
+        LOG("Wayland: Removing monitor " << it->second.name);
+        wl_output* output = it->second.output;
+        for (auto& [handle, toplevel] : toplevels)
+        {
+            toplevel.outputs.erase(std::remove(toplevel.outputs.begin(), toplevel.outputs.end(), output), toplevel.outputs.end());
+        }
+        wl_output_release(output);
+        monitors.erase(it);
+        // The monitor indices have changed
+        workspaceCallbacks.Invoke();
+    }
     wl_registry_listener registryListener = {OnRegistryAdd, OnRegistryRemove};
 
-    // Dispatch events.
-    static void Dispatch()
+    static void BindWorkspaceManager()
     {
-        wl_display_roundtrip(display);
+        if (Config::Get().useHyprlandIPC || Config::Get().useSwayIPC)
+        {
+            return;
+        }
+        if (extManagerName)
+        {
+            LOG("Wayland: Using ext_workspace_manager_v1");
+            extWorkspaceManager = (ext_workspace_manager_v1*)wl_registry_bind(registry, extManagerName, &ext_workspace_manager_v1_interface, 1);
+            ext_workspace_manager_v1_add_listener(extWorkspaceManager, &Ext::workspaceManagerListener, nullptr);
+        }
+        else if (zextManagerName)
+        {
+            LOG("Wayland: Using zext_workspace_manager_v1");
+            zextWorkspaceManager = (zext_workspace_manager_v1*)wl_registry_bind(registry, zextManagerName, &zext_workspace_manager_v1_interface, 1);
+            zext_workspace_manager_v1_add_listener(zextWorkspaceManager, &ZExt::workspaceManagerListener, nullptr);
+        }
     }
-    static void WaitFor(bool& condition)
+
+    static void BindToplevelManager()
     {
-        while (!condition && wl_display_dispatch(display) != -1)
+        // Hyprland reports the windows through its IPC. Without a widget, that needs it, the events would only cost wakeups.
+        if (!toplevelManagerName || Config::Get().useHyprlandIPC || !Config::Get().windowTitle)
         {
+            return;
         }
+        LOG("Wayland: Using zwlr_foreign_toplevel_manager_v1");
+        toplevelManager = (zwlr_foreign_toplevel_manager_v1*)wl_registry_bind(registry, toplevelManagerName, &zwlr_foreign_toplevel_manager_v1_interface,
+                                                                              std::min(toplevelManagerVersion, 3u));
+        zwlr_foreign_toplevel_manager_v1_add_listener(toplevelManager, &Foreign::toplevelManagerListener, nullptr);
     }
 
+    // GSource, that dispatches the events of our display from the main loop (prepare_read/read_events/dispatch_pending).
+    struct DisplaySource
+    {
+        GSource source;
+        gpointer fdTag;
+        bool reading;
+    };
+
+    static gboolean DisplaySourcePrepare(GSource* source, int* timeout)
+    {
+        DisplaySource* displaySrc = (DisplaySource*)source;
+        *timeout = -1;
+        // GLib skips check, when a higher priority source got ready in the same iteration. A second prepare_read would then wait in
+        // read_events for a reader, that doesn't exist.
+        if (displaySrc->reading)
+        {
+            return false;
+        }
+        if (wl_display_prepare_read(display) != 0)
+        {
+            // There are already events in the queue, dispatch them first
+            displaySrc->reading = false;
+            return true;
+        }
+        displaySrc->reading = true;
+        // Send out our requests, before we go to sleep
+        wl_display_flush(display);
+        return false;
+    }
+
+    static gboolean DisplaySourceCheck(GSource* source)
+    {
+        DisplaySource* displaySrc = (DisplaySource*)source;
+        if (!displaySrc->reading)
+        {
+            return true;
+        }
+        displaySrc->reading = false;
+        GIOCondition revents = g_source_query_unix_fd(source, displaySrc->fdTag);
+        if (revents & G_IO_IN)
+        {
+            return wl_display_read_events(display) == 0;
+        }
+        wl_display_cancel_read(display);
+        return revents & (G_IO_ERR | G_IO_HUP);
+    }
+
+    static gboolean DisplaySourceDispatch(GSource* source, GSourceFunc, gpointer)
+    {
+        DisplaySource* displaySrc = (DisplaySource*)source;
+        if (wl_display_dispatch_pending(display) < 0 || (g_source_query_unix_fd(source, displaySrc->fdTag) & (G_IO_ERR | G_IO_HUP)))
+        {
+            LOG("Wayland: Lost connection to the compositor!");
+            RuntimeConfig::Get().hasWorkspaces = false;
+            displaySource = nullptr;
+            return G_SOURCE_REMOVE;
+        }
+        return G_SOURCE_CONTINUE;
+    }
+
+    static void DisplaySourceFinalize(GSource* source)
+    {
+        DisplaySource* displaySrc = (DisplaySource*)source;
+        if (displaySrc->reading)
+        {
+            wl_display_cancel_read(display);
+            displaySrc->reading = false;
+        }
+    }
+
+    static GSourceFuncs displaySourceFuncs = {DisplaySourcePrepare, DisplaySourceCheck, DisplaySourceDispatch, DisplaySourceFinalize, nullptr, nullptr};
+
     void Init()
     {
         display = wl_display_connect(nullptr);
@@ -175,80 +651,158 @@ namespace Wayland
         ASSERT(registry, "Cannot get wayland registry!");
 
         wl_registry_add_listener(registry, &registryListener, nullptr);
+        // First roundtrip: globals get announced. Second roundtrip: Initial state of the bound globals (output names) has arrived.
+        // Third roundtrip: Initial workspace state (after the outputs, so the groups can find their monitor).
+        // The compositor sends the whole initial state as a reply to the bind, so this can't block indefinitely.
+        wl_display_roundtrip(display);
+        wl_display_roundtrip(display);
+        BindWorkspaceManager();
+        BindToplevelManager();
         wl_display_roundtrip(display);
 
-        WaitFor(registeredMonitors);
-        registeredMonitors = false;
+        // Everything else is dispatched from the main loop
+        displaySource = g_source_new(&displaySourceFuncs, sizeof(DisplaySource));
+        DisplaySource* displaySrc = (DisplaySource*)displaySource;
+        displaySrc->reading = false;
+        displaySrc->fdTag = g_source_add_unix_fd(displaySource, wl_display_get_fd(display), (GIOCondition)(G_IO_IN | G_IO_ERR | G_IO_HUP));
+        g_source_attach(displaySource, nullptr);
+        g_source_unref(displaySource);
 
-        if (!workspaceManager && !Config::Get().useHyprlandIPC)
+        if (!extWorkspaceManager && !zextWorkspaceManager && !Config::Get().useHyprlandIPC && !Config::Get().useSwayIPC)
         {
-            LOG("Compositor doesn't implement zext_workspace_manager_v1, disabling workspaces!");
+            LOG("Compositor doesn't implement (z)ext_workspace_manager_v1, disabling workspaces!");
             RuntimeConfig::Get().hasWorkspaces = false;
             return;
         }
 
         // Hack: manually activate workspace for each monitor
+        uint32_t monitorIdx = 0;
         for (auto& monitor : monitors)
         {
             // Find group
             auto& group = workspaceGroups[monitor.second.workspaceGroup];
 
             // Find ws with monitor index + 1
-            auto workspaceIt = std::find_if(workspaces.begin(), workspaces.end(),
-                                            [&](const std::pair<zext_workspace_handle_v1*, Workspace>& ws)
-                                            {
-                                                return ws.second.id == monitor.first + 1;
-                                            });
-            if (workspaceIt != workspaces.end())
-            {
-                LOG("Forcefully activate workspace " << workspaceIt->second.id)
-                if (workspaceIt->second.id == 1)
+            WorkspaceHandle workspaceHandle = GetWorkspaceById(nullptr, ++monitorIdx);
+            if (workspaceHandle)
+            {
+                Workspace& workspace = workspaces.at(workspaceHandle);
+                LOG("Forcefully activate workspace " << workspace.id);
+                if (workspace.id == 1)
                 {
                     // Activate first workspace
-                    workspaceIt->second.active = true;
+                    workspace.active = true;
                 }
                 // Make it visible
-                group.lastActiveWorkspace = workspaceIt->first;
+                group.lastActiveWorkspace = workspaceHandle;
             }
         }
     }
 
-    void PollEvents()
+    uint32_t AddWorkspaceCallback(std::function<void()>&& callback)
     {
-        // Dispatch events
-        Dispatch();
-        if (registeredGroup)
-        {
-            // New Group, wait for workspaces to be registered.
-            WaitFor(registeredWorkspace);
-        }
-        if (registeredWorkspace)
-        {
-            // New workspace added, need info
-            WaitFor(registeredWorkspaceInfo);
-        }
-        registeredGroup = false;
-        registeredWorkspace = false;
-        registeredWorkspaceInfo = false;
-        return;
+        return workspaceCallbacks.Add(std::move(callback));
+    }
+
+    void RemoveWorkspaceCallback(uint32_t handle)
+    {
+        workspaceCallbacks.Remove(handle);
     }
 
     void Shutdown()
     {
+        if (displaySource)
+        {
+            g_source_destroy(displaySource);
+            displaySource = nullptr;
+        }
         if (display)
             wl_display_disconnect(display);
     }
 
-    const std::unordered_map<uint32_t, Monitor>& GetMonitors()
+    const std::map<uint32_t, Monitor>& GetMonitors()
     {
         return monitors;
     }
-    const std::unordered_map<zext_workspace_group_handle_v1*, WorkspaceGroup>& GetWorkspaceGroups()
+    const Monitor* GetMonitor(uint32_t index)
+    {
+        if (index >= monitors.size())
+        {
+            return nullptr;
+        }
+        return &std::next(monitors.begin(), index)->second;
+    }
+    const std::unordered_map<WorkspaceGroupHandle, WorkspaceGroup>& GetWorkspaceGroups()
     {
         return workspaceGroups;
     }
-    const std::unordered_map<zext_workspace_handle_v1*, Workspace>& GetWorkspaces()
+    const std::unordered_map<WorkspaceHandle, Workspace>& GetWorkspaces()
     {
         return workspaces;
     }
+    WorkspaceHandle GetWorkspaceById(WorkspaceGroupHandle group, uint32_t id)
+    {
+        if (group)
+        {
+            auto groupIt = workspaceGroups.find(group);
+            if (groupIt == workspaceGroups.end())
+            {
+                return nullptr;
+            }
+            auto it = groupIt->second.workspacesById.find(id);
+            return it != groupIt->second.workspacesById.end() ? it->second : nullptr;
+        }
+        for (auto& [groupHandle, workspaceGroup] : workspaceGroups)
+        {
+            auto it = workspaceGroup.workspacesById.find(id);
+            if (it != workspaceGroup.workspacesById.end())
+            {
+                return it->second;
+            }
+        }
+        return nullptr;
+    }
+
+    const std::unordered_map<ToplevelHandle, Toplevel>& GetToplevels()
+    {
+        return toplevels;
+    }
+    const Toplevel* GetActiveToplevel()
+    {
+        auto it = toplevels.find(activeToplevel);
+        return it != toplevels.end() ? &it->second : nullptr;
+    }
+    uint32_t AddToplevelCallback(std::function<void(ToplevelHandle)>&& callback)
+    {
+        return toplevelCallbacks.Add(std::move(callback));
+    }
+    void RemoveToplevelCallback(uint32_t handle)
+    {
+        toplevelCallbacks.Remove(handle);
+    }
+
+    bool ActivateWorkspace(WorkspaceHandle handle)
+    {
+        auto it = workspaces.find(handle);
+        if (it == workspaces.end() || !it->second.canActivate)
+        {
+            return false;
+        }
+        if (extWorkspaceManager)
+        {
+            ext_workspace_handle_v1_activate((ext_workspace_handle_v1*)handle);
+            ext_workspace_manager_v1_commit(extWorkspaceManager);
+        }
+        else if (zextWorkspaceManager)
+        {
+            zext_workspace_handle_v1_activate((zext_workspace_handle_v1*)handle);
+            zext_workspace_manager_v1_commit(zextWorkspaceManager);
+        }
+        else
+        {
+            return false;
+        }
+        wl_display_flush(display);
+        return true;
+    }
 }
@@ -2,35 +2,79 @@
 #include "Common.h"
 
 struct wl_output;
-struct zext_workspace_group_handle_v1;
-struct zext_workspace_handle_v1;
+struct wl_proxy;
 namespace Wayland
 {
+    // Either the zext_workspace_*_v1 or the ext_workspace_*_v1 objects, depending on what the compositor implements.
+    using WorkspaceHandle = wl_proxy*;
+    using WorkspaceGroupHandle = wl_proxy*;
+    // zwlr_foreign_toplevel_handle_v1
+    using ToplevelHandle = wl_proxy*;
+
     struct Monitor
     {
+        // Connector name (e.g. DP-1). Empty until the compositor has sent it.
         std::string name;
         wl_output* output;
-        zext_workspace_group_handle_v1* workspaceGroup;
+        WorkspaceGroupHandle workspaceGroup;
     };
 
     struct Workspace
     {
-        zext_workspace_group_handle_v1* parent;
-        uint32_t id;
-        bool active;
+        WorkspaceGroupHandle parent = nullptr;
+        uint32_t id = (uint32_t)-1;
+        bool active = false;
+        // The compositor allows us to activate it
+        bool canActivate = false;
+        std::string name;
+        std::vector<uint32_t> coordinates;
     };
     struct WorkspaceGroup
     {
-        std::vector<zext_workspace_handle_v1*> workspaces;
-        zext_workspace_handle_v1* lastActiveWorkspace;
+        std::vector<WorkspaceHandle> workspaces;
+        // Index for lookups by the (numeric) name of the workspace
+        std::unordered_map<uint32_t, WorkspaceHandle> workspacesById;
+        WorkspaceHandle lastActiveWorkspace = nullptr;
+    };
+
+    // A window, as reported by wlr-foreign-toplevel-management
+    struct Toplevel
+    {
+        std::string title;
+        std::string appId;
+        bool activated = false;
+        std::vector<wl_output*> outputs;
     };
 
+    // Events are dispatched from the main loop after this.
     void Init();
-    void PollEvents();
 
-    const std::unordered_map<uint32_t, Monitor>& GetMonitors();
-    const std::unordered_map<zext_workspace_group_handle_v1*, WorkspaceGroup>& GetWorkspaceGroups();
-    const std::unordered_map<zext_workspace_handle_v1*, Workspace>& GetWorkspaces();
+    // Called from the main loop, once the compositor has sent a complete set of workspace changes ((z)ext_workspace_manager_v1.done)
+    // and when a monitor has been removed
+    uint32_t AddWorkspaceCallback(std::function<void()>&& callback);
+    void RemoveWorkspaceCallback(uint32_t handle);
+
+    // Keyed by the registry name of the wl_output. Ordered, so the n-th entry is the n-th GdkMonitor (Both are in announcement order).
+    const std::map<uint32_t, Monitor>& GetMonitors();
+    // The monitor with this GdkMonitor index. nullptr, if there is none.
+    const Monitor* GetMonitor(uint32_t index);
+    const std::unordered_map<WorkspaceGroupHandle, WorkspaceGroup>& GetWorkspaceGroups();
+    const std::unordered_map<WorkspaceHandle, Workspace>& GetWorkspaces();
+    // nullptr, if there is no workspace with this id in the group. A null group searches all groups.
+    WorkspaceHandle GetWorkspaceById(WorkspaceGroupHandle group, uint32_t id);
+
+    // Asks the compositor to activate the workspace. The new state arrives with the next done event.
+    // Returns false, if the workspace can't be activated.
+    bool ActivateWorkspace(WorkspaceHandle handle);
+
+    // Only filled, if the compositor implements zwlr_foreign_toplevel_manager_v1 and a widget needs it.
+    // Updated atomically on the done event of the toplevel, removed on closed.
+    const std::unordered_map<ToplevelHandle, Toplevel>& GetToplevels();
+    // nullptr, if no toplevel is activated
+    const Toplevel* GetActiveToplevel();
+    // Called from the main loop with the toplevel, that has changed. If it isn't in GetToplevels() anymore, it has been closed.
+    uint32_t AddToplevelCallback(std::function<void(ToplevelHandle)>&& callback);
+    void RemoveToplevelCallback(uint32_t handle);
 
     void Shutdown();
 }
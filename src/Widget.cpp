@@ -1,6 +1,7 @@
 #include "Widget.h"
 #include "Common.h"
 #include "CSS.h"
+#include "IconCache.h"
 
 #include <cmath>
 
@@ -49,7 +50,8 @@ Widget::~Widget()
 {
     m_Childs.clear();
     LOG("Destroy widget");
-    gtk_widget_destroy(m_Widget);
+    if (m_Widget)
+        gtk_widget_destroy(m_Widget);
 }
 
 void Widget::CreateAndAddWidget(Widget* widget, GtkWidget* parentWidget)
@@ -113,6 +115,15 @@ void Widget::SetTooltip(const std::string& tooltip)
     m_Tooltip = tooltip;
 }
 
+void Widget::SetSensitive(bool sensitive)
+{
+    if (m_Widget)
+    {
+        gtk_widget_set_sensitive(m_Widget, sensitive);
+    }
+    m_Sensitive = sensitive;
+}
+
 void Widget::AddChild(std::unique_ptr<Widget>&& widget)
 {
     if (m_Widget)
@@ -125,12 +136,7 @@ void Widget::AddChild(std::unique_ptr<Widget>&& widget)
 void Widget::RemoveChild(size_t idx)
 {
     ASSERT(idx < m_Childs.size(), "RemoveChild: Invalid index");
-    if (m_Widget)
-    {
-        auto& child = *m_Childs[idx];
-        gtk_container_remove((GtkContainer*)m_Widget, child.m_Widget);
-        child.m_Widget = nullptr;
-    }
+    // The destructor destroys the gtk widget, which also removes it from our container.
     m_Childs.erase(m_Childs.begin() + idx);
 }
 void Widget::RemoveChild(Widget* widget)
@@ -142,11 +148,6 @@ void Widget::RemoveChild(Widget* widget)
                            });
     if (it != m_Childs.end())
     {
-        if (m_Widget)
-        {
-            gtk_container_remove((GtkContainer*)m_Widget, it->get()->m_Widget);
-            it->get()->m_Widget = nullptr;
-        }
         m_Childs.erase(it);
     }
     else
@@ -160,6 +161,11 @@ void Widget::SetVisible(bool visible)
     gtk_widget_set_visible(m_Widget, visible);
 }
 
+bool Widget::IsMapped() const
+{
+    return m_Widget && gtk_widget_get_mapped(m_Widget);
+}
+
 void Widget::PropagateToParent(GdkEvent* event)
 {
     gtk_propagate_event(gtk_widget_get_parent(m_Widget), event);
@@ -172,6 +178,7 @@ void Widget::ApplyPropertiesToWidget()
     gtk_style_context_add_class(style, m_CssClass.c_str());
 
     gtk_widget_set_tooltip_text(m_Widget, m_Tooltip.c_str());
+    gtk_widget_set_sensitive(m_Widget, m_Sensitive);
 
     // Apply transform
     gtk_widget_set_size_request(m_Widget, m_HorizontalTransform.size, m_VerticalTransform.size);
@@ -198,6 +205,27 @@ void Box::SetSpacing(Spacing spacing)
     m_Spacing = spacing;
 }
 
+void Box::ReorderChild(Widget* widget, size_t position)
+{
+    auto it = std::find_if(m_Childs.begin(), m_Childs.end(),
+                           [&](std::unique_ptr<Widget>& other)
+                           {
+                               return other.get() == widget;
+                           });
+    if (it == m_Childs.end() || position >= m_Childs.size())
+    {
+        LOG("ReorderChild: Invalid child!");
+        return;
+    }
+    std::unique_ptr<Widget> child = std::move(*it);
+    m_Childs.erase(it);
+    m_Childs.insert(m_Childs.begin() + position, std::move(child));
+    if (m_Widget && widget->Get())
+    {
+        gtk_box_reorder_child((GtkBox*)m_Widget, widget->Get(), position);
+    }
+}
+
 void Box::Create()
 {
     m_Widget = gtk_box_new(Utils::ToGtkOrientation(m_Orientation), m_Spacing.free);
@@ -515,29 +543,97 @@ void NetworkSensor::Draw(cairo_t* cr)
     gdk_rgba_free(colDown);
 }
 
-Texture::~Texture()
+ElidedText::~ElidedText()
 {
-    if (m_Pixbuf)
-        g_free(m_Pixbuf);
-    if (m_Bytes)
-        g_free(m_Bytes);
+    if (m_Layout)
+    {
+        g_object_unref(m_Layout);
+        m_Layout = nullptr;
+    }
 }
 
-void Texture::SetBuf(size_t width, size_t height, uint8_t* buf)
+void ElidedText::SetText(const std::string& text)
 {
-    m_Width = width;
-    m_Height = height;
-    m_Bytes = g_bytes_new(buf, m_Width * m_Height * 4);
-    m_Pixbuf = gdk_pixbuf_new_from_bytes((GBytes*)m_Bytes, GDK_COLORSPACE_RGB, true, 8, m_Width, m_Height, m_Width * 4);
+    if (text == m_Text)
+    {
+        return;
+    }
+    m_Text = text;
+    if (m_Layout)
+    {
+        pango_layout_set_text(m_Layout, m_Text.c_str(), m_Text.size());
+        gtk_widget_queue_draw(m_Widget);
+    }
+}
+
+void ElidedText::Create()
+{
+    CairoArea::Create();
+    m_Layout = gtk_widget_create_pango_layout(m_Widget, m_Text.c_str());
+    pango_layout_set_ellipsize(m_Layout, PANGO_ELLIPSIZE_END);
+    pango_layout_set_single_paragraph_mode(m_Layout, true);
+
+    // The font comes from the CSS, so the layout has to pick up style changes
+    auto styleUpdatedFn = [](GtkWidget*, void* data)
+    {
+        ElidedText* text = (ElidedText*)data;
+        if (text->m_Layout)
+        {
+            pango_layout_context_changed(text->m_Layout);
+        }
+    };
+    g_signal_connect(m_Widget, "style-updated", G_CALLBACK(+styleUpdatedFn), this);
+}
+
+void ElidedText::Draw(cairo_t* cr)
+{
+    GtkAllocation dim;
+    gtk_widget_get_allocation(m_Widget, &dim);
+    if (dim.width != m_LayoutWidth)
+    {
+        m_LayoutWidth = dim.width;
+        pango_layout_set_width(m_Layout, dim.width * PANGO_SCALE);
+    }
+
+    int height;
+    pango_layout_get_pixel_size(m_Layout, nullptr, &height);
+    // Uses the color of the css class
+    gtk_render_layout(gtk_widget_get_style_context(m_Widget), cr, 0, ((double)dim.height - height) / 2, m_Layout);
+}
+
+Texture::~Texture() {}
+
+void Texture::SetBuf(size_t width, size_t height, const uint8_t* buf)
+{
+    if (width == 0 || height == 0)
+    {
+        m_Source = nullptr;
+    }
+    else
+    {
+        m_Source = IconCache::GetSource(width, height, buf);
+    }
+    m_Scaled = nullptr;
+    if (m_Widget)
+        gtk_widget_queue_draw(m_Widget);
 }
 
 void Texture::Draw(cairo_t* cr)
 {
+    if (!m_Source)
+        return;
     Quad q = GetQuad();
-
-    // TODO: Non-quad sizes
-    double scaleX = q.size / m_Width;
-    double scaleY = q.size / m_Height;
+    uint32_t size = q.size;
+    int scale = gtk_widget_get_scale_factor(m_Widget);
+    if (size == 0)
+        return;
+    if (!m_Scaled || m_ScaledSize != size || m_ScaledScale != scale)
+    {
+        // Only when the allocation or the monitor changes, not on every draw
+        m_Scaled = IconCache::GetScaled(m_Source, size, scale);
+        m_ScaledSize = size;
+        m_ScaledScale = scale;
+    }
 
     double paddingX, paddingY;
     if (m_Angle == 90)
@@ -556,12 +652,9 @@ void Texture::Draw(cairo_t* cr)
     cairo_rotate(cr, m_Angle * M_PI / 180.0);
     cairo_translate(cr, -(q.x + paddingX + q.size / 2), -(q.y + paddingY + q.size / 2));
 
-    cairo_rectangle(cr, q.x + paddingX, q.y + paddingY, q.size, q.size);
-
-    cairo_scale(cr, scaleX, scaleY);
-
-    gdk_cairo_set_source_pixbuf(cr, m_Pixbuf, (q.x + paddingX) * (1.0 / scaleY), (q.y + paddingY) * (1.0 / scaleY));
-    cairo_fill(cr);
+    // Already at the right size, snapped to whole pixels so it isn't resampled
+    cairo_set_source_surface(cr, m_Scaled->surface, std::round(q.x + paddingX), std::round(q.y + paddingY));
+    cairo_paint(cr);
 }
 
 void Revealer::SetTransition(Transition transition)
@@ -678,7 +771,11 @@ void Slider::SetOrientation(Orientation orientation)
 
 void Slider::SetValue(double value)
 {
-    gtk_range_set_value((GtkRange*)m_Widget, value);
+    if (m_Widget)
+    {
+        gtk_range_set_value((GtkRange*)m_Widget, value);
+    }
+    m_Value = value;
 }
 
 void Slider::SetInverted(bool inverted)
@@ -695,6 +792,7 @@ void Slider::Create()
 {
     m_Widget = gtk_scale_new_with_range(Utils::ToGtkOrientation(m_Orientation), m_Range.min, m_Range.max, m_Range.step);
     gtk_range_set_inverted((GtkRange*)m_Widget, m_Inverted);
+    gtk_range_set_value((GtkRange*)m_Widget, m_Value);
     gtk_scale_set_draw_value((GtkScale*)m_Widget, false);
     auto changedFn = [](GtkScale*, GtkScrollType*, double val, void* data)
     {
@@ -97,6 +97,9 @@ template<typename TWidget>
 using Callback = std::function<void(TWidget&)>;
 template<typename TWidget>
 using TimerCallback = std::function<TimerResult(TWidget&)>;
+// Second parameter is the frame time in microseconds
+template<typename TWidget>
+using TickCallback = std::function<TimerResult(TWidget&, int64_t)>;
 
 class Widget
 {
@@ -118,6 +121,8 @@ public:
     void SetVerticalTransform(const Transform& transform);
     void SetHorizontalTransform(const Transform& transform);
     void SetTooltip(const std::string& tooltip);
+    // Insensitive widgets don't react to input and are drawn greyed out
+    void SetSensitive(bool sensitive);
 
     virtual void Create() = 0;
 
@@ -159,10 +164,38 @@ public:
         g_timeout_add(timeoutMS, +fn, payload);
     }
 
+    // Called once per frame by the frame clock, until TimerResult::Delete is returned. Only runs while the widget is realized.
+    template<typename TWidget>
+    void AddTickCallback(TickCallback<TWidget>&& callback)
+    {
+        ASSERT(m_Widget, "AddTickCallback: Widget not created!");
+        struct TickPayload
+        {
+            TickCallback<TWidget> tickFn;
+            Widget* thisWidget;
+        };
+        TickPayload* payload = new TickPayload();
+        payload->thisWidget = this;
+        payload->tickFn = std::move(callback);
+        auto fn = [](GtkWidget*, GdkFrameClock* clock, void* data) -> int
+        {
+            TickPayload* payload = (TickPayload*)data;
+            TimerResult result = payload->tickFn(*(TWidget*)payload->thisWidget, gdk_frame_clock_get_frame_time(clock));
+            return result == TimerResult::Ok ? G_SOURCE_CONTINUE : G_SOURCE_REMOVE;
+        };
+        auto destroy = [](void* data)
+        {
+            delete (TickPayload*)data;
+        };
+        gtk_widget_add_tick_callback(m_Widget, +fn, payload, +destroy);
+    }
+
     GtkWidget* Get() { return m_Widget; };
     const std::vector<std::unique_ptr<Widget>>& GetChilds() const { return m_Childs; };
 
     void SetVisible(bool visible);
+    // Whether the widget is currently on screen
+    bool IsMapped() const;
 
     void SetOnCreate(Callback<Widget>&& onCreate) { m_OnCreate = onCreate; }
 
@@ -176,6 +209,7 @@ protected:
 
     std::string m_CssClass;
     std::string m_Tooltip;
+    bool m_Sensitive = true;
     Transform m_HorizontalTransform; // X
     Transform m_VerticalTransform;   // Y
 
@@ -191,6 +225,9 @@ public:
     void SetOrientation(Orientation orientation);
     void SetSpacing(Spacing spacing);
 
+    // Moves an existing child to the position (In both the child list and the gtk box)
+    void ReorderChild(Widget* widget, size_t position);
+
     virtual void Create() override;
 
 private:
@@ -279,14 +316,20 @@ private:
     std::unique_ptr<Box> contextDown;
 };
 
+namespace IconCache
+{
+    struct Surface;
+}
+
 class Texture : public CairoArea
 {
 public:
     Texture() = default;
     virtual ~Texture();
 
-    // Non-Owning, ARGB32
-    void SetBuf(size_t width, size_t height, uint8_t* buf);
+    // Non-Owning (copied), RGBA. Can be called again to replace the image.
+    // Shared through the IconCache with every other texture showing the same image.
+    void SetBuf(size_t width, size_t height, const uint8_t* buf);
 
     void ForceHeight(size_t height) { m_ForcedHeight = height; };
     void AddPaddingTop(int32_t topPadding) { m_Padding = topPadding; };
@@ -295,13 +338,35 @@ public:
 private:
     void Draw(cairo_t* cr) override;
 
-    size_t m_Width;
-    size_t m_Height;
     size_t m_ForcedHeight = 0;
-    double m_Angle;
+    double m_Angle = 0;
     int32_t m_Padding = 0;
-    GBytes* m_Bytes;
-    GdkPixbuf* m_Pixbuf;
+    std::shared_ptr<const IconCache::Surface> m_Source;
+    // m_Source scaled to the last drawn size, only rescaled when that changes
+    std::shared_ptr<const IconCache::Surface> m_Scaled;
+    uint32_t m_ScaledSize = 0;
+    int m_ScaledScale = 0;
+};
+
+// Single line of text, elided to the width of the widget.
+// Changing the text only redraws the widget and never changes its size, so frequent changes don't relayout the bar.
+class ElidedText : public CairoArea
+{
+public:
+    ElidedText() = default;
+    virtual ~ElidedText();
+
+    void SetText(const std::string& text);
+
+    virtual void Create() override;
+
+private:
+    void Draw(cairo_t* cr) override;
+
+    std::string m_Text;
+    // Kept for the lifetime of the widget, so pango can reuse its measurements
+    PangoLayout* m_Layout = nullptr;
+    int m_LayoutWidth = -1;
 };
 
 class Revealer : public Widget
@@ -371,6 +436,7 @@ public:
 private:
     Orientation m_Orientation = Orientation::Horizontal;
     SliderRange m_Range;
+    double m_Value = 0;
     bool m_Inverted = false;
     double m_ScrollSpeed = 5. / 100.; // 5%
     std::function<void(Slider&, double)> m_OnValueChange;
@@ -3,15 +3,44 @@
 #include "CSS.h"
 
 #include <tuple>
+#include <utility>
 #include <fstream>
 
 #include <gtk/gtk.h>
 #include <gtk-layer-shell.h>
 
 Window::Window(int32_t monitor) : m_MonitorID(monitor) {}
+Window::Window(GdkMonitor* monitor) : m_Monitor(monitor) {}
+
+Window::Window(Window&& other) noexcept
+    : m_Window(std::exchange(other.m_Window, nullptr)), m_App(std::exchange(other.m_App, nullptr)), m_MainWidget(std::move(other.m_MainWidget)),
+      m_Anchor(other.m_Anchor), m_Margin(other.m_Margin), m_Exclusive(other.m_Exclusive), m_MonitorID(other.m_MonitorID), m_Monitor(other.m_Monitor)
+{
+}
+
+Window& Window::operator=(Window&& other) noexcept
+{
+    // other's destructor releases what we owned before
+    std::swap(m_Window, other.m_Window);
+    std::swap(m_App, other.m_App);
+    std::swap(m_MainWidget, other.m_MainWidget);
+    std::swap(m_Anchor, other.m_Anchor);
+    std::swap(m_Margin, other.m_Margin);
+    std::swap(m_Exclusive, other.m_Exclusive);
+    std::swap(m_MonitorID, other.m_MonitorID);
+    std::swap(m_Monitor, other.m_Monitor);
+    return *this;
+}
 
 Window::~Window()
 {
+    if (m_Window)
+    {
+        // Widgets first, they destroy their gtk widgets themselves
+        m_MainWidget.reset();
+        gtk_widget_destroy((GtkWidget*)m_Window);
+        m_Window = nullptr;
+    }
     if (m_App)
     {
         g_object_unref(m_App);
@@ -28,6 +57,11 @@ void Window::Init(int argc, char** argv)
 
     gtk_style_context_add_provider_for_screen(gdk_screen_get_default(), (GtkStyleProvider*)CSS::GetProvider(), GTK_STYLE_PROVIDER_PRIORITY_USER);
 
+    FindMonitor();
+}
+
+void Window::FindMonitor()
+{
     GdkDisplay* defaultDisplay = gdk_display_get_default();
     ASSERT(defaultDisplay != nullptr, "Cannot get display!");
     if (m_MonitorID != -1)
@@ -41,9 +75,17 @@ void Window::Init(int argc, char** argv)
     }
 }
 
-void Window::Run()
+void Window::Create()
 {
     ASSERT(m_MainWidget, "Main Widget not set!");
+    if (m_Window)
+    {
+        return;
+    }
+    if (!m_Monitor)
+    {
+        FindMonitor();
+    }
 
     m_Window = (GtkWindow*)gtk_window_new(GTK_WINDOW_TOPLEVEL);
 
@@ -75,6 +117,14 @@ void Window::Run()
     // Create widgets
     Widget::CreateAndAddWidget(m_MainWidget.get(), (GtkWidget*)m_Window);
 
+    // Do the expensive work (style resolution, GdkWindow creation) now and not when the window is shown.
+    gtk_widget_realize((GtkWidget*)m_Window);
+}
+
+void Window::Run()
+{
+    Create();
+
     gtk_widget_show_all((GtkWidget*)m_Window);
 
     gtk_main();
@@ -86,6 +136,23 @@ void Window::Close()
     gtk_main_quit();
 }
 
+void Window::Show()
+{
+    ASSERT(m_Window, "Window not created!");
+    gtk_widget_show_all((GtkWidget*)m_Window);
+}
+
+void Window::Hide()
+{
+    ASSERT(m_Window, "Window not created!");
+    gtk_widget_hide((GtkWidget*)m_Window);
+}
+
+bool Window::IsVisible() const
+{
+    return m_Window && gtk_widget_get_visible((GtkWidget*)m_Window);
+}
+
 void Window::UpdateMargin()
 {
     for (auto [anchor, margin] : m_Margin)
@@ -130,7 +197,7 @@ void Window::SetMargin(Anchor anchor, int32_t margin)
     }
     if (FLAG_CHECK(anchor, Anchor::Bottom))
     {
-        m_Margin[2] = {Anchor::Bottom, margin};
+        m_Margin[3] = {Anchor::Bottom, margin};
     }
 
     if (m_Window)
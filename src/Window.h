@@ -17,15 +17,24 @@ class Window
 public:
     Window() = default;
     Window(int32_t monitor);
-    Window(Window&& window) noexcept = default;
-    Window& operator=(Window&& other) noexcept = default;
+    Window(GdkMonitor* monitor);
+    // The moved-from window doesn't own the GtkWindow anymore
+    Window(Window&& other) noexcept;
+    Window& operator=(Window&& other) noexcept;
     ~Window();
 
     void Init(int argc, char** argv);
+    // Creates the layer surface and all widgets, without showing them.
+    void Create();
     void Run();
 
     void Close();
 
+    // Show/Hide an already created window, without touching the main loop.
+    void Show();
+    void Hide();
+    bool IsVisible() const;
+
     void SetAnchor(Anchor anchor) { m_Anchor = anchor; }
     void SetMargin(Anchor anchor, int32_t margin);
     void SetExclusive(bool exclusive) { m_Exclusive = exclusive; }
@@ -34,8 +43,10 @@ public:
 
     int GetWidth() const;
     int GetHeight() const;
+    GdkMonitor* GetMonitor() const { return m_Monitor; }
 private:
     void UpdateMargin();
+    void FindMonitor();
 
     void LoadCSS(GtkCssProvider* provider);
 
@@ -44,10 +55,10 @@ private:
 
     std::unique_ptr<Widget> m_MainWidget;
 
-    Anchor m_Anchor;
-    std::array<std::pair<Anchor, int32_t>, 4> m_Margin;
+    Anchor m_Anchor{};
+    std::array<std::pair<Anchor, int32_t>, 4> m_Margin{};
     bool m_Exclusive = true;
 
-    int32_t m_MonitorID;
+    int32_t m_MonitorID = -1;
     GdkMonitor* m_Monitor = nullptr;
 };
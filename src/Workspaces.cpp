@@ -1,269 +1,1504 @@
 #include "Workspaces.h"
 #include "Wayland.h"
-#include <ext-workspace-unstable-v1.h>
+#include "JSON.h"
 #include <unordered_map>
+#include <set>
+#include <map>
+#include <deque>
+#include <algorithm>
+#include <cstring>
+
+#include <fcntl.h>
+#include <glib-unix.h>
 
 #ifdef WITH_WORKSPACES
 namespace Workspaces
 {
+    static Utils::CallbackList<> changeCallbacks;
+    static Utils::CallbackList<> windowCallbacks;
+    // For backends, that don't know which apps are on a workspace
+    static const std::vector<std::string> noApps;
+
     namespace Wayland
     {
         using WaylandMonitor = ::Wayland::Monitor;
-        using WaylandWorkspaceGroup = ::Wayland::WorkspaceGroup;
         using WaylandWorkspace = ::Wayland::Workspace;
 
         static uint32_t lastPolledMonitor;
-        void PollStatus(uint32_t monitorID, uint32_t)
+        void PollStatus(uint32_t monitorID)
         {
-            ::Wayland::PollEvents();
+            // Nothing to poll, events are dispatched from the main loop.
             lastPolledMonitor = monitorID;
         }
-        System::WorkspaceStatus GetStatus(uint32_t workspaceId)
+        System::WorkspaceStatus GetStatus(::Wayland::WorkspaceHandle workspaceHandle)
         {
-            const WaylandMonitor& monitor = ::Wayland::GetMonitors().at(lastPolledMonitor);
-            if (!monitor.output)
+            const WaylandMonitor* monitor = ::Wayland::GetMonitor(lastPolledMonitor);
+            if (!monitor || !monitor->output)
             {
                 LOG("Polled monitor doesn't exist!");
                 return System::WorkspaceStatus::Dead;
             }
 
             auto& workspaces = ::Wayland::GetWorkspaces();
-            auto workspaceIt = std::find_if(workspaces.begin(), workspaces.end(),
-                                            [&](const std::pair<zext_workspace_handle_v1*, WaylandWorkspace>& ws)
-                                            {
-                                                return ws.second.id == workspaceId;
-                                            });
-            if (workspaceIt == workspaces.end())
+            const WaylandWorkspace& workspace = workspaces.at(workspaceHandle);
+
+            auto& groups = ::Wayland::GetWorkspaceGroups();
+            auto groupIt = groups.find(monitor->workspaceGroup);
+            if (groupIt != groups.end() && groupIt->second.lastActiveWorkspace == workspaceHandle)
             {
-                return System::WorkspaceStatus::Dead;
+                // Last active workspace (Means we can still see it, since no other ws is active and thus is only visible)
+                return workspace.active ? System::WorkspaceStatus::Active : System::WorkspaceStatus::Current;
+            }
+
+            auto currentGroupIt = groups.find(workspace.parent);
+            if (currentGroupIt != groups.end() && currentGroupIt->second.lastActiveWorkspace == workspaceHandle)
+            {
+                return System::WorkspaceStatus::Visible;
             }
+            return System::WorkspaceStatus::Inactive;
+        }
+
+        // The group of the polled monitor. nullptr, if the compositor hasn't put the monitor into a group.
+        ::Wayland::WorkspaceGroupHandle GetPolledGroup()
+        {
+            const WaylandMonitor* monitor = ::Wayland::GetMonitor(lastPolledMonitor);
+            return monitor ? monitor->workspaceGroup : nullptr;
+        }
 
-            const WaylandWorkspaceGroup& group = ::Wayland::GetWorkspaceGroups().at(monitor.workspaceGroup);
-            if (group.lastActiveWorkspace)
+        void GetWorkspaces(const WorkspaceFn& callback)
+        {
+            // Compositors with workspaces per output number them per group
+            ::Wayland::WorkspaceGroupHandle group = GetPolledGroup();
+            for (auto& [handle, workspace] : ::Wayland::GetWorkspaces())
             {
-                const WaylandWorkspace& activeWorkspace = workspaces.at(group.lastActiveWorkspace);
-                if (activeWorkspace.id == workspaceId && activeWorkspace.active)
+                if (group && workspace.parent != group)
                 {
-                    return System::WorkspaceStatus::Active;
+                    continue;
                 }
-                else if (activeWorkspace.id == workspaceId)
+                bool numbered = workspace.id != (uint32_t)-1;
+                if (!numbered && workspace.name.empty())
                 {
-                    // Last active workspace (Means we can still see it, since no other ws is active and thus is only visible)
-                    return System::WorkspaceStatus::Current;
+                    // Nothing to show or key it by
+                    continue;
                 }
+                callback(numbered ? workspace.id : 0, workspace.name, GetStatus(handle), noApps);
             }
+        }
 
-            const WaylandWorkspaceGroup& currentWorkspaceGroup = ::Wayland::GetWorkspaceGroups().at(workspaceIt->second.parent);
-            if (currentWorkspaceGroup.lastActiveWorkspace == workspaceIt->first)
+        bool GotoNamed(const std::string& name)
+        {
+            ::Wayland::WorkspaceGroupHandle group = GetPolledGroup();
+            for (auto& [handle, workspace] : ::Wayland::GetWorkspaces())
             {
-                return System::WorkspaceStatus::Visible;
+                if ((!group || workspace.parent == group) && workspace.name == name)
+                {
+                    return ::Wayland::ActivateWorkspace(handle);
+                }
             }
-            else
+            LOG("Wayland: Workspace " << name << " doesn't exist!");
+            return false;
+        }
+
+        // Returns false, if the protocol can't do it (Not bound or the compositor doesn't allow activation)
+        bool Goto(uint32_t workspaceId)
+        {
+            ::Wayland::WorkspaceHandle workspaceHandle = ::Wayland::GetWorkspaceById(GetPolledGroup(), workspaceId);
+            if (!workspaceHandle)
             {
-                return System::WorkspaceStatus::Inactive;
+                LOG("Wayland: Workspace " << workspaceId << " doesn't exist!");
+                return false;
+            }
+            return ::Wayland::ActivateWorkspace(workspaceHandle);
+        }
+
+        bool GotoNext(char direction, bool onMonitor)
+        {
+            const WaylandMonitor* monitor = ::Wayland::GetMonitor(lastPolledMonitor);
+            if (!monitor)
+            {
+                return false;
             }
+            auto& groups = ::Wayland::GetWorkspaceGroups();
+            auto groupIt = groups.find(monitor->workspaceGroup);
+            if (groupIt == groups.end() || !groupIt->second.lastActiveWorkspace)
+            {
+                return false;
+            }
+            ::Wayland::WorkspaceHandle current = groupIt->second.lastActiveWorkspace;
 
-            return System::WorkspaceStatus::Dead;
+            // Candidates in the order of their ids. Handles, since ids of different groups can be the same.
+            std::vector<std::pair<uint32_t, ::Wayland::WorkspaceHandle>> candidates;
+            for (auto& [handle, workspace] : ::Wayland::GetWorkspaces())
+            {
+                if (workspace.id == (uint32_t)-1 || (onMonitor && workspace.parent != monitor->workspaceGroup))
+                {
+                    continue;
+                }
+                candidates.emplace_back(workspace.id, handle);
+            }
+            std::sort(candidates.begin(), candidates.end());
+            auto currentIt = std::find_if(candidates.begin(), candidates.end(),
+                                          [&](const std::pair<uint32_t, ::Wayland::WorkspaceHandle>& candidate)
+                                          {
+                                              return candidate.second == current;
+                                          });
+            if (currentIt == candidates.end())
+            {
+                return false;
+            }
+            // Wrap around, like Hyprland does
+            size_t next = currentIt - candidates.begin();
+            if (direction == '+')
+            {
+                next = (next + 1) % candidates.size();
+            }
+            else
+            {
+                next = (next + candidates.size() - 1) % candidates.size();
+            }
+            return ::Wayland::ActivateWorkspace(candidates[next].second);
         }
     }
 
 #ifdef WITH_HYPRLAND
     namespace Hyprland
     {
-        void Init()
+        struct MonitorState
         {
-            if (!getenv("HYPRLAND_INSTANCE_SIGNATURE"))
+            int32_t id = -1;
+            int32_t activeWorkspace = -1;
+            // 0, if no special workspace is open on the monitor
+            int32_t specialWorkspace = 0;
+        };
+
+        // Kept up to date by the events of .socket2.sock. Only resynced (via .socket.sock) at startup and on reconnect.
+        // Id -> Name. Named workspaces have negative ids, special ones ids <= -98
+        static std::map<int32_t, std::string> workspaces;
+        static std::unordered_map<std::string, MonitorState> monitors;
+        static std::string focusedMonitor;
+        static System::WindowInfo activeWindow;
+
+        // Only tracked with WorkspaceIcons
+        struct Client
+        {
+            int32_t workspace;
+            std::string appId;
+        };
+        struct WorkspaceApps
+        {
+            // Number of windows per app-id
+            std::map<std::string, uint32_t> counts;
+            // Keys of counts
+            std::vector<std::string> list;
+        };
+        // By address (hex, without 0x)
+        static std::unordered_map<std::string, Client> clients;
+        static std::unordered_map<int32_t, WorkspaceApps> workspaceApps;
+
+        static int eventSocket = -1;
+        static guint eventSource = 0;
+        static guint reconnectSource = 0;
+        static std::string eventBuffer;
+
+        static uint32_t lastPolledMonitor = 0;
+
+        static bool ConnectEventSocket();
+
+        std::string GetSocketPath(const char* socketName)
+        {
+            const char* instanceSignature = getenv("HYPRLAND_INSTANCE_SIGNATURE");
+            // Newer Hyprland versions moved the sockets into XDG_RUNTIME_DIR
+            const char* runtimeDir = getenv("XDG_RUNTIME_DIR");
+            if (runtimeDir)
             {
-                LOG("Workspaces not running, disabling workspaces");
-                // Not available
-                RuntimeConfig::Get().hasWorkspaces = false;
+                std::string path = std::string(runtimeDir) + "/hypr/" + instanceSignature + "/" + socketName;
+                if (access(path.c_str(), F_OK) == 0)
+                {
+                    return path;
+                }
             }
+            return "/tmp/hypr/" + std::string(instanceSignature) + "/" + socketName;
         }
 
-        std::string DispatchIPC(const std::string& arg)
+        static bool FillAddress(sockaddr_un& addr)
         {
-            int hyprSocket = socket(AF_UNIX, SOCK_STREAM, 0);
-            const char* instanceSignature = getenv("HYPRLAND_INSTANCE_SIGNATURE");
-            std::string socketPath = "/tmp/hypr/" + std::string(instanceSignature) + "/.socket.sock";
-
-            sockaddr_un addr = {};
+            std::string socketPath = GetSocketPath(".socket.sock");
+            addr = {};
             addr.sun_family = AF_UNIX;
-            memcpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path));
+            if (socketPath.size() >= sizeof(addr.sun_path))
+            {
+                LOG("Hyprland socket path too long: " << socketPath);
+                return false;
+            }
+            memcpy(addr.sun_path, socketPath.c_str(), socketPath.size() + 1);
+            return true;
+        }
 
-            int ret = Utils::RetrySocketOp(
-                [&]()
-                {
-                    return connect(hyprSocket, (sockaddr*)&addr, SUN_LEN(&addr));
-                },
-                5, "connect");
-            if (ret < 0)
+        // Connects to the request socket and sends the request. Returns -1 on failure.
+        // Hyprland answers exactly one request per connection, so this can't be kept open.
+        static int SendRequest(const std::string& request)
+        {
+            sockaddr_un addr;
+            if (!FillAddress(addr))
+            {
+                return -1;
+            }
+            int hyprSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (hyprSocket < 0 || connect(hyprSocket, (sockaddr*)&addr, sizeof(addr)) < 0)
             {
                 LOG("Couldn't connect to Hyprland socket.");
-                return "";
+                if (hyprSocket >= 0)
+                    close(hyprSocket);
+                return -1;
             }
-
-            ssize_t written = Utils::RetrySocketOp(
-                [&]()
+            size_t written = 0;
+            while (written < request.size())
+            {
+                ssize_t ret = write(hyprSocket, request.data() + written, request.size() - written);
+                if (ret < 0 && errno == EINTR)
                 {
-                    return write(hyprSocket, arg.c_str(), arg.size());
-                },
-                5, "write");
-            if (written < 0)
+                    continue;
+                }
+                if (ret < 0)
+                {
+                    LOG("Couldn't write to Hyprland socket.");
+                    close(hyprSocket);
+                    return -1;
+                }
+                written += ret;
+            }
+            return hyprSocket;
+        }
+
+        // Blocking request, only used for resyncs.
+        std::string Request(const std::string& request)
+        {
+            int hyprSocket = SendRequest(request);
+            if (hyprSocket < 0)
             {
-                LOG("Couldn't write to Hyprland socket.");
                 return "";
             }
-            char buf[2056];
             std::string res;
-
+            size_t size = 0;
             while (true)
             {
-                ssize_t bytesRead = Utils::RetrySocketOp(
-                    [&]()
-                    {
-                        return read(hyprSocket, buf, sizeof(buf));
-                    },
-                    5, "read");
-                if (bytesRead == 0)
+                // Read straight into the result, instead of going through a temporary buffer
+                res.resize(size + 16 * 1024);
+                ssize_t bytesRead = read(hyprSocket, res.data() + size, res.size() - size);
+                if (bytesRead < 0 && errno == EINTR)
                 {
-                    break;
+                    continue;
                 }
                 if (bytesRead < 0)
                 {
                     LOG("Couldn't read from Hyprland socket.");
-                    return "";
+                    size = 0;
+                    break;
+                }
+                if (bytesRead == 0)
+                {
+                    break;
                 }
-                res += std::string(buf, bytesRead);
+                size += bytesRead;
             }
+            res.resize(size);
             close(hyprSocket);
             return res;
         }
 
-        static std::vector<System::WorkspaceStatus> workspaceStati;
+        // Sends a dispatcher (e.g. "workspace 2") without a hyprctl fork and without waiting for the reply.
+        void Dispatch(const std::string& dispatcher)
+        {
+            int hyprSocket = SendRequest("dispatch " + dispatcher);
+            if (hyprSocket < 0)
+            {
+                return;
+            }
+            // Check the reply, once it arrives. Hyprland closes the connection afterwards.
+            auto onReply = +[](int fd, GIOCondition, void*) -> int
+            {
+                char buf[256];
+                ssize_t len = read(fd, buf, sizeof(buf));
+                if (len > 0 && std::string_view(buf, len) != "ok")
+                {
+                    LOG("Hyprland dispatch failed: " << std::string_view(buf, len));
+                }
+                close(fd);
+                return G_SOURCE_REMOVE;
+            };
+            g_unix_fd_add(hyprSocket, (GIOCondition)(G_IO_IN | G_IO_HUP | G_IO_ERR), onReply, nullptr);
+        }
+
+        static void AddApp(int32_t workspace, const std::string& appId)
+        {
+            WorkspaceApps& apps = workspaceApps[workspace];
+            if (apps.counts[appId]++ == 0)
+            {
+                apps.list.insert(std::lower_bound(apps.list.begin(), apps.list.end(), appId), appId);
+            }
+        }
 
-        void PollStatus(uint32_t monitorID, uint32_t numWorkspaces)
+        static void RemoveApp(int32_t workspace, const std::string& appId)
         {
-            if (RuntimeConfig::Get().hasWorkspaces == false)
+            auto appsIt = workspaceApps.find(workspace);
+            if (appsIt == workspaceApps.end())
             {
-                LOG("Error: Polled workspace status, but Workspaces isn't open!");
                 return;
             }
-            workspaceStati.clear();
-            workspaceStati.resize(numWorkspaces, System::WorkspaceStatus::Dead);
+            WorkspaceApps& apps = appsIt->second;
+            auto countIt = apps.counts.find(appId);
+            if (countIt == apps.counts.end() || --countIt->second > 0)
+            {
+                return;
+            }
+            apps.counts.erase(countIt);
+            apps.list.erase(std::lower_bound(apps.list.begin(), apps.list.end(), appId));
+            if (apps.list.empty())
+            {
+                workspaceApps.erase(appsIt);
+            }
+        }
+
+        static void OpenClient(std::string_view address, int32_t workspace, std::string_view appId)
+        {
+            Client& client = clients[std::string(address)];
+            client.workspace = workspace;
+            client.appId = appId;
+            AddApp(client.workspace, client.appId);
+        }
+
+        static bool CloseClient(std::string_view address)
+        {
+            auto it = clients.find(std::string(address));
+            if (it == clients.end())
+            {
+                return false;
+            }
+            RemoveApp(it->second.workspace, it->second.appId);
+            clients.erase(it);
+            return true;
+        }
+
+        static bool MoveClient(std::string_view address, int32_t workspace)
+        {
+            auto it = clients.find(std::string(address));
+            if (it == clients.end() || it->second.workspace == workspace)
+            {
+                return false;
+            }
+            RemoveApp(it->second.workspace, it->second.appId);
+            it->second.workspace = workspace;
+            AddApp(it->second.workspace, it->second.appId);
+            return true;
+        }
 
-            size_t parseIdx = 0;
-            // First parse workspaces
-            std::string workspaces = DispatchIPC("/workspaces");
-            while ((parseIdx = workspaces.find("workspace ID ", parseIdx)) != std::string::npos)
+        // Full state from the request socket
+        void Resync()
+        {
+            // One connection for both
+            bool withClients = Config::Get().workspaceIcons;
+            std::string res = Request(withClients ? "[[BATCH]]j/workspaces;j/monitors;j/activewindow;j/clients" : "[[BATCH]]j/workspaces;j/monitors;j/activewindow");
+            std::vector<JSON::Value> replies;
+            if (!JSON::ParseAll(res, replies) || replies.size() != (withClients ? 4 : 3) || replies[0].type != JSON::Type::Array ||
+                replies[1].type != JSON::Type::Array)
             {
-                // Goto (
-                size_t begWSNum = workspaces.find('(', parseIdx) + 1;
-                size_t endWSNum = workspaces.find(')', begWSNum);
+                LOG("Invalid Hyprland IPC response, keeping the last workspace state!");
+                return;
+            }
 
-                std::string ws = workspaces.substr(begWSNum, endWSNum - begWSNum);
-                int32_t wsId = std::atoi(ws.c_str());
-                if (wsId >= 1 && wsId <= (int32_t)numWorkspaces)
+            workspaces.clear();
+            monitors.clear();
+            focusedMonitor.clear();
+            for (const JSON::Value& workspace : replies[0].elements)
+            {
+                workspaces[(int32_t)workspace.GetInt("id")] = JSON::Unescape(workspace.GetString("name"));
+            }
+            for (const JSON::Value& monitorValue : replies[1].elements)
+            {
+                std::string name(monitorValue.GetString("name"));
+                MonitorState& monitor = monitors[name];
+                monitor.id = (int32_t)monitorValue.GetInt("id", -1);
+                if (const JSON::Value* activeWorkspace = monitorValue.Get("activeWorkspace"))
+                {
+                    monitor.activeWorkspace = (int32_t)activeWorkspace->GetInt("id", -1);
+                }
+                if (const JSON::Value* specialWorkspace = monitorValue.Get("specialWorkspace"))
+                {
+                    monitor.specialWorkspace = (int32_t)specialWorkspace->GetInt("id", 0);
+                }
+                if (monitorValue.GetBool("focused"))
                 {
-                    // WS is at least inactive
-                    workspaceStati[wsId - 1] = System::WorkspaceStatus::Inactive;
+                    focusedMonitor = name;
                 }
-                parseIdx = endWSNum;
             }
+            // Empty object, if no window is focused
+            activeWindow.appId = JSON::Unescape(replies[2].GetString("class"));
+            activeWindow.title = JSON::Unescape(replies[2].GetString("title"));
+            windowCallbacks.Invoke();
 
-            // Parse active workspaces for monitor
-            std::string monitors = DispatchIPC("/monitors");
-            parseIdx = 0;
-            while ((parseIdx = monitors.find("Monitor ", parseIdx)) != std::string::npos)
+            clients.clear();
+            workspaceApps.clear();
+            if (withClients)
             {
-                // Goto ( and remove ID (=Advance 4 spaces, 1 for (, two for ID, one for space)
-                size_t begMonNum = monitors.find('(', parseIdx) + 4;
-                size_t endMonNum = monitors.find(')', begMonNum);
-                std::string mon = monitors.substr(begMonNum, endMonNum - begMonNum);
-                int32_t monIdx = std::atoi(mon.c_str());
+                for (const JSON::Value& client : replies[3].elements)
+                {
+                    std::string_view address = client.GetString("address");
+                    // The events don't have the prefix
+                    if (address.substr(0, 2) == "0x")
+                    {
+                        address.remove_prefix(2);
+                    }
+                    const JSON::Value* workspace = client.Get("workspace");
+                    OpenClient(address, workspace ? (int32_t)workspace->GetInt("id") : 0, JSON::Unescape(client.GetString("class")));
+                }
+            }
+        }
 
-                // Parse active workspace
-                parseIdx = monitors.find("active workspace: ", parseIdx);
-                ASSERT(parseIdx != std::string::npos, "Invalid IPC response!");
-                size_t begWSNum = monitors.find('(', parseIdx) + 1;
-                size_t endWSNum = monitors.find(')', begWSNum);
-                std::string ws = monitors.substr(begWSNum, endWSNum - begWSNum);
-                int32_t wsId = std::atoi(ws.c_str());
+        // Splits ID,NAME of the v2 events
+        static bool SplitIdName(std::string_view data, int32_t& id, std::string_view& name)
+        {
+            size_t comma = data.find(',');
+            if (comma == std::string_view::npos)
+            {
+                return false;
+            }
+            id = std::atoi(std::string(data.substr(0, comma)).c_str());
+            name = data.substr(comma + 1);
+            return true;
+        }
 
-                // Check if focused
-                parseIdx = monitors.find("focused: ", parseIdx);
-                ASSERT(parseIdx != std::string::npos, "Invalid IPC response!");
-                size_t begFocused = monitors.find(' ', parseIdx) + 1;
-                size_t endFocused = monitors.find('\n', begFocused);
-                bool focused = std::string_view(monitors).substr(begFocused, endFocused - begFocused) == "yes";
+        // 0, if there is no workspace with this name
+        static int32_t FindWorkspace(std::string_view name)
+        {
+            for (auto& [id, workspaceName] : workspaces)
+            {
+                if (workspaceName == name)
+                {
+                    return id;
+                }
+            }
+            return 0;
+        }
 
-                if (wsId >= 1 && wsId <= (int32_t)numWorkspaces)
+        // Returns true, if the state has changed
+        bool HandleEvent(std::string_view event, std::string_view data)
+        {
+            int32_t id;
+            std::string_view name;
+            if (event == "workspacev2")
+            {
+                // workspacev2>>ID,NAME: Focused monitor switched to this workspace
+                auto it = monitors.find(focusedMonitor);
+                if (it == monitors.end() || !SplitIdName(data, id, name))
                 {
-                    if ((uint32_t)monIdx == monitorID)
-                    {
-                        if (focused)
-                        {
-                            workspaceStati[wsId - 1] = System::WorkspaceStatus::Active;
-                        }
-                        else
-                        {
-                            workspaceStati[wsId - 1] = System::WorkspaceStatus::Current;
-                        }
-                    }
-                    else
-                    {
-                        workspaceStati[wsId - 1] = System::WorkspaceStatus::Visible;
-                    }
+                    return false;
+                }
+                it->second.activeWorkspace = id;
+                return true;
+            }
+            else if (event == "focusedmon")
+            {
+                // focusedmon>>MONNAME,WORKSPACENAME
+                size_t comma = data.find(',');
+                if (comma == std::string_view::npos)
+                {
+                    return false;
+                }
+                focusedMonitor = std::string(data.substr(0, comma));
+                auto it = monitors.find(focusedMonitor);
+                int32_t workspace = FindWorkspace(data.substr(comma + 1));
+                if (it == monitors.end() || workspace == 0)
+                {
+                    // We don't know this monitor/workspace yet
+                    Resync();
+                    return true;
+                }
+                it->second.activeWorkspace = workspace;
+                return true;
+            }
+            else if (event == "activespecial")
+            {
+                // activespecial>>NAME,MONNAME: NAME is empty, if the special workspace was closed
+                size_t comma = data.rfind(',');
+                if (comma == std::string_view::npos)
+                {
+                    return false;
+                }
+                auto it = monitors.find(std::string(data.substr(comma + 1)));
+                if (it == monitors.end())
+                {
+                    return false;
+                }
+                it->second.specialWorkspace = comma == 0 ? 0 : FindWorkspace(data.substr(0, comma));
+                return true;
+            }
+            else if (event == "createworkspacev2")
+            {
+                if (!SplitIdName(data, id, name))
+                {
+                    return false;
+                }
+                workspaces[id] = name;
+                return true;
+            }
+            else if (event == "destroyworkspacev2")
+            {
+                if (!SplitIdName(data, id, name))
+                {
+                    return false;
+                }
+                return workspaces.erase(id) != 0;
+            }
+            else if (event == "renameworkspace")
+            {
+                // renameworkspace>>ID,NEWNAME
+                if (!SplitIdName(data, id, name))
+                {
+                    return false;
+                }
+                auto it = workspaces.find(id);
+                if (it == workspaces.end())
+                {
+                    return false;
+                }
+                it->second = name;
+                return true;
+            }
+            else if (event == "activewindow")
+            {
+                // activewindow>>CLASS,TITLE. The title can contain commas, the class can't.
+                size_t comma = data.find(',');
+                if (comma == std::string_view::npos)
+                {
+                    return false;
+                }
+                std::string_view appId = data.substr(0, comma);
+                std::string_view title = data.substr(comma + 1);
+                if (appId != activeWindow.appId || title != activeWindow.title)
+                {
+                    activeWindow.appId = appId;
+                    activeWindow.title = title;
+                    windowCallbacks.Invoke();
+                }
+                // Doesn't affect the workspaces
+                return false;
+            }
+            else if (event == "openwindow")
+            {
+                // openwindow>>ADDRESS,WORKSPACENAME,CLASS,TITLE
+                size_t firstComma = data.find(',');
+                size_t secondComma = firstComma == std::string_view::npos ? firstComma : data.find(',', firstComma + 1);
+                size_t thirdComma = secondComma == std::string_view::npos ? secondComma : data.find(',', secondComma + 1);
+                if (!Config::Get().workspaceIcons || thirdComma == std::string_view::npos)
+                {
+                    return false;
+                }
+                int32_t workspace = FindWorkspace(data.substr(firstComma + 1, secondComma - firstComma - 1));
+                OpenClient(data.substr(0, firstComma), workspace, data.substr(secondComma + 1, thirdComma - secondComma - 1));
+                return true;
+            }
+            else if (event == "closewindow")
+            {
+                // closewindow>>ADDRESS
+                return Config::Get().workspaceIcons && CloseClient(data);
+            }
+            else if (event == "movewindowv2")
+            {
+                // movewindowv2>>ADDRESS,WORKSPACEID,WORKSPACENAME
+                size_t comma = data.find(',');
+                if (!Config::Get().workspaceIcons || comma == std::string_view::npos)
+                {
+                    return false;
                 }
+                std::string_view name;
+                return SplitIdName(data.substr(comma + 1), id, name) && MoveClient(data.substr(0, comma), id);
+            }
+            else if (event == "moveworkspace" || event == "monitoradded" || event == "monitorremoved")
+            {
+                // Rare, so just ask for the full state
+                Resync();
+                return true;
             }
+            return false;
         }
 
-        System::WorkspaceStatus GetStatus(uint32_t workspaceId)
+        void CloseEventSocket()
         {
-            if (RuntimeConfig::Get().hasWorkspaces == false)
+            if (eventSource)
             {
-                LOG("Error: Queried for workspace status, but Workspaces isn't open!");
-                return System::WorkspaceStatus::Dead;
+                g_source_remove(eventSource);
+                eventSource = 0;
+            }
+            if (eventSocket >= 0)
+            {
+                close(eventSocket);
+                eventSocket = -1;
             }
-            ASSERT(workspaceId > 0 && workspaceId <= workspaceStati.size(), "Invalid workspaceId, you need to poll the workspace first!");
-            return workspaceStati[workspaceId - 1];
+            eventBuffer.clear();
         }
-    }
-#endif
 
-    void Init()
-    {
-#ifdef WITH_HYPRLAND
-        if (Config::Get().useHyprlandIPC)
+        void ScheduleReconnect()
         {
-            Hyprland::Init();
-            return;
+            if (reconnectSource)
+            {
+                return;
+            }
+            reconnectSource = g_timeout_add(
+                1000,
+                +[](void*) -> int
+                {
+                    if (ConnectEventSocket())
+                    {
+                        reconnectSource = 0;
+                        return false;
+                    }
+                    return true;
+                },
+                nullptr);
         }
-#endif
-    }
 
-    void PollStatus(uint32_t monitorID, uint32_t numWorkspaces)
-    {
-#ifdef WITH_HYPRLAND
-        if (Config::Get().useHyprlandIPC)
+        int OnEvents(int fd, GIOCondition, void*)
         {
-            Hyprland::PollStatus(monitorID, numWorkspaces);
-            return;
+            char buf[4096];
+            bool changed = false;
+            while (true)
+            {
+                ssize_t len = read(fd, buf, sizeof(buf));
+                if (len > 0)
+                {
+                    eventBuffer.append(buf, len);
+                    continue;
+                }
+                if (len < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                {
+                    break;
+                }
+                // Hyprland went away (e.g. restart)
+                LOG("Hyprland event socket closed, reconnecting");
+                // The source is removed by returning G_SOURCE_REMOVE
+                eventSource = 0;
+                CloseEventSocket();
+                ScheduleReconnect();
+                changeCallbacks.Invoke();
+                return G_SOURCE_REMOVE;
+            }
+
+            // Events are EVENT>>DATA\n
+            size_t lineStart = 0;
+            size_t newline;
+            while ((newline = eventBuffer.find('\n', lineStart)) != std::string::npos)
+            {
+                std::string_view line = std::string_view(eventBuffer).substr(lineStart, newline - lineStart);
+                size_t separator = line.find(">>");
+                if (separator != std::string_view::npos)
+                {
+                    changed |= HandleEvent(line.substr(0, separator), line.substr(separator + 2));
+                }
+                lineStart = newline + 1;
+            }
+            eventBuffer.erase(0, lineStart);
+
+            // One update per batch of events
+            if (changed)
+            {
+                changeCallbacks.Invoke();
+            }
+            return G_SOURCE_CONTINUE;
         }
-#endif
-        Wayland::PollStatus(monitorID, numWorkspaces);
-    }
 
-    System::WorkspaceStatus GetStatus(uint32_t workspaceId)
-    {
-#ifdef WITH_HYPRLAND
-        if (Config::Get().useHyprlandIPC)
+        static bool ConnectEventSocket()
         {
-            return Hyprland::GetStatus(workspaceId);
+            std::string socketPath = GetSocketPath(".socket2.sock");
+            sockaddr_un addr = {};
+            addr.sun_family = AF_UNIX;
+            strncpy(addr.sun_path, socketPath.c_str(), sizeof(addr.sun_path) - 1);
+
+            eventSocket = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (connect(eventSocket, (sockaddr*)&addr, SUN_LEN(&addr)) < 0)
+            {
+                LOG("Couldn't connect to Hyprland event socket.");
+                close(eventSocket);
+                eventSocket = -1;
+                return false;
+            }
+            fcntl(eventSocket, F_SETFL, fcntl(eventSocket, F_GETFL) | O_NONBLOCK);
+            eventSource = g_unix_fd_add(eventSocket, (GIOCondition)(G_IO_IN | G_IO_HUP | G_IO_ERR), OnEvents, nullptr);
+
+            // Subscribe first, so no event between the resync and the subscription is lost.
+            Resync();
+            changeCallbacks.Invoke();
+            return true;
         }
-#endif
-        return Wayland::GetStatus(workspaceId);
-    }
 
-    void Shutdown() {}
+        void Init()
+        {
+            if (!getenv("HYPRLAND_INSTANCE_SIGNATURE"))
+            {
+                LOG("Workspaces not running, disabling workspaces");
+                // Not available
+                RuntimeConfig::Get().hasWorkspaces = false;
+                return;
+            }
+            if (!ConnectEventSocket())
+            {
+                ScheduleReconnect();
+            }
+        }
+
+        void Shutdown()
+        {
+            if (reconnectSource)
+            {
+                g_source_remove(reconnectSource);
+                reconnectSource = 0;
+            }
+            CloseEventSocket();
+        }
+
+        void PollStatus(uint32_t monitorID)
+        {
+            if (RuntimeConfig::Get().hasWorkspaces == false)
+            {
+                LOG("Error: Polled workspace status, but Workspaces isn't open!");
+                return;
+            }
+            // Nothing to poll, the state is kept up to date by the events.
+            lastPolledMonitor = monitorID;
+        }
+
+        // Hyprland's monitor ids aren't the GdkMonitor indices after hotplugging, the connector names always match
+        static bool IsPolledMonitor(const std::string& name, const MonitorState& monitor)
+        {
+            const ::Wayland::Monitor* polled = ::Wayland::GetMonitor(lastPolledMonitor);
+            if (polled && !polled->name.empty())
+            {
+                return polled->name == name;
+            }
+            return (uint32_t)monitor.id == lastPolledMonitor;
+        }
+
+        System::WorkspaceStatus GetStatus(int32_t workspaceId)
+        {
+            for (auto& [name, monitor] : monitors)
+            {
+                if (monitor.activeWorkspace != workspaceId && monitor.specialWorkspace != workspaceId)
+                {
+                    continue;
+                }
+                if (!IsPolledMonitor(name, monitor))
+                {
+                    return System::WorkspaceStatus::Visible;
+                }
+                return name == focusedMonitor ? System::WorkspaceStatus::Active : System::WorkspaceStatus::Current;
+            }
+            return System::WorkspaceStatus::Inactive;
+        }
+
+        void GetWorkspaces(const WorkspaceFn& callback)
+        {
+            if (RuntimeConfig::Get().hasWorkspaces == false)
+            {
+                LOG("Error: Queried for workspace status, but Workspaces isn't open!");
+                return;
+            }
+            for (auto& [id, name] : workspaces)
+            {
+                auto appsIt = workspaceApps.find(id);
+                callback(id > 0 ? id : 0, name, GetStatus(id), appsIt != workspaceApps.end() ? appsIt->second.list : noApps);
+            }
+        }
+
+        void GotoNamed(const std::string& name)
+        {
+            // Special workspaces are called special:NAME (or just special)
+            if (name.rfind("special", 0) == 0)
+            {
+                Dispatch("togglespecialworkspace " + (name.size() > 8 ? name.substr(8) : ""));
+                return;
+            }
+            Dispatch("workspace name:" + name);
+        }
+    }
+#endif
+
+#ifdef WITH_SWAY
+    // i3 IPC, as spoken by sway. See sway-ipc(7)
+    namespace Sway
+    {
+        enum MessageType : uint32_t
+        {
+            MessageRunCommand = 0,
+            MessageGetWorkspaces = 1,
+            MessageSubscribe = 2,
+            // Events have the highest bit set
+            EventWorkspace = 0x80000000,
+            EventOutput = 0x80000001,
+        };
+
+        // "i3-ipc" + payload length + type, both in native byte order
+        static constexpr char magic[] = {'i', '3', '-', 'i', 'p', 'c'};
+        static constexpr size_t headerSize = sizeof(magic) + 2 * sizeof(uint32_t);
+
+        struct WorkspaceState
+        {
+            // -1 for named workspaces
+            int32_t num = -1;
+            std::string output;
+            bool visible = false;
+            bool focused = false;
+        };
+
+        struct Connection
+        {
+            int fd = -1;
+            guint source = 0;
+            std::string buffer;
+        };
+
+        // Kept up to date by the events. Keyed by workspace name, since not all workspaces have a number
+        static std::map<std::string, WorkspaceState, std::less<>> workspaces;
+
+        // Subscribed to workspace and output events
+        static Connection eventConnection;
+        // Commands and resyncs. The replies arrive in order, so we only need to remember what we've asked for.
+        static Connection commandConnection;
+        static std::deque<MessageType> pendingReplies;
+
+        static guint reconnectSource = 0;
+        static uint32_t lastPolledMonitor = 0;
+
+        static bool ConnectEventSocket();
+        static int OnEvents(int fd, GIOCondition, void*);
+        static int OnCommandReply(int fd, GIOCondition, void*);
+
+        static void CloseConnection(Connection& connection)
+        {
+            if (connection.source)
+            {
+                g_source_remove(connection.source);
+                connection.source = 0;
+            }
+            if (connection.fd >= 0)
+            {
+                close(connection.fd);
+                connection.fd = -1;
+            }
+            connection.buffer.clear();
+        }
+
+        static bool Connect(Connection& connection, GUnixFDSourceFunc callback)
+        {
+            const char* socketPath = getenv("SWAYSOCK");
+            sockaddr_un addr = {};
+            addr.sun_family = AF_UNIX;
+            if (!socketPath || strlen(socketPath) >= sizeof(addr.sun_path))
+            {
+                LOG("Sway: Invalid SWAYSOCK");
+                return false;
+            }
+            strcpy(addr.sun_path, socketPath);
+
+            connection.fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+            if (connection.fd < 0 || connect(connection.fd, (sockaddr*)&addr, sizeof(addr)) < 0)
+            {
+                LOG("Sway: Couldn't connect to " << socketPath);
+                if (connection.fd >= 0)
+                    close(connection.fd);
+                connection.fd = -1;
+                return false;
+            }
+            connection.source = g_unix_fd_add(connection.fd, (GIOCondition)(G_IO_IN | G_IO_HUP | G_IO_ERR), callback, nullptr);
+            return true;
+        }
+
+        // Messages are tiny, so the socket buffer always has room. Writes are blocking, reads happen from the main loop.
+        static bool Send(Connection& connection, MessageType type, std::string_view payload)
+        {
+            std::string message(headerSize + payload.size(), '\0');
+            uint32_t length = payload.size();
+            memcpy(message.data(), magic, sizeof(magic));
+            memcpy(message.data() + sizeof(magic), &length, sizeof(length));
+            memcpy(message.data() + sizeof(magic) + sizeof(length), &type, sizeof(type));
+            memcpy(message.data() + headerSize, payload.data(), payload.size());
+
+            size_t written = 0;
+            while (written < message.size())
+            {
+                ssize_t ret = send(connection.fd, message.data() + written, message.size() - written, MSG_NOSIGNAL);
+                if (ret < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (ret < 0)
+                {
+                    LOG("Sway: Couldn't write to socket: " << strerror(errno));
+                    return false;
+                }
+                written += ret;
+            }
+            return true;
+        }
+
+        // Reads everything available and calls handler for each complete message. Returns false, if the connection is gone.
+        template<typename Handler>
+        static bool ReadMessages(Connection& connection, Handler&& handler)
+        {
+            char buf[4096];
+            bool alive = true;
+            while (true)
+            {
+                ssize_t len = recv(connection.fd, buf, sizeof(buf), MSG_DONTWAIT);
+                if (len > 0)
+                {
+                    connection.buffer.append(buf, len);
+                    continue;
+                }
+                if (len < 0 && errno == EINTR)
+                {
+                    continue;
+                }
+                if (len < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                {
+                    break;
+                }
+                alive = false;
+                break;
+            }
+
+            size_t pos = 0;
+            while (connection.buffer.size() - pos >= headerSize)
+            {
+                if (memcmp(connection.buffer.data() + pos, magic, sizeof(magic)) != 0)
+                {
+                    LOG("Sway: Invalid message, dropping the connection");
+                    return false;
+                }
+                uint32_t length;
+                uint32_t type;
+                memcpy(&length, connection.buffer.data() + pos + sizeof(magic), sizeof(length));
+                memcpy(&type, connection.buffer.data() + pos + sizeof(magic) + sizeof(length), sizeof(type));
+                if (connection.buffer.size() - pos - headerSize < length)
+                {
+                    // Wait for the rest
+                    break;
+                }
+                handler((MessageType)type, std::string_view(connection.buffer).substr(pos + headerSize, length));
+                pos += headerSize + length;
+            }
+            connection.buffer.erase(0, pos);
+            return alive;
+        }
+
+        static bool EnsureCommandConnection()
+        {
+            if (commandConnection.fd >= 0)
+            {
+                return true;
+            }
+            pendingReplies.clear();
+            return Connect(commandConnection, OnCommandReply);
+        }
+
+        static void SendCommand(MessageType type, std::string_view payload)
+        {
+            if (!EnsureCommandConnection())
+            {
+                return;
+            }
+            if (!Send(commandConnection, type, payload))
+            {
+                CloseConnection(commandConnection);
+                return;
+            }
+            pendingReplies.push_back(type);
+        }
+
+        // Full state. The reply arrives asynchronously
+        void Resync()
+        {
+            SendCommand(MessageGetWorkspaces, "");
+        }
+
+        static void ApplyWorkspaces(std::string_view reply)
+        {
+            JSON::Value value;
+            if (!JSON::Parse(reply, value) || value.type != JSON::Type::Array)
+            {
+                LOG("Sway: Invalid workspace reply, keeping the last workspace state!");
+                return;
+            }
+            workspaces.clear();
+            for (const JSON::Value& workspace : value.elements)
+            {
+                WorkspaceState& state = workspaces[JSON::Unescape(workspace.GetString("name"))];
+                state.num = (int32_t)workspace.GetInt("num", -1);
+                state.output = JSON::Unescape(workspace.GetString("output"));
+                state.visible = workspace.GetBool("visible");
+                state.focused = workspace.GetBool("focused");
+            }
+        }
+
+        static int OnCommandReply(int fd, GIOCondition, void*)
+        {
+            bool changed = false;
+            bool alive = ReadMessages(commandConnection,
+                                      [&](MessageType type, std::string_view payload)
+                                      {
+                                          if (pendingReplies.empty() || pendingReplies.front() != type)
+                                          {
+                                              LOG("Sway: Unexpected reply of type " << type);
+                                              return;
+                                          }
+                                          pendingReplies.pop_front();
+                                          if (type == MessageGetWorkspaces)
+                                          {
+                                              ApplyWorkspaces(payload);
+                                              changed = true;
+                                          }
+                                          else if (type == MessageRunCommand && payload.find("\"success\": false") != std::string_view::npos)
+                                          {
+                                              LOG("Sway: Command failed: " << payload);
+                                          }
+                                      });
+            if (changed)
+            {
+                changeCallbacks.Invoke();
+            }
+            if (!alive)
+            {
+                // Reconnected with the next command. The source is removed by returning G_SOURCE_REMOVE
+                commandConnection.source = 0;
+                CloseConnection(commandConnection);
+                return G_SOURCE_REMOVE;
+            }
+            return G_SOURCE_CONTINUE;
+        }
+
+        // Returns true, if the state has changed
+        bool HandleWorkspaceEvent(std::string_view payload)
+        {
+            JSON::Value event;
+            if (!JSON::Parse(payload, event))
+            {
+                return false;
+            }
+            std::string_view change = event.GetString("change");
+            const JSON::Value* current = event.Get("current");
+            if (!current)
+            {
+                return false;
+            }
+            // json-c escapes e.g. '/' as "\/"
+            std::string name = JSON::Unescape(current->GetString("name"));
+            if (change == "focus")
+            {
+                std::string output = JSON::Unescape(current->GetString("output"));
+                for (auto& [id, workspace] : workspaces)
+                {
+                    workspace.focused = false;
+                    // Only one workspace per output is visible
+                    if (workspace.output == output)
+                    {
+                        workspace.visible = false;
+                    }
+                }
+                WorkspaceState& workspace = workspaces[name];
+                workspace.num = (int32_t)current->GetInt("num", -1);
+                workspace.output = output;
+                workspace.visible = true;
+                workspace.focused = true;
+                return true;
+            }
+            else if (change == "init")
+            {
+                WorkspaceState& workspace = workspaces[name];
+                workspace.num = (int32_t)current->GetInt("num", -1);
+                workspace.output = JSON::Unescape(current->GetString("output"));
+                return true;
+            }
+            else if (change == "empty")
+            {
+                auto it = workspaces.find(name);
+                if (it == workspaces.end())
+                {
+                    return false;
+                }
+                workspaces.erase(it);
+                return true;
+            }
+            else if (change == "move" || change == "rename" || change == "reload")
+            {
+                // Rare, so just ask for the full state
+                Resync();
+            }
+            return false;
+        }
+
+        void ScheduleReconnect()
+        {
+            if (reconnectSource)
+            {
+                return;
+            }
+            reconnectSource = g_timeout_add(
+                1000,
+                +[](void*) -> int
+                {
+                    if (ConnectEventSocket())
+                    {
+                        reconnectSource = 0;
+                        return false;
+                    }
+                    return true;
+                },
+                nullptr);
+        }
+
+        static int OnEvents(int fd, GIOCondition, void*)
+        {
+            bool changed = false;
+            bool alive = ReadMessages(eventConnection,
+                                      [&](MessageType type, std::string_view payload)
+                                      {
+                                          if (type == EventWorkspace)
+                                          {
+                                              changed |= HandleWorkspaceEvent(payload);
+                                          }
+                                          else if (type == EventOutput)
+                                          {
+                                              // Outputs added/removed. Workspaces might have moved.
+                                              Resync();
+                                          }
+                                          // Otherwise the reply to our subscribe
+                                      });
+            // One update per batch of events
+            if (changed)
+            {
+                changeCallbacks.Invoke();
+            }
+            if (!alive)
+            {
+                // Sway went away (e.g. restart)
+                LOG("Sway event socket closed, reconnecting");
+                // The source is removed by returning G_SOURCE_REMOVE
+                eventConnection.source = 0;
+                CloseConnection(eventConnection);
+                CloseConnection(commandConnection);
+                ScheduleReconnect();
+                changeCallbacks.Invoke();
+                return G_SOURCE_REMOVE;
+            }
+            return G_SOURCE_CONTINUE;
+        }
+
+        static bool ConnectEventSocket()
+        {
+            if (!Connect(eventConnection, OnEvents))
+            {
+                return false;
+            }
+            if (!Send(eventConnection, MessageSubscribe, "[\"workspace\",\"output\"]"))
+            {
+                CloseConnection(eventConnection);
+                return false;
+            }
+            // Subscribe first, so no event between the resync and the subscription is lost.
+            Resync();
+            return true;
+        }
+
+        void Init()
+        {
+            if (!getenv("SWAYSOCK"))
+            {
+                LOG("Sway not running, disabling workspaces");
+                // Not available
+                RuntimeConfig::Get().hasWorkspaces = false;
+                return;
+            }
+            if (!ConnectEventSocket())
+            {
+                ScheduleReconnect();
+            }
+        }
+
+        void Shutdown()
+        {
+            if (reconnectSource)
+            {
+                g_source_remove(reconnectSource);
+                reconnectSource = 0;
+            }
+            CloseConnection(eventConnection);
+            CloseConnection(commandConnection);
+            pendingReplies.clear();
+        }
+
+        void PollStatus(uint32_t monitorID)
+        {
+            // Nothing to poll, the state is kept up to date by the events.
+            lastPolledMonitor = monitorID;
+        }
+
+        System::WorkspaceStatus GetStatus(const WorkspaceState& workspace)
+        {
+            if (!workspace.visible)
+            {
+                return System::WorkspaceStatus::Inactive;
+            }
+            // Sway only knows output names, the bar knows the wayland monitor
+            const ::Wayland::Monitor* monitor = ::Wayland::GetMonitor(lastPolledMonitor);
+            if (!monitor || monitor->name != workspace.output)
+            {
+                return System::WorkspaceStatus::Visible;
+            }
+            return workspace.focused ? System::WorkspaceStatus::Active : System::WorkspaceStatus::Current;
+        }
+
+        void GetWorkspaces(const WorkspaceFn& callback)
+        {
+            for (auto& [name, workspace] : workspaces)
+            {
+                callback(workspace.num > 0 ? workspace.num : 0, name, GetStatus(workspace), noApps);
+            }
+        }
+
+        void Goto(uint32_t workspace)
+        {
+            SendCommand(MessageRunCommand, "workspace number " + std::to_string(workspace));
+        }
+
+        void GotoNamed(const std::string& name)
+        {
+            // Quoted argument of the sway command, so '"' and '\' need a backslash
+            std::string quoted;
+            for (char c : name)
+            {
+                if (c == '"' || c == '\\')
+                {
+                    quoted += '\\';
+                }
+                quoted += c;
+            }
+            SendCommand(MessageRunCommand, "workspace \"" + quoted + "\"");
+        }
+
+        void GotoNext(char direction, bool onMonitor)
+        {
+            std::string command = direction == '+' ? "workspace next" : "workspace prev";
+            if (onMonitor)
+            {
+                command += "_on_output";
+            }
+            SendCommand(MessageRunCommand, command);
+        }
+    }
+#endif
+
+    static uint32_t waylandCallback = 0;
+
+    void Init()
+    {
+#ifdef WITH_SWAY
+        if (Config::Get().useSwayIPC)
+        {
+            Sway::Init();
+            return;
+        }
+#endif
+#ifdef WITH_HYPRLAND
+        if (Config::Get().useHyprlandIPC)
+        {
+            Hyprland::Init();
+            return;
+        }
+#endif
+        // Forward the batched changes of the compositor
+        waylandCallback = ::Wayland::AddWorkspaceCallback(
+            []()
+            {
+                changeCallbacks.Invoke();
+            });
+    }
+
+    void PollStatus(uint32_t monitorID)
+    {
+#ifdef WITH_SWAY
+        if (Config::Get().useSwayIPC)
+        {
+            Sway::PollStatus(monitorID);
+            return;
+        }
+#endif
+#ifdef WITH_HYPRLAND
+        if (Config::Get().useHyprlandIPC)
+        {
+            Hyprland::PollStatus(monitorID);
+            return;
+        }
+#endif
+        Wayland::PollStatus(monitorID);
+    }
+
+    void GetWorkspaces(const WorkspaceFn& callback)
+    {
+#ifdef WITH_SWAY
+        if (Config::Get().useSwayIPC)
+        {
+            Sway::GetWorkspaces(callback);
+            return;
+        }
+#endif
+#ifdef WITH_HYPRLAND
+        if (Config::Get().useHyprlandIPC)
+        {
+            Hyprland::GetWorkspaces(callback);
+            return;
+        }
+#endif
+        Wayland::GetWorkspaces(callback);
+    }
+
+    void Goto(uint32_t workspace)
+    {
+        if (RuntimeConfig::Get().hasWorkspaces == false)
+        {
+            LOG("Error: Called Go to workspace, but Workspaces isn't open!");
+            return;
+        }
+#ifdef WITH_SWAY
+        if (Config::Get().useSwayIPC)
+        {
+            Sway::Goto(workspace);
+            return;
+        }
+#endif
+        if (!Config::Get().useHyprlandIPC && Wayland::Goto(workspace))
+        {
+            return;
+        }
+#ifdef WITH_HYPRLAND
+        if (getenv("HYPRLAND_INSTANCE_SIGNATURE"))
+        {
+            Hyprland::Dispatch("workspace " + std::to_string(workspace));
+            return;
+        }
+#endif
+        LOG("Error: The compositor doesn't allow switching workspaces!");
+    }
+
+    void GotoNamed(const std::string& name)
+    {
+        if (RuntimeConfig::Get().hasWorkspaces == false)
+        {
+            LOG("Error: Called Go to workspace, but Workspaces isn't open!");
+            return;
+        }
+#ifdef WITH_SWAY
+        if (Config::Get().useSwayIPC)
+        {
+            Sway::GotoNamed(name);
+            return;
+        }
+#endif
+        if (!Config::Get().useHyprlandIPC && Wayland::GotoNamed(name))
+        {
+            return;
+        }
+#ifdef WITH_HYPRLAND
+        if (getenv("HYPRLAND_INSTANCE_SIGNATURE"))
+        {
+            Hyprland::GotoNamed(name);
+            return;
+        }
+#endif
+        LOG("Error: The compositor doesn't allow switching workspaces!");
+    }
+
+    void GotoNext(char direction)
+    {
+#ifdef WITH_SWAY
+        if (Config::Get().useSwayIPC)
+        {
+            Sway::GotoNext(direction, Config::Get().workspaceScrollOnMonitor);
+            return;
+        }
+#endif
+        if (!Config::Get().useHyprlandIPC && Wayland::GotoNext(direction, Config::Get().workspaceScrollOnMonitor))
+        {
+            return;
+        }
+#ifdef WITH_HYPRLAND
+        char scrollOp = 'e';
+        if (Config::Get().workspaceScrollOnMonitor)
+        {
+            scrollOp = 'm';
+        }
+        if (getenv("HYPRLAND_INSTANCE_SIGNATURE"))
+        {
+            Hyprland::Dispatch(std::string("workspace ") + scrollOp + direction + "1");
+            return;
+        }
+#endif
+        LOG("Error: The compositor doesn't allow switching workspaces!");
+    }
+
+    System::WindowInfo GetActiveWindow()
+    {
+#ifdef WITH_HYPRLAND
+        if (Config::Get().useHyprlandIPC)
+        {
+            return Hyprland::activeWindow;
+        }
+#endif
+        return {};
+    }
+
+    uint32_t AddActiveWindowCallback(std::function<void()>&& callback)
+    {
+        return windowCallbacks.Add(std::move(callback));
+    }
+
+    void RemoveActiveWindowCallback(uint32_t handle)
+    {
+        windowCallbacks.Remove(handle);
+    }
+
+    uint32_t AddChangeCallback(std::function<void()>&& callback)
+    {
+        return changeCallbacks.Add(std::move(callback));
+    }
+
+    void RemoveChangeCallback(uint32_t handle)
+    {
+        changeCallbacks.Remove(handle);
+    }
+
+    void Shutdown()
+    {
+#ifdef WITH_SWAY
+        if (Config::Get().useSwayIPC)
+        {
+            Sway::Shutdown();
+            return;
+        }
+#endif
+#ifdef WITH_HYPRLAND
+        if (Config::Get().useHyprlandIPC)
+        {
+            Hyprland::Shutdown();
+            return;
+        }
+#endif
+        if (waylandCallback)
+        {
+            ::Wayland::RemoveWorkspaceCallback(waylandCallback);
+            waylandCallback = 0;
+        }
+    }
 }
 #endif
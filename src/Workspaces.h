@@ -16,35 +16,33 @@ namespace Workspaces
 {
     void Init();
 
-    void PollStatus(uint32_t monitorID, uint32_t numWorkspaces);
+    // id is 0 for workspaces without a number. apps are the sorted, unique app-ids of the windows on the workspace (Hyprland only)
+    using WorkspaceFn =
+        std::function<void(uint32_t id, std::string_view name, System::WorkspaceStatus status, const std::vector<std::string>& apps)>;
 
-    System::WorkspaceStatus GetStatus(uint32_t workspaceId);
+    // Selects the monitor, the status of GetWorkspaces is relative to.
+    void PollStatus(uint32_t monitorID);
+
+    // Calls the callback for every existing workspace
+    void GetWorkspaces(const WorkspaceFn& callback);
+
+    // Called from the main loop, when the workspace state might have changed. Poll the status afterwards.
+    uint32_t AddChangeCallback(std::function<void()>&& callback);
+    void RemoveChangeCallback(uint32_t handle);
+
+    // Focused window. Only reported by the Hyprland backend, the others leave it to wlr-foreign-toplevel-management.
+    System::WindowInfo GetActiveWindow();
+    uint32_t AddActiveWindowCallback(std::function<void()>&& callback);
+    void RemoveActiveWindowCallback(uint32_t handle);
 
     void Shutdown();
 
-    // TODO: Use ext_workspaces for this, if applicable
-    inline void Goto(uint32_t workspace)
-    {
-        if (RuntimeConfig::Get().hasWorkspaces == false)
-        {
-            LOG("Error: Called Go to workspace, but Workspaces isn't open!");
-            return;
-        }
-        LOG("Switching workspace: hyprctl dispatch workspace " << workspace);
-        system(("hyprctl dispatch workspace " + std::to_string(workspace)).c_str());
-    }
+    // Uses the workspace protocol, if the compositor allows activation. Falls back to Hyprland's IPC otherwise.
+    void Goto(uint32_t workspace);
+    // Named or special workspaces
+    void GotoNamed(const std::string& name);
 
     // direction: + or -
-    inline void GotoNext(char direction)
-    {
-        char scrollOp = 'e';
-        if (Config::Get().workspaceScrollOnMonitor)
-        {
-            scrollOp = 'm';
-        }
-        std::string cmd = std::string("hyprctl dispatch workspace ") + scrollOp + direction + "1";
-        LOG("Switching workspace: " << cmd.c_str());
-        system(cmd.c_str());
-    }
+    void GotoNext(char direction);
 }
 #endif
@@ -4,6 +4,10 @@
 #include "Bar.h"
 #include "AudioFlyin.h"
 #include "BluetoothDevices.h"
+#include "Mixer.h"
+#include "OSD.h"
+#include "Control.h"
+#include "CSS.h"
 #include "Plugin.h"
 #include "Config.h"
 
@@ -13,6 +17,7 @@
 
 const char* audioTmpFilePath = "/tmp/gBar__audio";
 const char* bluetoothTmpFilePath = "/tmp/gBar__bluetooth";
+const char* mixerTmpFilePath = "/tmp/gBar__mixer";
 
 static bool tmpFileOpen = false;
 
@@ -33,12 +38,61 @@ void OpenAudioFlyin(Window& window, int32_t monitor, AudioFlyin::Type type)
     }
 }
 
+// Sends the command to the running bar. Returns false, if there is no bar to handle it.
+bool SendToBar(const std::string& command, bool printResponse)
+{
+    std::string response;
+    bool ok = Control::Send(command, response);
+    if (printResponse)
+    {
+        std::cout << response;
+    }
+    return ok;
+}
+
+void InitControl()
+{
+    Control::Init();
+    Control::AddCommand("reload",
+                        [](const std::vector<std::string_view>& args, std::string& response)
+                        {
+                            if (args.size() == 2 && args[1] == "css")
+                            {
+                                if (!CSS::Reload())
+                                {
+                                    response = "failed loading css";
+                                    return false;
+                                }
+                                return true;
+                            }
+                            if (args.size() == 2 && args[1] == "config")
+                            {
+                                // Only affects things, that read the config at runtime. Layout changes need a restart.
+                                Config::Reload();
+                                return true;
+                            }
+                            response = "usage: reload css|config";
+                            return false;
+                        });
+
+    auto setBrightness = [](double brightness)
+    {
+        Control::SetMetric("brightness", Utils::ToStringPrecision(brightness * 100, "%0.0f"));
+    };
+    if (System::GetBrightness() >= 0)
+    {
+        setBrightness(System::GetBrightness());
+    }
+    System::AddBrightnessCallback(setBrightness);
+}
+
 void CloseTmpFiles(int sig)
 {
     if (tmpFileOpen)
     {
         remove(audioTmpFilePath);
         remove(bluetoothTmpFilePath);
+        remove(mixerTmpFilePath);
     }
     if (sig != 0)
         exit(1);
@@ -46,21 +100,61 @@ void CloseTmpFiles(int sig)
 
 int main(int argc, char** argv)
 {
+    ASSERT(argc >= 2, "Too little arguments!");
+    // These don't need a window, so handle them before the expensive initialization
+    if (strcmp(argv[1], "ctl") == 0)
+    {
+        std::string command;
+        for (int i = 2; i < argc; i++)
+        {
+            command += std::string(i == 2 ? "" : " ") + argv[i];
+        }
+        return SendToBar(command, true) ? 0 : 1;
+    }
+    else if (strcmp(argv[1], "audio") == 0 && SendToBar("osd volume", false))
+    {
+        return 0;
+    }
+    else if (strcmp(argv[1], "mic") == 0 && SendToBar("osd mic", false))
+    {
+        return 0;
+    }
+
+    // bar --all: One bar per monitor, driven by this process. Follows monitor hotplugging.
+    bool allMonitors = argc >= 3 && strcmp(argv[2], "--all") == 0;
+    if (allMonitors && strcmp(argv[1], "bar") != 0)
+    {
+        LOG("--all is only supported by bar");
+        return 1;
+    }
+
     signal(SIGINT, CloseTmpFiles);
     System::Init();
 
     int32_t monitor = -1;
-    if (argc >= 3)
+    if (argc >= 3 && !allMonitors)
     {
         monitor = atoi(argv[2]);
     }
 
     Window window(monitor);
     window.Init(argc, argv);
-    ASSERT(argc >= 2, "Too little arguments!");
     if (strcmp(argv[1], "bar") == 0)
     {
-        Bar::Create(window, monitor);
+        if (allMonitors)
+        {
+            // The bars own their windows, window is only used for the initialization
+            Bar::CreateAll();
+        }
+        else
+        {
+            Bar::Create(window, monitor);
+        }
+        if (Config::Get().enableOSD)
+        {
+            OSD::Create(monitor);
+        }
+        InitControl();
     }
     else if (strcmp(argv[1], "audio") == 0)
     {
@@ -70,6 +164,22 @@ int main(int argc, char** argv)
     {
         OpenAudioFlyin(window, monitor, AudioFlyin::Type::Microphone);
     }
+    else if (strcmp(argv[1], "mixer") == 0)
+    {
+        if (access(mixerTmpFilePath, F_OK) != 0)
+        {
+            tmpFileOpen = true;
+            FILE* mixerTmpFile = fopen(mixerTmpFilePath, "w");
+            Mixer::Create(window, monitor);
+            fclose(mixerTmpFile);
+        }
+        else
+        {
+            // Already open, close
+            LOG("Mixer already open (/tmp/gBar__mixer exists)! Exiting...");
+            exit(0);
+        }
+    }
 #ifdef WITH_BLUEZ
     else if (strcmp(argv[1], "bluetooth") == 0)
     {
@@ -101,8 +211,16 @@ int main(int argc, char** argv)
         Plugin::LoadWidgetFromPlugin(argv[1], window, monitor);
     }
 
-    window.Run();
+    if (allMonitors)
+    {
+        gtk_main();
+    }
+    else
+    {
+        window.Run();
+    }
 
+    Control::Shutdown();
     System::FreeResources();
     CloseTmpFiles(0);
     return 0;
@@ -0,0 +1,215 @@
+#!/usr/bin/env python3
+# Stand-in BlueZ service for gBar's Bluetooth model (src/BlueZ.h), for use on a private bus. Needs dbus-next (pip install dbus-next).
+#
+#   dbus-daemon --session --nofork --address=unix:path=/tmp/gBar-bluez.sock &
+#   DBUS_SYSTEM_BUS_ADDRESS=unix:path=/tmp/gBar-bluez.sock tools/bluez-standin.py &
+#   DBUS_SYSTEM_BUS_ADDRESS=unix:path=/tmp/gBar-bluez.sock gBar bluetooth
+#
+# Exports one powered adapter and two devices through org.freedesktop.DBus.ObjectManager. Pair, Connect and Disconnect
+# succeed after a short delay and emit PropertiesChanged. StartDiscovery adds a new device through InterfacesAdded,
+# StopDiscovery removes it again through InterfacesRemoved. "Fail" in a device name makes its calls fail.
+# Pairing the discovered device asks the agent of the caller (org.bluez.AgentManager1.RegisterAgent) for a confirmation.
+import asyncio
+import os
+
+from dbus_next import BusType, DBusError, Message, MessageType, PropertyAccess, Variant
+from dbus_next.aio import MessageBus
+from dbus_next.service import ServiceInterface, method, dbus_property, signal
+
+ADAPTER = "/org/bluez/hci0"
+
+
+class ObjectManager(ServiceInterface):
+    def __init__(self):
+        super().__init__("org.freedesktop.DBus.ObjectManager")
+        self.objects = {}
+
+    def add(self, path, interface):
+        self.objects[path] = interface
+        self.InterfacesAdded(path, {interface.name: interface.props()})
+
+    def remove(self, path):
+        interface = self.objects.pop(path)
+        self.InterfacesRemoved(path, [interface.name])
+
+    @method()
+    def GetManagedObjects(self) -> "a{oa{sa{sv}}}":
+        return {path: {interface.name: interface.props()} for path, interface in self.objects.items()}
+
+    @signal()
+    def InterfacesAdded(self, path, interfaces) -> "oa{sa{sv}}":
+        return [path, interfaces]
+
+    @signal()
+    def InterfacesRemoved(self, path, interfaces) -> "oas":
+        return [path, interfaces]
+
+
+class Adapter(ServiceInterface):
+    def __init__(self, standin):
+        super().__init__("org.bluez.Adapter1")
+        self.standin = standin
+
+    def props(self):
+        return {"Name": Variant("s", "standin"), "Powered": Variant("b", True), "Discovering": Variant("b", self.standin.discovering)}
+
+    @dbus_property(access=PropertyAccess.READ)
+    def Name(self) -> "s":
+        return "standin"
+
+    @dbus_property(access=PropertyAccess.READ)
+    def Powered(self) -> "b":
+        return True
+
+    @method()
+    async def StartDiscovery(self):
+        print("StartDiscovery")
+        await self.standin.set_discovering(True)
+
+    @method()
+    async def StopDiscovery(self):
+        print("StopDiscovery")
+        await self.standin.set_discovering(False)
+
+
+class AgentManager(ServiceInterface):
+    def __init__(self, standin):
+        super().__init__("org.bluez.AgentManager1")
+        self.standin = standin
+
+    @method()
+    def RegisterAgent(self, path: "o", capability: "s"):
+        print("RegisterAgent", self.standin.agent_sender, path, capability)
+        self.standin.agent = (self.standin.agent_sender, path)
+
+    @method()
+    def UnregisterAgent(self, path: "o"):
+        print("UnregisterAgent", path)
+        self.standin.agent = None
+
+    @method()
+    def RequestDefaultAgent(self, path: "o"):
+        print("RequestDefaultAgent", path)
+
+
+class Device(ServiceInterface):
+    def __init__(self, mac, name, icon, paired=False, connected=False, confirm=False):
+        super().__init__("org.bluez.Device1")
+        self.standin = None
+        self.path = None
+        self.confirm = confirm
+        self.mac = mac
+        self.name_ = name
+        self.icon = icon
+        self.paired = paired
+        self.connected = connected
+
+    def props(self):
+        return {
+            "Address": Variant("s", self.mac),
+            "Name": Variant("s", self.name_),
+            "Icon": Variant("s", self.icon),
+            "Paired": Variant("b", self.paired),
+            "Connected": Variant("b", self.connected),
+            # Changes all the time while scanning, gBar has to ignore it
+            "RSSI": Variant("n", -50),
+        }
+
+    async def change(self, method, prop, value):
+        print(method, self.mac)
+        await asyncio.sleep(0.5)
+        if "Fail" in self.name_:
+            raise DBusError("org.bluez.Error.Failed", method + " failed")
+        setattr(self, prop, value)
+        self.emit_properties_changed({prop.capitalize(): value})
+
+    @dbus_property(access=PropertyAccess.READ)
+    def Paired(self) -> "b":
+        return self.paired
+
+    @dbus_property(access=PropertyAccess.READ)
+    def Connected(self) -> "b":
+        return self.connected
+
+    async def request_confirmation(self):
+        if not self.standin.agent:
+            raise DBusError("org.bluez.Error.AuthenticationFailed", "No agent")
+        sender, path = self.standin.agent
+        reply = await self.standin.bus.call(
+            Message(destination=sender, path=path, interface="org.bluez.Agent1", member="RequestConfirmation", signature="ou", body=[self.path, 123456])
+        )
+        print("RequestConfirmation", self.path, reply.message_type.name, reply.error_name or "")
+        if reply.message_type == MessageType.ERROR:
+            raise DBusError("org.bluez.Error.AuthenticationRejected", "Confirmation rejected")
+
+    @method()
+    async def Pair(self):
+        if self.confirm:
+            await self.request_confirmation()
+        await self.change("Pair", "paired", True)
+
+    @method()
+    async def Connect(self):
+        await self.change("Connect", "connected", True)
+
+    @method()
+    async def Disconnect(self):
+        await self.change("Disconnect", "connected", False)
+
+
+class StandIn:
+    def __init__(self, bus):
+        self.bus = bus
+        self.manager = ObjectManager()
+        self.discovering = False
+        self.found = ADAPTER + "/dev_00_00_00_00_00_03"
+        # Unique name and object path of the registered agent
+        self.agent = None
+        self.agent_sender = None
+
+    def note_sender(self, message):
+        # dbus-next doesn't pass the sender to methods
+        if message.member == "RegisterAgent":
+            self.agent_sender = message.sender
+
+    def export(self, path, interface):
+        if isinstance(interface, Device):
+            interface.standin = self
+            interface.path = path
+        self.bus.export(path, interface)
+        self.manager.add(path, interface)
+
+    async def find_device(self):
+        await asyncio.sleep(1)
+        if self.discovering:
+            self.export(self.found, Device("00:00:00:00:00:03", "Found Speaker", "audio-headset", confirm=True))
+
+    async def set_discovering(self, discovering):
+        if discovering == self.discovering:
+            return
+        self.discovering = discovering
+        if discovering:
+            # Reply right away, like BlueZ
+            asyncio.get_running_loop().create_task(self.find_device())
+        elif self.found in self.manager.objects:
+            self.manager.remove(self.found)
+            self.bus.unexport(self.found)
+
+
+async def main():
+    if "DBUS_SYSTEM_BUS_ADDRESS" not in os.environ:
+        raise SystemExit("Set DBUS_SYSTEM_BUS_ADDRESS to a private bus, this would register org.bluez on the real system bus")
+    bus = await MessageBus(bus_type=BusType.SYSTEM).connect()
+    standin = StandIn(bus)
+    bus.add_message_handler(standin.note_sender)
+    bus.export("/", standin.manager)
+    bus.export("/org/bluez", AgentManager(standin))
+    standin.export(ADAPTER, Adapter(standin))
+    standin.export(ADAPTER + "/dev_00_00_00_00_00_01", Device("00:00:00:00:00:01", "Keyboard", "input-keyboard", paired=True, connected=True))
+    standin.export(ADAPTER + "/dev_00_00_00_00_00_02", Device("00:00:00:00:00:02", "Fail Mouse", "input-mouse"))
+    await bus.request_name("org.bluez")
+    print("org.bluez ready")
+    await bus.wait_for_disconnect()
+
+
+asyncio.run(main())
@@ -0,0 +1,98 @@
+#!/usr/bin/env python3
+# Stand-in sway IPC server, that replays a recorded event stream to gBar's Sway workspace backend.
+#
+# Usage:
+#   tools/sway-ipc-replay.py [recording] [socket]
+#   SWAYSOCK=<socket> gBar bar 0      (with UseSwayIPC: true)
+#
+# GET_WORKSPACES is answered with the recorded state, SUBSCRIBE starts the replay of the events and RUN_COMMAND
+# is printed and acknowledged, so e.g. clicking a workspace shows the exact command gBar sends.
+import os
+import socket
+import struct
+import sys
+import threading
+import time
+
+MAGIC = b"i3-ipc"
+RUN_COMMAND, GET_WORKSPACES, SUBSCRIBE = 0, 1, 2
+EVENTS = {"workspace": 0x80000000, "output": 0x80000001}
+
+
+def load(path):
+    workspaces = "[]"
+    events = []
+    with open(path) as f:
+        for line in f:
+            line = line.strip()
+            if not line or line.startswith("#"):
+                continue
+            first, rest = line.split(" ", 1)
+            if first == "workspaces":
+                workspaces = rest
+            else:
+                event, payload = rest.split(" ", 1)
+                events.append((float(first), EVENTS[event], payload))
+    return workspaces, events
+
+
+def send(conn, type, payload):
+    data = payload.encode()
+    conn.sendall(MAGIC + struct.pack("=II", len(data), type) + data)
+
+
+def recv_exact(conn, size):
+    data = b""
+    while len(data) < size:
+        chunk = conn.recv(size - len(data))
+        if not chunk:
+            raise ConnectionError
+        data += chunk
+    return data
+
+
+def serve(conn, workspaces, events):
+    lock = threading.Lock()
+
+    def replay():
+        for delay, type, payload in events:
+            time.sleep(delay)
+            print("event", payload)
+            with lock:
+                send(conn, type, payload)
+
+    try:
+        while True:
+            header = recv_exact(conn, len(MAGIC) + 8)
+            length, type = struct.unpack("=II", header[len(MAGIC):])
+            payload = recv_exact(conn, length).decode()
+            with lock:
+                if type == RUN_COMMAND:
+                    print("command", payload)
+                    send(conn, type, '[{"success":true}]')
+                elif type == GET_WORKSPACES:
+                    send(conn, type, workspaces)
+                elif type == SUBSCRIBE:
+                    send(conn, type, '{"success":true}')
+                    threading.Thread(target=replay, daemon=True).start()
+    except (ConnectionError, BrokenPipeError):
+        conn.close()
+
+
+def main():
+    recording = sys.argv[1] if len(sys.argv) > 1 else os.path.join(os.path.dirname(__file__), "sway-ipc-replay.txt")
+    path = sys.argv[2] if len(sys.argv) > 2 else "/tmp/gBar-sway-replay.sock"
+    workspaces, events = load(recording)
+    if os.path.exists(path):
+        os.unlink(path)
+    server = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    server.bind(path)
+    server.listen()
+    print("Listening on", path)
+    while True:
+        conn, _ = server.accept()
+        threading.Thread(target=serve, args=(conn, workspaces, events), daemon=True).start()
+
+
+if __name__ == "__main__":
+    main()